@@ -0,0 +1,543 @@
+//Rules for thousands of snakes on a very large board, see arena.hpp.
+
+#include "arena.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+using namespace std;
+
+const int initialRing = 32; //Body ring size of a new snake, doubled as it grows
+const int snakesPerTask = 256; //Snakes a thread takes at a time in the parallel phases
+const int emptyCellDraws = 64; //Random draws for an empty cell before searching in order
+const int deadly = StepHitWall | StepHitSelf | StepHitSnake | StepHeadOn;
+
+/**
+ Returns the microseconds since a point in time and moves the point to now
+ @param since The point in time, updated
+ @return The microseconds
+ */
+static double lap(chrono::steady_clock::time_point &since) {
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    double us = chrono::duration<double, micro>(now - since).count();
+    since = now;
+    return us;
+}
+
+Arena::Arena(int width, int height, int snakeTotal, int fruitTotal, int length, uint64_t seed)
+    : boardWidth(max(1, min(width, 65535))), boardHeight(max(1, min(height, 65535))), grid(boardWidth, boardHeight) {
+    chunksWide = (boardWidth + (1 << arenaChunkShift) - 1) >> arenaChunkShift;
+    int chunksHigh = (boardHeight + (1 << arenaChunkShift) - 1) >> arenaChunkShift;
+    chunks.resize((size_t) chunksWide * chunksHigh);
+    allocatedChunks = 0;
+    startLength = max(1, length);
+    rng = seed;
+    tickCount = 0;
+    alive = 0;
+    phaseTimes = ArenaTimings{};
+
+    snakeTotal = max(1, min(snakeTotal, maxArenaSnakes));
+    snakes.resize(snakeTotal);
+    targets.assign(snakeTotal, 0);
+    moving.assign(snakeTotal, 0);
+    eating.assign(snakeTotal, -1);
+    gridEdits.assign(blockCount(), vector<vector<InterestEdit>>(grid.bandCount()));
+    newChunks.resize(blockCount());
+    for (int i = 0; i < snakeTotal; ++i) {
+        ArenaSnake &snake = snakes[i];
+        snake.body.assign(initialRing, 0);
+        snake.tailIndex = 0;
+        snake.length = 0;
+        snake.direction = Right;
+        snake.alive = 0;
+        snake.score = 0;
+        spawnSnake(i);
+    }
+
+    fruitTotal = max(0, min(fruitTotal, maxArenaFruits));
+    for (int i = 0; i < fruitTotal; ++i) {
+        ArenaCell cell;
+        if (!pickEmptyCell(cell)) {
+            break;
+        }
+        ownerSlot(cell) = (uint16_t) (arenaFruitBase + fruits.size());
+        grid.apply(InterestEdit{cell, (uint16_t) fruits.size(), InterestAddFruit});
+        fruits.push_back(cell);
+    }
+}
+
+/**
+ Runs work(task) for every task number, on the pool if there is one
+ @param pool The threads, or null
+ @param count Number of tasks
+ @param work The function of a task number
+ */
+template <class Work>
+static void runTasks(ThreadPool *pool, int count, const Work &work) {
+    if (!pool || pool->size() <= 1 || count <= 1) {
+        for (int i = 0; i < count; ++i) {
+            work(i);
+        }
+        return;
+    }
+    pool->parallelFor(count, [&](int task, int /*thread*/) {
+        work(task);
+    });
+}
+
+template <class Work>
+void Arena::forEachBlock(ThreadPool *pool, const Work &work) const {
+    int count = (int) snakes.size();
+    runTasks(pool, blockCount(), [&](int block) {
+        work(block, block * snakesPerTask, min(count, (block + 1) * snakesPerTask));
+    });
+}
+
+template <class Work>
+void Arena::forEachSnake(ThreadPool *pool, const Work &work) const {
+    forEachBlock(pool, [&](int /*block*/, int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            work(i);
+        }
+    });
+}
+
+int Arena::blockCount() const {
+    return ((int) snakes.size() + snakesPerTask - 1) / snakesPerTask;
+}
+
+int Arena::step(const uint8_t directions[], uint8_t events[], ThreadPool *pool) {
+    int count = (int) snakes.size();
+    tickCount++;
+    chrono::steady_clock::time_point since = chrono::steady_clock::now();
+
+    //Phase 1, in parallel: where every head goes, and whether it eats. Each snake only
+    //reads the board and writes its own entries.
+    forEachSnake(pool, [&](int i) {
+        ArenaSnake &snake = snakes[i];
+        events[i] = 0;
+        moving[i] = 0;
+        eating[i] = -1;
+        if (!snake.alive) {
+            return;
+        }
+        int direction = directions[i];
+        if (direction > Right || direction == oppositeDirection(snake.direction)) {
+            direction = snake.direction; //Cannot go in the opposite direction
+        }
+        snake.direction = (uint8_t) direction;
+        ArenaCell head = snake.headCell();
+        int x = (int) (head & 0xFFFF) + moveDX[direction];
+        int y = (int) (head >> 16) + moveDY[direction];
+        if (x < 0 || x >= boardWidth || y < 0 || y >= boardHeight) {
+            events[i] = StepHitWall;
+            return;
+        }
+        targets[i] = arenaCell(x, y);
+        moving[i] = 1;
+        uint16_t owner = ownerAt(targets[i]);
+        if (owner >= arenaFruitBase) {
+            eating[i] = owner - arenaFruitBase;
+        }
+    });
+    phaseTimes.propose = lap(since);
+
+    //Phase 2, in parallel: heads meeting, swaps and bodies, looked up in the board as it
+    //was before the move. Each snake only sets its own flags; every collision between two
+    //snakes is seen from both sides.
+    forEachSnake(pool, [&](int i) {
+        if (!moving[i]) {
+            return;
+        }
+        //A head that moves into the same cell can only come from one next to it
+        ArenaCell head = snakes[i].headCell();
+        int x = (int) (targets[i] & 0xFFFF), y = (int) (targets[i] >> 16);
+        for (int d = 0; d < 4; ++d) {
+            int aroundX = x + moveDX[d], aroundY = y + moveDY[d];
+            if (aroundX < 0 || aroundX >= boardWidth || aroundY < 0 || aroundY >= boardHeight) {
+                continue;
+            }
+            ArenaCell around = arenaCell(aroundX, aroundY);
+            uint16_t owner = ownerAt(around);
+            if (around != head && owner != 0 && owner < arenaFruitBase && moving[owner - 1] &&
+                targets[owner - 1] == targets[i] && snakes[owner - 1].headCell() == around) {
+                events[i] |= StepHeadOn;
+            }
+        }
+        uint16_t owner = ownerAt(targets[i]);
+        if (owner == 0 || owner >= arenaFruitBase) {
+            return;
+        }
+        int other = owner - 1;
+        const ArenaSnake &otherSnake = snakes[other];
+        if (other != i && targets[i] == otherSnake.headCell() && moving[other] && targets[other] == snakes[i].headCell()) {
+            events[i] |= StepHeadOn;
+        } else if (targets[i] != otherSnake.tailCell() || eating[other] >= 0) {
+            events[i] |= (other == i) ? StepHitSelf : StepHitSnake; //Only a tail that moves away is safe
+        }
+    });
+    phaseTimes.check = lap(since);
+
+    //In parallel, each block of snakes lists its edits of the interest grid by band, and
+    //the heads going into chunks that do not exist yet
+    forEachBlock(pool, [&](int block, int begin, int end) {
+        vector<vector<InterestEdit>> &edits = gridEdits[block];
+        for (vector<InterestEdit> &band : edits) {
+            band.clear();
+        }
+        newChunks[block].clear();
+        for (int i = begin; i < end; ++i) {
+            const ArenaSnake &snake = snakes[i];
+            if (!snake.alive) {
+                continue;
+            }
+            if (events[i] & deadly) {
+                for (uint32_t s = 0; s < snake.length; ++s) {
+                    ArenaCell cell = snake.cellAt(s);
+                    edits[grid.bandOf(cell)].push_back(InterestEdit{cell, (uint16_t) i, InterestRemoveSegment});
+                }
+                continue;
+            }
+            if (!chunks[chunkIndex(targets[i])]) {
+                newChunks[block].push_back(targets[i]);
+            }
+            if (eating[i] < 0) {
+                ArenaCell tail = snake.tailCell();
+                edits[grid.bandOf(tail)].push_back(InterestEdit{tail, (uint16_t) i, InterestRemoveSegment});
+            } else {
+                edits[grid.bandOf(targets[i])].push_back(InterestEdit{targets[i], (uint16_t) eating[i], InterestRemoveFruit});
+            }
+            edits[grid.bandOf(targets[i])].push_back(InterestEdit{targets[i], (uint16_t) i, InterestAddSegment});
+        }
+    });
+    //Heads may only be written in parallel where the chunks exist already
+    for (const vector<ArenaCell> &cells : newChunks) {
+        for (ArenaCell cell : cells) {
+            ownerSlot(cell);
+        }
+    }
+    //Each band is edited by one thread, taking the blocks in order so the lists come out
+    //the same on every run
+    runTasks(pool, grid.bandCount(), [&](int band) {
+        for (const vector<vector<InterestEdit>> &edits : gridEdits) {
+            for (const InterestEdit &edit : edits[band]) {
+                grid.apply(edit);
+            }
+        }
+    });
+    phaseTimes.grid = lap(since);
+
+    //Phase 3, in parallel: take the dead off the board and pull in the tails of the
+    //rest, then push the heads. The cells written in each pass all differ; the head pass
+    //comes second so a head can follow into a tail cell left this tick.
+    forEachSnake(pool, [&](int i) {
+        ArenaSnake &snake = snakes[i];
+        if (!snake.alive) {
+            return;
+        }
+        if (events[i] & deadly) {
+            for (uint32_t s = 0; s < snake.length; ++s) {
+                setOwner(snake.cellAt(s), 0);
+            }
+            snake.length = 0;
+            snake.alive = 0;
+            moving[i] = 0;
+        } else if (eating[i] < 0) {
+            setOwner(snake.tailCell(), 0);
+            snake.tailIndex = (snake.tailIndex + 1) & (uint32_t) (snake.body.size() - 1);
+            snake.length--;
+        }
+    });
+    forEachSnake(pool, [&](int i) {
+        if (moving[i]) {
+            pushHead(snakes[i], targets[i]);
+        }
+    });
+    phaseTimes.move = lap(since);
+
+    //Scores and new fruit on one thread in snake order. An eaten fruit keeps its number
+    //and moves to a new cell.
+    for (int i = 0; i < count; ++i) {
+        if (events[i] & deadly) {
+            alive--;
+        } else if (moving[i] && eating[i] >= 0) {
+            snakes[i].score++;
+            events[i] |= StepAteFruit;
+            ArenaCell cell;
+            if (pickEmptyCell(cell)) {
+                fruits[eating[i]] = cell;
+                ownerSlot(cell) = (uint16_t) (arenaFruitBase + eating[i]);
+                grid.apply(InterestEdit{cell, (uint16_t) eating[i], InterestAddFruit});
+            } else {
+                //No room: the fruit stays under the head and nobody can eat it again
+                fruits[eating[i]] = targets[i];
+            }
+        }
+    }
+    phaseTimes.fruit = lap(since);
+    return alive;
+}
+
+void Arena::steerBots(uint8_t directions[], ThreadPool *pool) const {
+    forEachSnake(pool, [&](int i) {
+        const ArenaSnake &snake = snakes[i];
+        directions[i] = snake.direction;
+        if (!snake.alive) {
+            return;
+        }
+        ArenaCell head = snake.headCell();
+        int x = (int) (head & 0xFFFF), y = (int) (head >> 16);
+        int goalX = x, goalY = y;
+        if (!fruits.empty()) {
+            ArenaCell goal = fruits[i % fruits.size()];
+            goalX = (int) (goal & 0xFFFF);
+            goalY = (int) (goal >> 16);
+        }
+
+        //Lowest score wins: a free cell first, then closer to the fruit, then more room
+        //around it. The current direction is tried first so ties keep going straight.
+        int best = snake.direction, bestScore = INT_MAX;
+        for (int turn = 0; turn < 4; ++turn) {
+            int direction = turn == 0 ? snake.direction : turn - 1 + (turn - 1 >= snake.direction);
+            if (direction == oppositeDirection(snake.direction)) {
+                continue;
+            }
+            int nextX = x + moveDX[direction], nextY = y + moveDY[direction];
+            if (nextX < 0 || nextX >= boardWidth || nextY < 0 || nextY >= boardHeight) {
+                continue;
+            }
+            uint16_t owner = ownerAt(arenaCell(nextX, nextY));
+            bool free = owner == 0 || owner >= arenaFruitBase;
+            int room = 0;
+            for (int d = 0; d < 4; ++d) {
+                int aroundX = nextX + moveDX[d], aroundY = nextY + moveDY[d];
+                if (aroundX >= 0 && aroundX < boardWidth && aroundY >= 0 && aroundY < boardHeight) {
+                    uint16_t around = ownerAt(arenaCell(aroundX, aroundY));
+                    room += around == 0 || around >= arenaFruitBase;
+                }
+            }
+            int score = (free ? 0 : 1 << 20) + (room == 0 ? 1 << 18 : 0) + (abs(goalX - nextX) + abs(goalY - nextY)) * 4 +
+                        (4 - room);
+            if (score < bestScore) {
+                bestScore = score;
+                best = direction;
+            }
+        }
+        directions[i] = (uint8_t) best;
+    });
+}
+
+void Arena::removeSnake(int index) {
+    ArenaSnake &snake = snakes[index];
+    for (uint32_t i = 0; i < snake.length; ++i) {
+        setOwner(snake.cellAt(i), 0);
+        grid.apply(InterestEdit{snake.cellAt(i), (uint16_t) index, InterestRemoveSegment});
+    }
+    snake.length = 0;
+    if (snake.alive) {
+        snake.alive = 0;
+        alive--;
+    }
+}
+
+bool Arena::spawnSnake(int index) {
+    removeSnake(index);
+    ArenaSnake &snake = snakes[index];
+    //A straight line of free cells, the head at a random cell and the body behind it
+    for (int attempt = 0; attempt < emptyCellDraws; ++attempt) {
+        uint64_t random = nextRandom(rng);
+        int x = (int) (((random & 0xFFFFFFFF) * (uint64_t) boardWidth) >> 32);
+        int y = (int) (((random >> 32) * (uint64_t) boardHeight) >> 32);
+        int direction = (int) (nextRandom(rng) >> 62);
+        int backX = -moveDX[direction], backY = -moveDY[direction];
+        int tailX = x + backX * (startLength - 1), tailY = y + backY * (startLength - 1);
+        if (tailX < 0 || tailX >= boardWidth || tailY < 0 || tailY >= boardHeight) {
+            continue;
+        }
+        bool free = true;
+        for (int s = 0; s < startLength && free; ++s) {
+            free = ownerAt(arenaCell(x + backX * s, y + backY * s)) == 0;
+        }
+        if (!free) {
+            continue;
+        }
+        snake.tailIndex = 0;
+        snake.direction = (uint8_t) direction;
+        snake.score = 0;
+        for (int s = startLength - 1; s >= 0; --s) {
+            ArenaCell cell = arenaCell(x + backX * s, y + backY * s);
+            ownerSlot(cell);
+            pushHead(snake, cell);
+            grid.apply(InterestEdit{cell, (uint16_t) index, InterestAddSegment});
+        }
+        snake.alive = 1;
+        alive++;
+        return true;
+    }
+    return false;
+}
+
+ArenaViewport Arena::viewAround(int index, int width, int height) const {
+    const ArenaSnake &snake = snakes[index];
+    ArenaCell head = snake.length > 0 ? snake.headCell() : 0;
+    width = min(width, boardWidth);
+    height = min(height, boardHeight);
+    int x = max(0, min((int) (head & 0xFFFF) - width / 2, boardWidth - width));
+    int y = max(0, min((int) (head >> 16) - height / 2, boardHeight - height));
+    return ArenaViewport{x, y, width, height};
+}
+
+void Arena::visibleIn(const ArenaViewport &viewport, VisibleSet &visible) const {
+    grid.query(viewport, (int) snakes.size(), visible);
+}
+
+/**
+ Appends a little-endian number to a snapshot
+ @param bytes The snapshot
+ @param value The number
+ @param size Its size in bytes
+ */
+static void putNumber(vector<uint8_t> &bytes, uint32_t value, int size) {
+    for (int i = 0; i < size; ++i) {
+        bytes.push_back((uint8_t) (value >> (8 * i)));
+    }
+}
+
+void Arena::encodeView(const VisibleSet &visible, vector<uint8_t> &bytes) const {
+    const ArenaViewport &view = visible.viewport;
+    bytes.clear();
+    bytes.reserve(20 + visible.snakes.size() * 15 + visible.segments.size() * 6 + visible.fruits.size() * 4);
+    putNumber(bytes, tickCount, 4);
+    putNumber(bytes, view.x, 2);
+    putNumber(bytes, view.y, 2);
+    putNumber(bytes, view.width, 2);
+    putNumber(bytes, view.height, 2);
+    putNumber(bytes, (uint32_t) visible.snakes.size(), 2);
+    for (uint16_t index : visible.snakes) {
+        const ArenaSnake &snake = snakes[index];
+        putNumber(bytes, index, 2);
+        putNumber(bytes, snake.direction, 1);
+        putNumber(bytes, (uint32_t) snake.score, 4);
+        putNumber(bytes, snake.length, 4);
+        putNumber(bytes, snake.headCell(), 4);
+    }
+    putNumber(bytes, (uint32_t) visible.segments.size(), 4);
+    for (const InterestEntry &segment : visible.segments) {
+        putNumber(bytes, segment.id, 2);
+        putNumber(bytes, (segment.cell & 0xFFFF) - view.x, 2);
+        putNumber(bytes, (segment.cell >> 16) - view.y, 2);
+    }
+    putNumber(bytes, (uint32_t) visible.fruits.size(), 2);
+    for (const InterestEntry &fruit : visible.fruits) {
+        putNumber(bytes, (fruit.cell & 0xFFFF) - view.x, 2);
+        putNumber(bytes, (fruit.cell >> 16) - view.y, 2);
+    }
+}
+
+uint64_t Arena::stateHash() const {
+    //FNV-1a over the numbers that make up the state
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    auto mix = [&hash](uint64_t value) {
+        hash = (hash ^ value) * 0x100000001B3ULL;
+    };
+    mix(tickCount);
+    for (const ArenaSnake &snake : snakes) {
+        mix(snake.alive);
+        mix(snake.direction);
+        mix((uint32_t) snake.score);
+        mix(snake.length);
+        for (uint32_t i = 0; i < snake.length; ++i) {
+            mix(snake.cellAt(i));
+        }
+    }
+    for (ArenaCell fruit : fruits) {
+        mix(fruit);
+    }
+    return hash;
+}
+
+uint16_t &Arena::ownerSlot(ArenaCell cell) {
+    unique_ptr<ArenaChunk> &chunk = chunks[chunkIndex(cell)];
+    if (!chunk) {
+        chunk.reset(new ArenaChunk());
+        allocatedChunks++;
+    }
+    return chunk->cells[chunkOffset(cell)];
+}
+
+bool Arena::pickEmptyCell(ArenaCell &cell) {
+    //A large board is mostly empty, so a few random draws nearly always find a cell;
+    //otherwise search in order from the last draw
+    uint64_t random = 0;
+    for (int attempt = 0; attempt < emptyCellDraws; ++attempt) {
+        random = nextRandom(rng);
+        int x = (int) (((random & 0xFFFFFFFF) * (uint64_t) boardWidth) >> 32);
+        int y = (int) (((random >> 32) * (uint64_t) boardHeight) >> 32);
+        cell = arenaCell(x, y);
+        if (ownerAt(cell) == 0) {
+            return true;
+        }
+    }
+    uint64_t cells = (uint64_t) boardWidth * boardHeight;
+    uint64_t start = (uint64_t) (cell >> 16) * boardWidth + (cell & 0xFFFF);
+    for (uint64_t n = 1; n < cells; ++n) {
+        uint64_t index = (start + n) % cells;
+        cell = arenaCell((int) (index % boardWidth), (int) (index / boardWidth));
+        if (ownerAt(cell) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Arena::pushHead(ArenaSnake &snake, ArenaCell cell) {
+    if (snake.length == snake.body.size()) {
+        //Lay the ring out again from the tail at twice the size
+        vector<ArenaCell> grown(snake.body.size() * 2);
+        for (uint32_t i = 0; i < snake.length; ++i) {
+            grown[i] = snake.cellAt(i);
+        }
+        snake.body.swap(grown);
+        snake.tailIndex = 0;
+    }
+    snake.body[(snake.tailIndex + snake.length) & (snake.body.size() - 1)] = cell;
+    snake.length++;
+    setOwner(cell, (uint16_t) (&snake - snakes.data() + 1));
+}
+
+int Arena::width() const {
+    return boardWidth;
+}
+
+int Arena::height() const {
+    return boardHeight;
+}
+
+int Arena::snakeCount() const {
+    return (int) snakes.size();
+}
+
+int Arena::aliveCount() const {
+    return alive;
+}
+
+uint32_t Arena::tick() const {
+    return tickCount;
+}
+
+int Arena::chunkCount() const {
+    return allocatedChunks;
+}
+
+const ArenaSnake &Arena::snake(int index) const {
+    return snakes[index];
+}
+
+const vector<ArenaCell> &Arena::fruitCells() const {
+    return fruits;
+}
+
+const ArenaTimings &Arena::timings() const {
+    return phaseTimes;
+}
@@ -0,0 +1,264 @@
+//Rules for thousands of snakes on a very large board, the event mode. The rules are
+//MultiGame's, but the board is stored in chunks of 64x64 cells allocated the first time
+//something enters them, so a 2048x2048 arena costs memory only where snakes have been,
+//and a snake's neighbourhood sits in a few chunks instead of spread over whole rows.
+//Each chunk cell holds 16 bits: 0 for empty, snake number + 1, or arenaFruitBase plus
+//the fruit's number, so eating a fruit finds it in O(1).
+//
+//A tick runs in phases. The per-snake work, which is nearly all of it, runs in
+//parallel on a ThreadPool: every snake proposes its move, then checks it against the
+//board as it was before the tick (two heads meeting in a cell are found from the cells
+//around it, so no snake needs another's result), then moves. Only the scores and new
+//fruit are worked out on one thread, in snake order, so the result is the same
+//whatever the number of threads.
+//
+//The arena also keeps an InterestGrid of its segments and fruit, edited as snakes move,
+//so each player's view of the board can be listed and encoded without looking at the
+//rest of it.
+
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include "interest_grid.hpp"
+#include "multi_game.hpp"
+#include "thread_pool.hpp"
+
+#include <memory>
+#include <vector>
+
+const int maxArenaSnakes = 16384;
+const uint16_t arenaFruitBase = maxArenaSnakes + 1; //Cell value of fruit 0
+const int maxArenaFruits = 65535 - arenaFruitBase;
+const int arenaChunkShift = 6; //Chunks of 64x64 cells
+
+//A cell as x in the low 16 bits and y in the high 16 bits
+typedef uint32_t ArenaCell;
+
+/**
+ Packs a position into an ArenaCell
+ @param x Column
+ @param y Row
+ @return The cell
+ */
+inline ArenaCell arenaCell(int x, int y) {
+    return ((uint32_t) y << 16) | (uint32_t) x;
+}
+
+//One snake: a ring of body cells from the tail to the head
+struct ArenaSnake {
+    std::vector<ArenaCell> body; //Ring buffer, its size a power of two
+    uint32_t tailIndex; //Position of the tail in `body`
+    uint32_t length; //0 when the snake is not on the board
+    uint8_t direction; //Direction of the last move
+    uint8_t alive;
+    int32_t score;
+
+    ArenaCell headCell() const {
+        return body[(tailIndex + length - 1) & (body.size() - 1)];
+    }
+
+    ArenaCell tailCell() const {
+        return body[tailIndex];
+    }
+
+    /**
+     Returns one of the body cells
+     @param index The segment number, 0 being the tail
+     @return The cell
+     */
+    ArenaCell cellAt(uint32_t index) const {
+        return body[(tailIndex + index) & (body.size() - 1)];
+    }
+};
+
+//Time spent in each phase of the last step, in microseconds
+struct ArenaTimings {
+    double propose; //Parallel: directions, target cells, walls and fruit
+    double check; //Parallel: heads meeting, swaps and bodies
+    double grid; //Interest grid edits, parallel but for allocating chunks
+    double move; //Parallel: removing the dead, tails, heads
+    double fruit; //Serial: scores and new fruit
+};
+
+class Arena {
+public:
+    /**
+     Starts an arena with every snake placed at random
+     @param width Number of tiles in width, up to 65535
+     @param height Number of tiles in height, up to 65535
+     @param snakes Number of snakes, 1 to maxArenaSnakes
+     @param fruits Number of fruits kept on the board, up to maxArenaFruits
+     @param startLength Length of every snake when it spawns
+     @param seed The seed for spawns and fruit placement
+     */
+    Arena(int width, int height, int snakes, int fruits, int startLength, uint64_t seed);
+
+    /**
+     Moves every living snake one tile and resolves the collisions as MultiGame does
+     @param directions One direction constant per snake; reverse moves are ignored
+     @param events Receives the Step flags of every snake, 0 for a plain move or a dead snake
+     @param pool Threads for the per-snake phases, or null to run them all on this thread
+     @return Number of snakes still alive
+     */
+    int step(const uint8_t directions[], uint8_t events[], ThreadPool *pool);
+
+    /**
+     Picks a direction for every living snake: toward a fruit it is assigned, never
+     into a wall or a snake if it can help it
+     @param directions Receives one direction constant per snake
+     @param pool Threads to share the snakes over, or null
+     */
+    void steerBots(uint8_t directions[], ThreadPool *pool) const;
+
+    /**
+     Takes a snake off the board
+     @param snake The snake number
+     */
+    void removeSnake(int snake);
+
+    /**
+     Puts a snake back at random, straight and at the start length, with no score
+     @param snake The snake number
+     @return False if no free spot was found
+     */
+    bool spawnSnake(int snake);
+
+    /**
+     Returns who holds a cell
+     @param cell The cell
+     @return 0 for empty, snake number + 1, or arenaFruitBase plus the fruit number
+     */
+    uint16_t ownerAt(ArenaCell cell) const {
+        const ArenaChunk *chunk = chunks[chunkIndex(cell)].get();
+        return chunk ? chunk->cells[chunkOffset(cell)] : 0;
+    }
+
+    /**
+     Returns the part of the board a snake's player sees, centred on its head
+     @param snake The snake number
+     @param width Width of the view in tiles
+     @param height Height of the view in tiles
+     @return The viewport, kept on the board
+     */
+    ArenaViewport viewAround(int snake, int width, int height) const;
+
+    /**
+     Lists what is in a viewport
+     @param viewport The viewport
+     @param visible Receives the segments, fruit and snakes in view
+     */
+    void visibleIn(const ArenaViewport &viewport, VisibleSet &visible) const;
+
+    /**
+     Encodes a player's snapshot of what it sees; the size and the time taken depend only
+     on what is in view.
+     Layout, little-endian: [u32 tick][u16 x][u16 y][u16 width][u16 height]
+     [u16 snakes] then per snake [u16 number][u8 direction][u32 score][u32 length][u32 head cell]
+     [u32 segments] then per segment [u16 snake number][u16 x - view x][u16 y - view y]
+     [u16 fruits] then per fruit [u16 x - view x][u16 y - view y]
+     @param visible What visibleIn listed this tick
+     @param bytes Receives the snapshot
+     */
+    void encodeView(const VisibleSet &visible, std::vector<uint8_t> &bytes) const;
+
+    /**
+     Hashes the snakes, scores and fruit, to compare runs
+     @return The hash
+     */
+    uint64_t stateHash() const;
+
+    int width() const;
+    int height() const;
+    int snakeCount() const;
+    int aliveCount() const;
+    uint32_t tick() const;
+    int chunkCount() const; //Chunks allocated so far
+    const ArenaSnake &snake(int index) const;
+    const std::vector<ArenaCell> &fruitCells() const;
+    const ArenaTimings &timings() const;
+
+private:
+    struct ArenaChunk {
+        uint16_t cells[1 << (2 * arenaChunkShift)];
+    };
+
+    int chunkIndex(ArenaCell cell) const {
+        return ((cell >> 16) >> arenaChunkShift) * chunksWide + ((cell & 0xFFFF) >> arenaChunkShift);
+    }
+
+    static int chunkOffset(ArenaCell cell) {
+        const uint32_t mask = (1 << arenaChunkShift) - 1;
+        return (((cell >> 16) & mask) << arenaChunkShift) | (cell & mask);
+    }
+
+    /**
+     Returns a cell for writing, allocating its chunk; one thread only
+     @param cell The cell
+     @return The cell's value
+     */
+    uint16_t &ownerSlot(ArenaCell cell);
+
+    /**
+     Writes a cell whose chunk exists; safe in parallel for different cells
+     @param cell The cell
+     @param value The new value
+     */
+    void setOwner(ArenaCell cell, uint16_t value) {
+        chunks[chunkIndex(cell)]->cells[chunkOffset(cell)] = value;
+    }
+
+    /**
+     Returns a random empty cell
+     @return The cell, or false if none was found in a few draws
+     */
+    bool pickEmptyCell(ArenaCell &cell);
+
+    /**
+     Adds a cell in front of a snake's head, growing the ring if it is full
+     @param snake The snake
+     @param cell The new head cell, whose chunk exists
+     */
+    void pushHead(ArenaSnake &snake, ArenaCell cell);
+
+    /**
+     Runs a function over the blocks of snakes the parallel phases share out, on the pool
+     if there is one
+     @param pool The threads, or null
+     @param work The function of a block number and its first and past-the-end snake
+     */
+    template <class Work>
+    void forEachBlock(ThreadPool *pool, const Work &work) const;
+
+    /**
+     Runs a per-snake function over every snake, in blocks on the pool if there is one
+     @param pool The threads, or null
+     @param work The function of a snake number
+     */
+    template <class Work>
+    void forEachSnake(ThreadPool *pool, const Work &work) const;
+
+    int blockCount() const;
+
+    int boardWidth;
+    int boardHeight;
+    int chunksWide;
+    int startLength;
+    uint64_t rng;
+    uint32_t tickCount;
+    int alive;
+    std::vector<std::unique_ptr<ArenaChunk>> chunks; //Row-major, null until first written
+    int allocatedChunks;
+    std::vector<ArenaSnake> snakes;
+    std::vector<ArenaCell> fruits; //Fruit number n is at fruits[n]
+    InterestGrid grid;
+    ArenaTimings phaseTimes;
+
+    //Per-step scratch, one entry per snake
+    std::vector<ArenaCell> targets; //Cell each head moves into
+    std::vector<uint8_t> moving; //1 if the snake moves this tick, 0 if dead or into a wall
+    std::vector<int32_t> eating; //Fruit number the move eats, -1 for none
+    std::vector<std::vector<std::vector<InterestEdit>>> gridEdits; //Per block, per band
+    std::vector<std::vector<ArenaCell>> newChunks; //Per block, heads whose chunk is missing
+};
+
+#endif
@@ -0,0 +1,157 @@
+//Autopilot controller for attract mode, see autopilot.hpp.
+
+#include "autopilot.hpp"
+
+#include <cstring>
+using namespace std;
+
+//Neighbouring cell in each direction, or -1 past the edge of the board
+struct NeighborTable {
+    int16_t cell[gridCells][4];
+};
+
+/**
+ Builds the neighbour table at compile time so searches skip the bounds checks
+ @return The table
+ */
+static constexpr NeighborTable makeNeighborTable() {
+    NeighborTable table = {};
+    for (int cell = 0; cell < gridCells; ++cell) {
+        for (int direction = 0; direction < 4; ++direction) {
+            int x = cell % gridWidth + moveDX[direction];
+            int y = cell / gridWidth + moveDY[direction];
+            table.cell[cell][direction] = (int16_t) ((x < 0 || x >= gridWidth || y < 0 || y >= gridHeight) ? -1 : y * gridWidth + x);
+        }
+    }
+    return table;
+}
+
+static constexpr NeighborTable neighbors = makeNeighborTable();
+
+Autopilot::Autopilot() {
+    memset(visited, 0, sizeof(visited));
+    memset(bodyMark, 0, sizeof(bodyMark));
+    markNumber = 0;
+    searchNumber = 0;
+    reached = 0;
+}
+
+void Autopilot::markBody(const GameState &state) {
+    markNumber++;
+    int x = cellX(state.tailCell);
+    int y = cellY(state.tailCell);
+    bodyMark[state.tailCell] = markNumber;
+    vacate[state.tailCell] = 1;
+    int slot = state.ringStart;
+    for (int i = 0; i < state.length - 1; ++i) {
+        int direction = (state.moves[slot >> 2] >> ((slot & 3) * 2)) & 3;
+        if (++slot == gridCells) {
+            slot = 0;
+        }
+        x += moveDX[direction];
+        y += moveDY[direction];
+        bodyMark[cellAt(x, y)] = markNumber;
+        vacate[cellAt(x, y)] = (uint16_t) (i + 2);
+    }
+}
+
+int Autopilot::search(int start, int startTime, int target, bool stopAtTarget) {
+    searchNumber++;
+    int head = 0;
+    int tail = 0;
+    queue[tail++] = (uint16_t) start;
+    visited[start] = searchNumber;
+    distance[start] = (uint16_t) startTime;
+    parent[start] = -1;
+    int found = -1;
+    while (head < tail) {
+        int cell = queue[head++];
+        if (cell == target) {
+            found = distance[cell] - startTime;
+            if (stopAtTarget) {
+                break;
+            }
+        }
+        for (int direction = 0; direction < 4; ++direction) {
+            int next = neighbors.cell[cell][direction];
+            if (next < 0 || visited[next] == searchNumber || (bodyMark[next] == markNumber && vacate[next] > distance[cell] + 1)) {
+                continue; //Off the board, already seen, or still covered by the body when the head would get there
+            }
+            visited[next] = searchNumber;
+            distance[next] = (uint16_t) (distance[cell] + 1);
+            parent[next] = (int16_t) cell;
+            queue[tail++] = (uint16_t) next;
+        }
+    }
+    reached = tail;
+    return found;
+}
+
+int Autopilot::decide(const GameState &state) {
+    markBody(state);
+
+    //Follow the shortest path to the fruit if the tail stays reachable at the end of it
+    if (state.fruitX >= 0) {
+        int fruit = cellAt(state.fruitX, state.fruitY);
+        int moves = search(state.headCell, 0, fruit, true);
+        if (moves > 0) {
+            for (int cell = fruit, i = moves - 1; parent[cell] >= 0; cell = parent[cell], --i) {
+                int from = parent[cell];
+                int dx = cellX(cell) - cellX(from);
+                int dy = cellY(cell) - cellY(from);
+                path[i] = (int8_t) (dx == 1 ? Right : dx == -1 ? Left : dy == 1 ? Down : Up);
+            }
+            //A snake too short to cover its neck can find a path that starts by turning back.
+            //stepGame ignores that move and goes straight on, so such a path is never followed.
+            if (path[0] != oppositeDirection(state.direction)) {
+                GameState future = state;
+                for (int i = 0; i < moves; ++i) {
+                    moveSnake(future, path[i], i == moves - 1); //The snake grows on the last move
+                }
+                markBody(future);
+                if (search(future.headCell, 0, future.tailCell, true) > 0) {
+                    return path[0];
+                }
+                markBody(state);
+            }
+        }
+    }
+
+    //Otherwise take the safe move that keeps the tail reachable along the longest route, or failing that the one with the most room.
+    //Searching from the next cell one move later stands in for moving the snake first, so the body is only marked once.
+    int bestDirection = state.direction;
+    int bestScore = -1;
+    for (int direction = 0; direction < 4; ++direction) {
+        if (direction == oppositeDirection(state.direction)) {
+            continue;
+        }
+        int next = neighbors.cell[state.headCell][direction];
+        if (next < 0) {
+            continue;
+        }
+        int nx = cellX(next);
+        int ny = cellY(next);
+        bool grow = (nx == state.fruitX && ny == state.fruitY) || (nx == state.specialFruitX && ny == state.specialFruitY);
+        if (isOccupied(state, nx, ny) && (grow || next != state.tailCell)) {
+            continue;
+        }
+
+        //After this move the tail is the segment in front of the current one, unless the snake grows
+        int futureTail = state.tailCell;
+        if (!grow && state.length > 1) {
+            futureTail = neighbors.cell[state.tailCell][moveAt(state, 0)];
+        }
+        int toTail = search(next, grow ? 0 : 1, futureTail, true); //Visits every reachable cell when the tail is not found
+        int score = reached;
+        if (state.length < 3) {
+            score += gridCells; //A short snake can always turn around the board
+        } else if (toTail > 0) {
+            score = gridCells + toTail;
+        }
+        if (score > bestScore) {
+            bestScore = score;
+            bestDirection = direction;
+        }
+    }
+    return bestDirection;
+}
@@ -0,0 +1,52 @@
+//Autopilot controller for attract mode. It plays the game by itself by finding
+//the shortest path to the fruit and only taking it when the snake could still
+//reach its own tail afterwards. All search buffers are allocated once, inside the
+//object, and reused on every move.
+
+#ifndef AUTOPILOT_HPP
+#define AUTOPILOT_HPP
+
+#include "game_state.hpp"
+
+class Autopilot {
+public:
+    Autopilot();
+
+    /**
+     Chooses the direction for the next move
+     @param state The current game state
+     @return The direction constant to pass to stepGame
+     */
+    int decide(const GameState &state);
+
+private:
+    /**
+     Records where the body is and how many moves each segment stays there
+     @param state The game state whose body later searches should avoid
+     */
+    void markBody(const GameState &state);
+
+    /**
+     Breadth-first search over the board avoiding the body last marked. A body cell
+     counts as free from the move on which the tail leaves it, so paths can follow the tail.
+     @param start The cell the search starts from
+     @param startTime Number of moves already made when the head is on `start`
+     @param target The cell to look for, or -1 to visit every reachable cell
+     @param stopAtTarget True to stop as soon as the target is found
+     @return The number of moves from `start` to the target, or -1 if it cannot be reached
+     */
+    int search(int start, int startTime, int target, bool stopAtTarget);
+
+    uint16_t queue[gridCells]; //Cells waiting to be visited
+    int16_t parent[gridCells]; //Cell each visited cell was reached from
+    uint16_t distance[gridCells]; //Moves needed to reach each visited cell
+    uint16_t vacate[gridCells]; //Moves until each body cell is left by the tail
+    uint32_t bodyMark[gridCells]; //Search number that last found the body on each cell
+    uint32_t visited[gridCells]; //Search number that last visited each cell
+    uint32_t markNumber; //Lets markBody start without clearing `bodyMark`
+    uint32_t searchNumber; //Lets a new search start without clearing `visited`
+    int reached; //Number of cells the last search visited
+    int8_t path[gridCells]; //Directions from the head to the fruit
+};
+
+#endif
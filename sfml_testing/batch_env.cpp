@@ -0,0 +1,285 @@
+//Structure-of-arrays batch of games, see batch_env.hpp.
+
+#include "batch_env.hpp"
+
+#include <algorithm>
+#include <cstring>
+using namespace std;
+
+const int stepChunk = 2048; //Games per task when stepping on a pool
+
+/**
+ Writes one 2-bit move into a game's ring buffer
+ @param ring The game's ring buffer
+ @param slot The ring buffer position
+ @param direction The move
+ */
+static void setRingMove(uint8_t ring[], int slot, int direction) {
+    int shift = (slot & 3) * 2;
+    ring[slot >> 2] = (uint8_t) ((ring[slot >> 2] & ~(3 << shift)) | (direction << shift));
+}
+
+/**
+ Reads one 2-bit move from a game's ring buffer
+ @param ring The game's ring buffer
+ @param slot The ring buffer position
+ @return The move
+ */
+static int ringMove(const uint8_t ring[], int slot) {
+    return (ring[slot >> 2] >> ((slot & 3) * 2)) & 3;
+}
+
+BatchEnv::BatchEnv(int count, uint64_t seed) : count(count), headX(count), headY(count), direction(count), fruitCell(count),
+    specialFruitCell(count), specialFruitMs(count), fruitCounter(count), tailCell(count), length(count), ringStart(count),
+    score(count), tick(count), rng(count), occupied((size_t) count * gridHeight), moves((size_t) count * ringBytes),
+    nextDirection(count), nextCell(count), hitFlags(count), stepRewards(count), stepDones(count), stepFinalScores(count) {
+    reset(seed);
+}
+
+int BatchEnv::size() const {
+    return count;
+}
+
+void BatchEnv::reset(uint64_t seed) {
+    for (int env = 0; env < count; ++env) {
+        resetEnv(env, nextRandom(seed));
+    }
+}
+
+void BatchEnv::resetEnv(int env, uint64_t seed) {
+    memset(&occupied[(size_t) env * gridHeight], 0, gridHeight * sizeof(uint32_t));
+    memset(&moves[(size_t) env * ringBytes], 0, ringBytes);
+    rng[env] = seed;
+    direction[env] = Right; //Snake starts moving to the right initially
+    length[env] = 1;
+    headX[env] = gridWidth / 2;
+    headY[env] = gridHeight / 2;
+    tailCell[env] = cellAt(gridWidth / 2, gridHeight / 2);
+    occupied[(size_t) env * gridHeight + gridHeight / 2] = 1u << (gridWidth / 2);
+    ringStart[env] = 0;
+    fruitCell[env] = -1;
+    specialFruitCell[env] = -1; //Initially no special fruit
+    specialFruitMs[env] = 0;
+    fruitCounter[env] = 0;
+    score[env] = 0;
+    tick[env] = 0;
+    placeFruit(env, false);
+}
+
+bool BatchEnv::placeFruit(int env, bool special) {
+    int avoid = special ? fruitCell[env] : specialFruitCell[env];
+    int cell = pickFreeCell(&occupied[(size_t) env * gridHeight], length[env], avoid, rng[env]);
+    (special ? specialFruitCell : fruitCell)[env] = cell;
+    return cell >= 0;
+}
+
+void BatchEnv::step(const uint8_t actions[], int elapsedMs) {
+    stepRange(actions, elapsedMs, 0, count);
+}
+
+void BatchEnv::step(const uint8_t actions[], int elapsedMs, ThreadPool &pool) {
+    int chunks = (count + stepChunk - 1) / stepChunk;
+    pool.parallelFor(chunks, [&](int chunk, int) {
+        stepRange(actions, elapsedMs, chunk * stepChunk, min(count, (chunk + 1) * stepChunk));
+    });
+}
+
+/**
+ Vector pass of a step: works out where every head goes and what it hits, with no
+ branches and no per-game memory so the loop compiles to SIMD code.
+ The pointers must not overlap.
+ */
+static void moveHeads(int count, const uint8_t *__restrict actions, const int32_t *__restrict lastDirections,
+                      const int32_t *__restrict xs, const int32_t *__restrict ys, const int32_t *__restrict fruits,
+                      const int32_t *__restrict specialFruits, int32_t *__restrict timers, int elapsedMs,
+                      int32_t *__restrict directions, int32_t *__restrict cells, uint8_t *__restrict flags) {
+    for (int i = 0; i < count; ++i) {
+        int action = actions[i];
+        int current = lastDirections[i];
+        int moveDirection = (action == (current ^ 1) || action > 3) ? current : action; //Cannot go in the opposite direction
+        int x = xs[i] + (moveDirection == Right) - (moveDirection == Left);
+        int y = ys[i] + (moveDirection == Down) - (moveDirection == Up);
+        int cell = y * gridWidth + x;
+        int wall = ((unsigned) x >= (unsigned) gridWidth) | ((unsigned) y >= (unsigned) gridHeight);
+        directions[i] = moveDirection;
+        cells[i] = cell;
+        flags[i] = (uint8_t) (wall * StepHitWall | (cell == fruits[i]) * StepAteFruit | (cell == specialFruits[i]) * StepAteSpecialFruit);
+        timers[i] = min(timers[i] + elapsedMs, specialFruitMoveMs);
+    }
+}
+
+void BatchEnv::stepRange(const uint8_t actions[], int elapsedMs, int begin, int end) {
+    moveHeads(end - begin, actions + begin, &direction[begin], &headX[begin], &headY[begin], &fruitCell[begin],
+              &specialFruitCell[begin], &specialFruitMs[begin], elapsedMs, &nextDirection[begin], &nextCell[begin], &hitFlags[begin]);
+    fill(stepRewards.begin() + begin, stepRewards.begin() + end, 0);
+    fill(stepDones.begin() + begin, stepDones.begin() + end, 0);
+
+    //Scalar pass: body, fruits and restarts
+    for (int i = begin; i < end; ++i) {
+        finishMove(i);
+    }
+}
+
+void BatchEnv::finishMove(int env) {
+    int flags = hitFlags[env];
+    int done = 0;
+    if (flags & StepHitWall) {
+        done = StepHitWall;
+    } else {
+        int cell = nextCell[env];
+        int x = cellX(cell);
+        int y = cellY(cell);
+        uint32_t *rows = &occupied[(size_t) env * gridHeight];
+        bool ateFruit = (flags & StepAteFruit) != 0;
+        bool grow = ateFruit || (flags & StepAteSpecialFruit) != 0;
+
+        //The tail moves out of the way unless the snake grows
+        if (((rows[y] >> x) & 1u) && (grow || cell != tailCell[env])) {
+            done = StepHitSelf;
+        } else {
+            if (fruitCounter[env] >= numForSpecialFruit && specialFruitCell[env] == -1) {
+                placeFruit(env, true); //Place special fruit
+            }
+            if (fruitCounter[env] >= numForSpecialFruit && specialFruitMs[env] >= specialFruitMoveMs) {
+                placeFruit(env, true); //Moves the special fruit around every 3 seconds
+                specialFruitMs[env] = 0;
+            }
+            bool ateSpecialFruit = (cell == specialFruitCell[env]); //It may have just landed on the new head
+            grow = ateFruit || ateSpecialFruit;
+
+            //Push the head, then pop the tail unless growing
+            uint8_t *ring = &moves[(size_t) env * ringBytes];
+            int moveDirection = nextDirection[env];
+            setRingMove(ring, (ringStart[env] + length[env] - 1) % gridCells, moveDirection);
+            length[env]++;
+            headX[env] = x;
+            headY[env] = y;
+            rows[y] |= 1u << x;
+            if (!grow) {
+                int oldTail = tailCell[env];
+                int tailDirection = ringMove(ring, ringStart[env]);
+                rows[cellY(oldTail)] &= ~(1u << cellX(oldTail));
+                tailCell[env] = oldTail + moveDY[tailDirection] * gridWidth + moveDX[tailDirection];
+                ringStart[env] = (ringStart[env] + 1) % gridCells;
+                length[env]--;
+                if (cell == oldTail) {
+                    rows[y] |= 1u << x; //The head moved into the old tail cell, which is still covered
+                }
+            }
+            direction[env] = moveDirection;
+            tick[env]++;
+
+            int reward = 0;
+            if (ateSpecialFruit) {
+                reward += specialFruitPoints;
+                fruitCounter[env] = 0;
+                specialFruitCell[env] = -1;
+            }
+            if (ateFruit) {
+                reward++;
+                fruitCounter[env]++;
+                if (!placeFruit(env, false)) {
+                    done = StepBoardFull; //No room left, the board is cleared
+                }
+            }
+            score[env] += reward;
+            stepRewards[env] = reward;
+        }
+    }
+
+    if (done != 0) {
+        stepDones[env] = (uint8_t) done;
+        stepFinalScores[env] = score[env];
+        resetEnv(env, nextRandom(rng[env]));
+    }
+}
+
+const int32_t *BatchEnv::rewards() const {
+    return stepRewards.data();
+}
+
+const uint8_t *BatchEnv::dones() const {
+    return stepDones.data();
+}
+
+const int32_t *BatchEnv::finalScores() const {
+    return stepFinalScores.data();
+}
+
+void BatchEnv::exportState(int env, GameState &state) const {
+    memset(&state, 0, sizeof(state));
+    state.rng = rng[env];
+    state.tick = tick[env];
+    state.score = score[env];
+    state.headCell = (uint16_t) cellAt(headX[env], headY[env]);
+    state.tailCell = (uint16_t) tailCell[env];
+    state.length = (uint16_t) length[env];
+    state.ringStart = (uint16_t) ringStart[env];
+    state.specialFruitMs = (uint16_t) specialFruitMs[env];
+    state.fruitX = (int8_t) (fruitCell[env] >= 0 ? cellX(fruitCell[env]) : -1);
+    state.fruitY = (int8_t) (fruitCell[env] >= 0 ? cellY(fruitCell[env]) : -1);
+    state.specialFruitX = (int8_t) (specialFruitCell[env] >= 0 ? cellX(specialFruitCell[env]) : -1);
+    state.specialFruitY = (int8_t) (specialFruitCell[env] >= 0 ? cellY(specialFruitCell[env]) : -1);
+    state.fruitCounter = (uint8_t) fruitCounter[env];
+    state.direction = (uint8_t) direction[env];
+    memcpy(state.occupied, &occupied[(size_t) env * gridHeight], sizeof(state.occupied));
+    memcpy(state.moves, &moves[(size_t) env * ringBytes], sizeof(state.moves));
+    state.hash = computeHash(state);
+}
+
+void BatchEnv::writePlanes(int env, uint8_t planes[]) const {
+    memset(planes, 0, obsBytes);
+    const uint32_t *rows = &occupied[(size_t) env * gridHeight];
+    for (int y = 0; y < gridHeight; ++y) {
+        for (uint32_t row = rows[y]; row != 0; row &= row - 1) {
+            planes[cellAt(__builtin_ctz(row), y)] = 1;
+        }
+    }
+    planes[gridCells + cellAt(headX[env], headY[env])] = 1;
+    if (fruitCell[env] >= 0) {
+        planes[2 * gridCells + fruitCell[env]] = 1;
+    }
+    if (specialFruitCell[env] >= 0) {
+        planes[3 * gridCells + specialFruitCell[env]] = 1;
+    }
+}
+
+void BatchEnv::writeBitPlanes(int env, uint32_t planes[]) const {
+    memcpy(planes, &occupied[(size_t) env * gridHeight], gridHeight * sizeof(uint32_t));
+    memset(planes + gridHeight, 0, 3 * gridHeight * sizeof(uint32_t));
+    planes[gridHeight + headY[env]] = 1u << headX[env];
+    if (fruitCell[env] >= 0) {
+        planes[2 * gridHeight + cellY(fruitCell[env])] = 1u << cellX(fruitCell[env]);
+    }
+    if (specialFruitCell[env] >= 0) {
+        planes[3 * gridHeight + cellY(specialFruitCell[env])] = 1u << cellX(specialFruitCell[env]);
+    }
+}
+
+void writeStatePlanes(const GameState &state, uint8_t planes[]) {
+    memset(planes, 0, obsBytes);
+    for (int y = 0; y < gridHeight; ++y) {
+        for (uint32_t row = state.occupied[y]; row != 0; row &= row - 1) {
+            planes[cellAt(__builtin_ctz(row), y)] = 1;
+        }
+    }
+    planes[gridCells + state.headCell] = 1;
+    if (state.fruitX >= 0) {
+        planes[2 * gridCells + cellAt(state.fruitX, state.fruitY)] = 1;
+    }
+    if (state.specialFruitX >= 0) {
+        planes[3 * gridCells + cellAt(state.specialFruitX, state.specialFruitY)] = 1;
+    }
+}
+
+void writeStateBitPlanes(const GameState &state, uint32_t planes[]) {
+    memcpy(planes, state.occupied, gridHeight * sizeof(uint32_t));
+    memset(planes + gridHeight, 0, 3 * gridHeight * sizeof(uint32_t));
+    planes[gridHeight + cellY(state.headCell)] = 1u << cellX(state.headCell);
+    if (state.fruitX >= 0) {
+        planes[2 * gridHeight + state.fruitY] = 1u << state.fruitX;
+    }
+    if (state.specialFruitX >= 0) {
+        planes[3 * gridHeight + state.specialFruitY] = 1u << state.specialFruitX;
+    }
+}
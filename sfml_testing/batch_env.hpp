@@ -0,0 +1,179 @@
+//Many games stepped together for reinforcement-learning training. The games are
+//kept in structure-of-arrays layout: one array per field (head x, head y, fruit,
+//direction, ...) plus one block of occupancy rows and one move ring buffer per
+//game. A step first runs a branch-free loop over the plain arrays for head
+//movement, wall checks and fruit hits, which the compiler turns into SIMD code,
+//then finishes each game's body update in a short scalar pass. Games that end are
+//started again straight away, so every game always has a valid state.
+//
+//The rules and random fruit placement are the same as stepGame's: a game seeded
+//with s plays exactly like a GameState started with newGame(state, s).
+
+#ifndef BATCH_ENV_HPP
+#define BATCH_ENV_HPP
+
+#include "game_state.hpp"
+#include "thread_pool.hpp"
+
+#include <vector>
+
+//Observation planes written by BatchEnv::writePlanes and writeBitPlanes, in this order
+const int obsPlanes = 4; //Body, head, fruit, special fruit
+const int obsBytes = obsPlanes * gridCells; //One byte (0 or 1) per cell per plane
+const int obsBitWords = obsPlanes * gridHeight; //One 32-bit row per board row per plane, bit x is column x
+
+class BatchEnv {
+public:
+    /**
+     Creates the games and starts each one
+     @param count Number of games
+     @param seed Seed the per-game seeds are drawn from
+     */
+    BatchEnv(int count, uint64_t seed);
+
+    /**
+     Returns the number of games
+     @return The game count
+     */
+    int size() const;
+
+    /**
+     Starts every game again
+     @param seed Seed the per-game seeds are drawn from
+     */
+    void reset(uint64_t seed);
+
+    /**
+     Starts one game again
+     @param env The game number
+     @param seed The game's seed, as passed to newGame
+     */
+    void resetEnv(int env, uint64_t seed);
+
+    /**
+     Moves every game one tile. Games that end are restarted with a seed drawn from
+     their own generator; rewards(), dones() and finalScores() describe what happened.
+     @param actions One direction constant per game; reverse moves are ignored
+     @param elapsedMs Time since the previous move, used to move the special fruit
+     */
+    void step(const uint8_t actions[], int elapsedMs);
+
+    /**
+     Moves every game one tile, splitting the games over a pool's threads
+     @param actions One direction constant per game
+     @param elapsedMs Time since the previous move
+     @param pool The threads to step on
+     */
+    void step(const uint8_t actions[], int elapsedMs, ThreadPool &pool);
+
+    /**
+     Returns the points each game scored in the last step
+     @return One value per game
+     */
+    const int32_t *rewards() const;
+
+    /**
+     Returns how each game's episode ended in the last step
+     @return One Step flag per game (StepHitWall, StepHitSelf or StepBoardFull), 0 if it is still running
+     */
+    const uint8_t *dones() const;
+
+    /**
+     Returns the score of each episode that ended in the last step
+     @return One score per game, only meaningful where dones() is set
+     */
+    const int32_t *finalScores() const;
+
+    /**
+     Copies one game into a GameState, for bots, drawing or checking against stepGame
+     @param env The game number
+     @param state The state to fill in
+     */
+    void exportState(int env, GameState &state) const;
+
+    /**
+     Writes one game as byte planes: body, head, fruit and special fruit, each gridCells bytes in row order
+     @param env The game number
+     @param planes Room for obsBytes bytes
+     */
+    void writePlanes(int env, uint8_t planes[]) const;
+
+    /**
+     Writes one game as bit planes in the same order, each gridHeight 32-bit rows like GameState::occupied
+     @param env The game number
+     @param planes Room for obsBitWords words
+     */
+    void writeBitPlanes(int env, uint32_t planes[]) const;
+
+private:
+    /**
+     Steps the games in [begin, end)
+     @param actions One direction constant per game
+     @param elapsedMs Time since the previous move
+     @param begin The first game
+     @param end One past the last game
+     */
+    void stepRange(const uint8_t actions[], int elapsedMs, int begin, int end);
+
+    /**
+     Updates one game's body and fruits after the vector pass, and restarts it if it ended
+     @param env The game number
+     */
+    void finishMove(int env);
+
+    /**
+     Places the fruit or the special fruit on a random free cell
+     @param env The game number
+     @param special True for the special fruit
+     @return False if there was no room
+     */
+    bool placeFruit(int env, bool special);
+
+    int count;
+    static const int ringBytes = (gridCells + 3) / 4;
+
+    //One entry per game
+    std::vector<int32_t> headX;
+    std::vector<int32_t> headY;
+    std::vector<int32_t> direction; //Direction of the last move
+    std::vector<int32_t> fruitCell; //-1 when there is no fruit
+    std::vector<int32_t> specialFruitCell; //-1 when there is no special fruit
+    std::vector<int32_t> specialFruitMs;
+    std::vector<int32_t> fruitCounter;
+    std::vector<int32_t> tailCell;
+    std::vector<int32_t> length;
+    std::vector<int32_t> ringStart;
+    std::vector<int32_t> score;
+    std::vector<uint32_t> tick;
+    std::vector<uint64_t> rng;
+
+    //Per-game blocks
+    std::vector<uint32_t> occupied; //gridHeight rows per game
+    std::vector<uint8_t> moves; //ringBytes 2-bit moves per game
+
+    //Results of the vector pass, used by the scalar pass
+    std::vector<int32_t> nextDirection;
+    std::vector<int32_t> nextCell;
+    std::vector<uint8_t> hitFlags; //StepHitWall, StepAteFruit and StepAteSpecialFruit before the body is checked
+
+    //Step results
+    std::vector<int32_t> stepRewards;
+    std::vector<uint8_t> stepDones;
+    std::vector<int32_t> stepFinalScores;
+};
+
+/**
+ Writes a game state as byte planes in the layout BatchEnv::writePlanes uses
+ @param state The game state
+ @param planes Room for obsBytes bytes
+ */
+void writeStatePlanes(const GameState &state, uint8_t planes[]);
+
+/**
+ Writes a game state as bit planes in the layout BatchEnv::writeBitPlanes uses
+ @param state The game state
+ @param planes Room for obsBitWords words
+ */
+void writeStateBitPlanes(const GameState &state, uint32_t planes[]);
+
+#endif
@@ -0,0 +1,55 @@
+//Bit-parallel board searches. A board is one 32-bit word per row (the same layout
+//as GameState::occupied), so a flood fill grows a whole row of the frontier with a
+//few shifts and masks instead of visiting cells one at a time.
+
+#ifndef BITBOARD_HPP
+#define BITBOARD_HPP
+
+#include "game_state.hpp"
+
+const uint32_t boardRowMask = (gridWidth == 32) ? 0xFFFFFFFFu : ((1u << gridWidth) - 1); //Bits that are on the board in each row
+
+//What a flood fill found
+struct FloodResult {
+    int reachable; //Number of free cells reachable from the start, including the start
+    int targetDistance; //Moves from the start to the target, or -1 if it cannot be reached
+    int layerCount; //Number of distance layers, counting the start as layer 0
+};
+
+/**
+ Fills an array of rows with the cells the snake does not cover
+ @param state The game state
+ @param freeRows The rows to fill in
+ @param tailIsFree True to count the tail as free, since it moves out of the way on the next move
+ */
+void freeBoard(const GameState &state, uint32_t freeRows[gridHeight], bool tailIsFree);
+
+/**
+ Flood fills the free cells from a start cell, one distance layer at a time
+ @param freeRows The free cells, one row per word
+ @param start The cell to start from (it does not need to be free)
+ @param target A cell to measure the distance to, or -1
+ @param layers If not null, receives the cells at each distance, up to maxLayers layers
+ @param maxLayers The number of layers `layers` has room for
+ @return The number of reachable cells, the distance to the target and the number of layers
+ */
+FloodResult floodFill(const uint32_t freeRows[gridHeight], int start, int target, uint32_t (*layers)[gridHeight], int maxLayers);
+
+/**
+ Counts the free cells reachable from a start cell. Faster than floodFill when distances
+ are not needed, because each row is filled along whole runs of free cells at once.
+ @param freeRows The free cells, one row per word
+ @param start The cell to start from (it does not need to be free)
+ @param reached If not null, receives the reachable cells
+ @return The number of reachable cells, including the start
+ */
+int reachableCount(const uint32_t freeRows[gridHeight], int start, uint32_t reached[gridHeight]);
+
+/**
+ Counts the set bits of a board
+ @param rows The board
+ @return The number of cells set
+ */
+int countCells(const uint32_t rows[gridHeight]);
+
+#endif
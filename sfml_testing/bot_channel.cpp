@@ -0,0 +1,327 @@
+//Shared-memory bot channel, see bot_channel.h and bot_channel.hpp. Both sides live in
+//this file so they agree on the protocol; the shared words are accessed with the
+//compiler's atomic builtins since the region is a plain C struct.
+
+#include "bot_channel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#elif defined(__APPLE__)
+//Darwin's futex equivalent, which libc++ also uses for std::atomic::wait
+extern "C" int __ulock_wait(uint32_t operation, void *address, uint64_t value, uint32_t timeoutUs);
+extern "C" int __ulock_wake(uint32_t operation, void *address, uint64_t wakeValue);
+const uint32_t ulockCompareAndWaitShared = 3;
+const uint32_t ulockWakeAll = 0x100;
+#endif
+using namespace std;
+
+static_assert(sizeof(GameView) == sizeof(GameState), "The channel copies GameState into a GameView");
+static_assert(offsetof(SnakeChannel, replySequence) == 64, "The bot's words must start a new cache line");
+
+const int hostSpinUs = 200; //The game polls this long for an answer before sleeping, given a spare core
+
+/**
+ Tells the core a spin loop is waiting, which saves power and frees the sibling hyperthread
+ */
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+/**
+ Returns microseconds since a point in time
+ @param start The point in time
+ @return Elapsed microseconds
+ */
+static long elapsedUs(chrono::steady_clock::time_point start) {
+    return (long) chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ Sleeps while a shared word still holds a value, or until the timeout
+ @param word The word in the shared region
+ @param expected The value to sleep on
+ @param timeoutUs Longest time to sleep
+ */
+static void waitOnWord(uint32_t *word, uint32_t expected, long timeoutUs) {
+    timeoutUs = max(timeoutUs, 1L);
+#if defined(__linux__)
+    struct timespec timeout = {timeoutUs / 1000000, (timeoutUs % 1000000) * 1000};
+    syscall(SYS_futex, word, FUTEX_WAIT, expected, &timeout, nullptr, 0); //Not FUTEX_PRIVATE: the word is shared between processes
+#elif defined(__APPLE__)
+    __ulock_wait(ulockCompareAndWaitShared, word, expected, (uint32_t) min(timeoutUs, (long) UINT32_MAX));
+#else
+    (void) word;
+    (void) expected;
+    usleep((useconds_t) min(timeoutUs, 100L));
+#endif
+}
+
+/**
+ Wakes everything sleeping on a shared word
+ @param word The word in the shared region
+ */
+static void wakeWord(uint32_t *word) {
+#if defined(__linux__)
+    syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#elif defined(__APPLE__)
+    __ulock_wake(ulockCompareAndWaitShared | ulockWakeAll, word, 0);
+#else
+    (void) word;
+#endif
+}
+
+/**
+ Turns a channel name into a shm_open name
+ @param name The name as given
+ @return The name starting with '/'
+ */
+static string sharedName(const string &name) {
+    return (!name.empty() && name[0] == '/') ? name : "/" + name;
+}
+
+/**
+ Checks whether a process is still running
+ @param pid The process id
+ @return True if the process exists, even if it belongs to another user
+ */
+static bool processAlive(uint32_t pid) {
+    return pid != 0 && (kill((pid_t) pid, 0) == 0 || errno == EPERM);
+}
+
+/**
+ Finds the process of the game that created an existing region
+ @param name The shm_open name
+ @return The game's process id while it is running, 0 if there is no region or its game is gone
+ */
+static uint32_t liveOwner(const string &name) {
+    int file = shm_open(name.c_str(), O_RDONLY, 0);
+    if (file < 0) {
+        return 0;
+    }
+    struct stat info;
+    void *mapped = MAP_FAILED;
+    if (fstat(file, &info) == 0 && (size_t) info.st_size >= sizeof(SnakeChannel)) {
+        mapped = mmap(nullptr, sizeof(SnakeChannel), PROT_READ, MAP_SHARED, file, 0);
+    }
+    ::close(file);
+    if (mapped == MAP_FAILED) {
+        return 0;
+    }
+    const SnakeChannel *channel = (const SnakeChannel *) mapped;
+    uint32_t pid = 0;
+    if (__atomic_load_n(&channel->magic, __ATOMIC_ACQUIRE) == SNAKE_CHANNEL_MAGIC && !__atomic_load_n(&channel->closed, __ATOMIC_ACQUIRE)) {
+        pid = channel->gamePid;
+    }
+    munmap(mapped, sizeof(SnakeChannel));
+    return (pid != (uint32_t) getpid() && processAlive(pid)) ? pid : 0;
+}
+
+BotChannel::BotChannel() {
+    channel = nullptr;
+    totals = {0, 0, 0.0, 0.0, 0.0};
+}
+
+BotChannel::~BotChannel() {
+    close();
+}
+
+bool BotChannel::create(const string &newName, string &error) {
+    close();
+    name = sharedName(newName);
+    uint32_t owner = liveOwner(name);
+    if (owner != 0) {
+        error = name + " is in use by the game with process id " + to_string(owner);
+        return false;
+    }
+    shm_unlink(name.c_str()); //Left behind by a game that crashed
+    int file = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (file < 0) {
+        error = "shm_open " + name + ": " + strerror(errno);
+        return false;
+    }
+    void *mapped = MAP_FAILED;
+    if (ftruncate(file, sizeof(SnakeChannel)) == 0) {
+        mapped = mmap(nullptr, sizeof(SnakeChannel), PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    }
+    ::close(file);
+    if (mapped == MAP_FAILED) {
+        error = "mapping " + name + ": " + strerror(errno);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    channel = (SnakeChannel *) mapped;
+    memset(channel, 0, sizeof(SnakeChannel));
+    channel->version = SNAKE_CHANNEL_VERSION;
+    channel->gamePid = (uint32_t) getpid();
+    __atomic_store_n(&channel->magic, SNAKE_CHANNEL_MAGIC, __ATOMIC_RELEASE); //Last, so a bot never sees a half-made channel
+    totals = {0, 0, 0.0, 0.0, 0.0};
+    return true;
+}
+
+void BotChannel::close() {
+    if (!channel) {
+        return;
+    }
+    __atomic_store_n(&channel->closed, 1u, __ATOMIC_SEQ_CST);
+    wakeWord(&channel->stateSequence);
+    munmap(channel, sizeof(SnakeChannel));
+    shm_unlink(name.c_str()); //A connected bot keeps its mapping until it lets go
+    channel = nullptr;
+}
+
+bool BotChannel::attached() const {
+    return channel && __atomic_load_n(&channel->botAttached, __ATOMIC_ACQUIRE) != 0;
+}
+
+int BotChannel::decide(const GameState &state, int deadlineUs) {
+    if (!attached()) {
+        return state.direction;
+    }
+    auto start = chrono::steady_clock::now();
+
+    //Publish the board under the sequence lock
+    uint32_t sequence = __atomic_load_n(&channel->stateSequence, __ATOMIC_RELAXED);
+    __atomic_store_n(&channel->stateSequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&channel->state, &state, sizeof(GameView));
+    uint32_t published = sequence + 2;
+    __atomic_store_n(&channel->stateSequence, published, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&channel->botSleeping, __ATOMIC_SEQ_CST)) {
+        wakeWord(&channel->stateSequence);
+    }
+
+    //Poll for the answer, then sleep until it comes or the deadline passes. With a single
+    //core the bot cannot run while the game polls, so go straight to sleep.
+    static const int spinUs = (thread::hardware_concurrency() > 1) ? hostSpinUs : 0;
+    while (true) {
+        uint32_t reply = __atomic_load_n(&channel->replySequence, __ATOMIC_ACQUIRE);
+        long elapsed = elapsedUs(start);
+        if (reply == published) {
+            int direction = (int) __atomic_load_n(&channel->direction, __ATOMIC_RELAXED);
+            double roundTripUs = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+            totals.decisions++;
+            totals.totalUs += roundTripUs;
+            totals.maxUs = max(totals.maxUs, roundTripUs);
+            totals.botUs += __atomic_load_n(&channel->decideNs, __ATOMIC_RELAXED) / 1000.0;
+            return (direction >= Up && direction <= Right) ? direction : state.direction;
+        }
+        if (elapsed >= deadlineUs) {
+            totals.missed++;
+            uint32_t bot = __atomic_load_n(&channel->botPid, __ATOMIC_ACQUIRE);
+            //A bot that crashed never detached; unless another has connected since and
+            //written its own pid, stop waiting for it
+            if (bot != 0 && !processAlive(bot) &&
+                __atomic_compare_exchange_n(&channel->botPid, &bot, 0u, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+                __atomic_store_n(&channel->botAttached, 0u, __ATOMIC_SEQ_CST);
+            }
+            return state.direction;
+        }
+        if (elapsed < spinUs) {
+            cpuRelax();
+            continue;
+        }
+        __atomic_store_n(&channel->gameSleeping, 1u, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&channel->replySequence, __ATOMIC_SEQ_CST) == reply) {
+            waitOnWord(&channel->replySequence, reply, deadlineUs - elapsed);
+        }
+        __atomic_store_n(&channel->gameSleeping, 0u, __ATOMIC_RELAXED);
+    }
+}
+
+BotChannelStats BotChannel::stats() const {
+    return totals;
+}
+
+SnakeChannel *snake_channel_open(const char *name) {
+    string path = sharedName(name);
+    int file = shm_open(path.c_str(), O_RDWR, 0);
+    if (file < 0) {
+        return nullptr;
+    }
+    struct stat info;
+    void *mapped = MAP_FAILED;
+    if (fstat(file, &info) == 0 && (size_t) info.st_size >= sizeof(SnakeChannel)) {
+        mapped = mmap(nullptr, sizeof(SnakeChannel), PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    }
+    ::close(file);
+    if (mapped == MAP_FAILED) {
+        return nullptr;
+    }
+    SnakeChannel *channel = (SnakeChannel *) mapped;
+    if (__atomic_load_n(&channel->magic, __ATOMIC_ACQUIRE) != SNAKE_CHANNEL_MAGIC || channel->version != SNAKE_CHANNEL_VERSION) {
+        munmap(mapped, sizeof(SnakeChannel));
+        return nullptr;
+    }
+    __atomic_store_n(&channel->botPid, (uint32_t) getpid(), __ATOMIC_SEQ_CST);
+    __atomic_store_n(&channel->botAttached, 1u, __ATOMIC_SEQ_CST);
+    return channel;
+}
+
+int snake_channel_wait(SnakeChannel *channel, uint32_t lastSequence, int spinUs, int timeoutMs, GameView *view, uint32_t *sequence) {
+    auto start = chrono::steady_clock::now();
+    long timeoutUs = timeoutMs * 1000L;
+    while (true) {
+        if (__atomic_load_n(&channel->closed, __ATOMIC_ACQUIRE)) {
+            return SNAKE_CHANNEL_CLOSED;
+        }
+        uint32_t before = __atomic_load_n(&channel->stateSequence, __ATOMIC_ACQUIRE);
+        if ((before & 1) == 0 && before != lastSequence) {
+            //Copy, then check the game did not start writing meanwhile
+            memcpy(view, &channel->state, sizeof(GameView));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&channel->stateSequence, __ATOMIC_RELAXED) == before) {
+                *sequence = before;
+                return SNAKE_CHANNEL_OK;
+            }
+            continue;
+        }
+        long elapsed = elapsedUs(start);
+        if (elapsed >= timeoutUs) {
+            return SNAKE_CHANNEL_TIMEOUT;
+        }
+        if (elapsed < spinUs) {
+            cpuRelax();
+            continue;
+        }
+        __atomic_store_n(&channel->botSleeping, 1u, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&channel->stateSequence, __ATOMIC_SEQ_CST) == before && !__atomic_load_n(&channel->closed, __ATOMIC_SEQ_CST)) {
+            waitOnWord(&channel->stateSequence, before, timeoutUs - elapsed);
+        }
+        __atomic_store_n(&channel->botSleeping, 0u, __ATOMIC_RELAXED);
+    }
+}
+
+void snake_channel_reply(SnakeChannel *channel, uint32_t sequence, int direction, uint32_t decideNs) {
+    __atomic_store_n(&channel->direction, (uint32_t) direction, __ATOMIC_RELAXED);
+    __atomic_store_n(&channel->decideNs, decideNs, __ATOMIC_RELAXED);
+    __atomic_store_n(&channel->replySequence, sequence, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&channel->gameSleeping, __ATOMIC_SEQ_CST)) {
+        wakeWord(&channel->replySequence);
+    }
+}
+
+void snake_channel_close(SnakeChannel *channel) {
+    if (!channel) {
+        return;
+    }
+    __atomic_store_n(&channel->botAttached, 0u, __ATOMIC_SEQ_CST);
+    uint32_t self = (uint32_t) getpid();
+    __atomic_compare_exchange_n(&channel->botPid, &self, 0u, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    munmap(channel, sizeof(SnakeChannel));
+}
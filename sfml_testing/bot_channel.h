@@ -0,0 +1,105 @@
+//Shared-memory channel between the game and a bot running as a separate process.
+//The game creates a named shm_open region; the bot maps it, waits for a board and
+//answers with a direction. Nothing passes through the kernel on the fast path: both
+//sides spin on the shared words for a short while and only sleep on a futex (a
+//__ulock on macOS) when the other side is slow, and only wake the other side when
+//it is actually asleep.
+//
+//Protocol, for bots written in other languages:
+//  1. The game bumps stateSequence to an odd number, writes the board into `state`,
+//     then bumps it to the next even number (a sequence lock). A bot that reads
+//     stateSequence, copies the state and reads the same even number again has a
+//     consistent copy.
+//  2. The bot writes direction and decideNs, then sets replySequence to the
+//     stateSequence it answered. If gameSleeping is set, it wakes the futex on
+//     replySequence.
+//  3. The game waits for replySequence to match until its deadline, then plays the
+//     current direction instead. Late replies carry an old sequence and are ignored.
+//The bot sets botAttached while it is connected; until then the game does not wait.
+//It writes its process id to botPid first, so when an answer is late the game can tell
+//a bot that crashed without detaching from a slow one, and stop waiting for it.
+//The region is torn down when the game sets `closed`. The game stores its process id in
+//gamePid, so a second game asked for the same name can tell a live channel from one
+//left behind by a game that crashed.
+
+#ifndef BOT_CHANNEL_H
+#define BOT_CHANNEL_H
+
+#include "snake_bot.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SNAKE_CHANNEL_MAGIC 0x434B4E53u //"SNKC"
+#define SNAKE_CHANNEL_VERSION 1
+
+//Return codes of snake_channel_wait
+#define SNAKE_CHANNEL_OK 0
+#define SNAKE_CHANNEL_TIMEOUT 1
+#define SNAKE_CHANNEL_CLOSED 2
+
+//Layout of the shared region. The words each side writes sit on their own cache line.
+typedef struct SnakeChannel {
+    //Written by the game
+    uint32_t magic;
+    uint32_t version;
+    uint32_t stateSequence; //Odd while the game writes the state; futex word the bot sleeps on
+    uint32_t gameSleeping; //Set while the game sleeps on replySequence
+    uint32_t closed; //Set when the game goes away
+    uint32_t gamePid; //Process id of the game that created the channel
+    uint32_t gameReserved[10];
+
+    //Written by the bot
+    uint32_t replySequence; //stateSequence of the latest answer; futex word the game sleeps on
+    uint32_t direction; //SNAKE_ACTION of the latest answer
+    uint32_t decideNs; //Time the bot spent deciding, for the game's statistics
+    uint32_t botAttached; //Set while a bot is connected
+    uint32_t botSleeping; //Set while the bot sleeps on stateSequence
+    uint32_t botPid; //Process id of the connected bot, or 0 if it did not say
+    uint32_t botReserved[10];
+
+    GameView state;
+} SnakeChannel;
+
+/**
+ Connects a bot to a channel created by the game
+ @param name The channel name given to the game
+ @return The mapped channel, or NULL if there is none or it is for another version
+ */
+SnakeChannel *snake_channel_open(const char *name);
+
+/**
+ Waits for a board newer than the last one answered
+ @param channel The channel
+ @param lastSequence The sequence of the last board answered, 0 at first
+ @param spinUs How long to poll before going to sleep
+ @param timeoutMs How long to wait in total
+ @param view Receives a consistent copy of the board
+ @param sequence Receives the board's sequence, to pass to snake_channel_reply
+ @return SNAKE_CHANNEL_OK, SNAKE_CHANNEL_TIMEOUT or SNAKE_CHANNEL_CLOSED
+ */
+int snake_channel_wait(SnakeChannel *channel, uint32_t lastSequence, int spinUs, int timeoutMs, GameView *view, uint32_t *sequence);
+
+/**
+ Answers a board
+ @param channel The channel
+ @param sequence The sequence snake_channel_wait returned with the board
+ @param direction The SNAKE_ACTION to play
+ @param decideNs Time spent deciding, or 0
+ */
+void snake_channel_reply(SnakeChannel *channel, uint32_t sequence, int direction, uint32_t decideNs);
+
+/**
+ Disconnects a bot and unmaps the channel
+ @param channel The channel, or NULL
+ */
+void snake_channel_close(SnakeChannel *channel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
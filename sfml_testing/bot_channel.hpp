@@ -0,0 +1,70 @@
+//Game side of the shared-memory bot channel described in bot_channel.h.
+
+#ifndef BOT_CHANNEL_HPP
+#define BOT_CHANNEL_HPP
+
+#include "game_state.hpp"
+#include "bot_channel.h"
+
+#include <string>
+
+//Round-trip statistics of a channel
+struct BotChannelStats {
+    long decisions; //Boards answered in time
+    long missed; //Boards the bot did not answer before the deadline
+    double totalUs; //Summed round trips of the answered boards
+    double maxUs;
+    double botUs; //Summed time the bot reported deciding
+};
+
+//A channel created by the game, which a bot process connects to
+class BotChannel {
+public:
+    BotChannel();
+    ~BotChannel();
+
+    BotChannel(const BotChannel &) = delete;
+    BotChannel &operator=(const BotChannel &) = delete;
+
+    /**
+     Creates the shared region, replacing a stale one of the same name. A region whose
+     game is still running is left alone.
+     @param name The channel name; a leading '/' is added if missing
+     @param error Receives the reason when creating fails
+     @return False if the region could not be created or another game is using the name
+     */
+    bool create(const std::string &name, std::string &error);
+
+    /**
+     Tells a connected bot the channel is closing, then removes the region
+     */
+    void close();
+
+    /**
+     Checks whether a bot is connected
+     @return True while a bot process has the channel open
+     */
+    bool attached() const;
+
+    /**
+     Publishes the board and waits for the bot's answer
+     @param state The current game state
+     @param deadlineUs How long to wait for the answer
+     @return The bot's direction, or the current direction if no bot answered in time.
+     A bot whose process has exited is detached, so later calls do not wait for it.
+     */
+    int decide(const GameState &state, int deadlineUs);
+
+    /**
+     Returns the round-trip statistics so far
+     @return The statistics
+     */
+    BotChannelStats stats() const;
+
+private:
+    SnakeChannel *channel; //The mapped region, or null
+    std::string name;
+    BotChannelStats totals;
+};
+
+#endif
@@ -0,0 +1,62 @@
+//Example bot library for snake_bot.h: moves toward the fruit along any move that does
+//not end the game straight away, avoiding dead ends one step ahead.
+//Build with: cc -O2 -shared -fPIC example_bot.c -o example_bot.so
+//Play it with: snake_sim --bot ./example_bot.so bfs
+
+#include "snake_bot.h"
+
+#include <stdlib.h>
+
+static const int moveDX[4] = {0, 0, -1, 1};
+static const int moveDY[4] = {-1, 1, 0, 0};
+
+/**
+ Checks whether the head can move onto a position without dying
+ @param view The game
+ @param x The x-coordinate on the board
+ @param y The y-coordinate on the board
+ @return Nonzero if the position is on the board and free, or is the tail
+ */
+static int isSafe(const GameView *view, int x, int y) {
+    if (x < 0 || x >= SNAKE_BOARD_WIDTH || y < 0 || y >= SNAKE_BOARD_HEIGHT) {
+        return 0;
+    }
+    return !snake_view_occupied(view, x, y) || y * SNAKE_BOARD_WIDTH + x == view->tailCell;
+}
+
+int snake_bot_init(int abiVersion, int boardWidth, int boardHeight) {
+    if (abiVersion != SNAKE_BOT_ABI_VERSION || boardWidth != SNAKE_BOARD_WIDTH || boardHeight != SNAKE_BOARD_HEIGHT) {
+        return SNAKE_BOT_UNSUPPORTED;
+    }
+    return SNAKE_BOT_OK;
+}
+
+int snake_bot_decide(const GameView *view) {
+    int headX = view->headCell % SNAKE_BOARD_WIDTH;
+    int headY = view->headCell / SNAKE_BOARD_WIDTH;
+    int bestDirection = view->direction;
+    int bestScore = -1000000;
+    for (int direction = 0; direction < 4; ++direction) {
+        int x = headX + moveDX[direction];
+        int y = headY + moveDY[direction];
+        if (direction == (view->direction ^ 1) || !isSafe(view, x, y)) {
+            continue;
+        }
+        int freeNeighbours = 0;
+        for (int next = 0; next < 4; ++next) {
+            freeNeighbours += isSafe(view, x + moveDX[next], y + moveDY[next]);
+        }
+        int score = ((freeNeighbours > 0) ? 1000 : 0) + freeNeighbours;
+        if (view->fruitX >= 0) {
+            score -= 4 * (abs(x - view->fruitX) + abs(y - view->fruitY));
+        }
+        if (score > bestScore) {
+            bestScore = score;
+            bestDirection = direction;
+        }
+    }
+    return bestDirection;
+}
+
+void snake_bot_free(void) {
+}
@@ -0,0 +1,236 @@
+//Room client, see game_client.hpp.
+
+#include "game_client.hpp"
+
+using namespace std;
+
+const int joinRetryMs = 250; //Time between join attempts
+const int pingMs = 500; //Time between round-trip measurements
+
+GameClient::GameClient() {
+    serverPort = 0;
+    player = -1;
+    serverTickMs = defaultTickMs;
+    width = 0;
+    height = 0;
+    inputSequence = 0;
+    direction = Right;
+    inputTick = 0;
+    newestTick = 0;
+    roundTrip = -1;
+    lastPing = sf::milliseconds(-pingMs); //Measure the round trip right after joining
+}
+
+bool GameClient::connect(const sf::IpAddress &address, unsigned short port, uint32_t room, int timeoutMs, string &error) {
+    if (socket.bind(sf::Socket::AnyPort) != sf::Socket::Done) {
+        error = "could not open a UDP socket";
+        return false;
+    }
+    socket.setBlocking(false);
+    serverAddress = address;
+    serverPort = port;
+
+    sf::Time deadline = clock.getElapsedTime() + sf::milliseconds(timeoutMs);
+    sf::SocketSelector selector;
+    selector.add(socket);
+    while (clock.getElapsedTime() < deadline) {
+        sf::Packet join;
+        join << MessageJoin << protocolVersion << room;
+        socket.send(join, serverAddress, serverPort);
+        if (!selector.wait(sf::milliseconds(joinRetryMs))) {
+            continue;
+        }
+        sf::Packet packet;
+        sf::IpAddress sender;
+        unsigned short senderPort;
+        while (socket.receive(packet, sender, senderPort) == sf::Socket::Done) {
+            if (sender != serverAddress || senderPort != serverPort) {
+                continue;
+            }
+            uint8_t type = 0;
+            packet >> type;
+            if (type == MessageRoomFull) {
+                error = "the room is full";
+                return false;
+            }
+            uint8_t id = 0;
+            uint16_t welcomeWidth = 0, welcomeHeight = 0, tick = 0;
+            packet >> id >> welcomeWidth >> welcomeHeight >> tick;
+            if (type == MessageWelcome && packet) {
+                player = id;
+                width = welcomeWidth;
+                height = welcomeHeight;
+                serverTickMs = tick;
+                lastHeard = clock.getElapsedTime();
+                return true;
+            }
+        }
+    }
+    error = "no answer from " + serverAddress.toString() + ":" + to_string(serverPort);
+    return false;
+}
+
+void GameClient::disconnect() {
+    if (player < 0) {
+        return;
+    }
+    sf::Packet leave;
+    leave << MessageLeave << (uint8_t) player;
+    socket.send(leave, serverAddress, serverPort);
+    player = -1;
+}
+
+void GameClient::setDirection(int newDirection, uint32_t tick) {
+    if (newDirection == direction && tick == inputTick) {
+        return;
+    }
+    direction = (uint8_t) newDirection;
+    inputTick = tick;
+    inputSequence++;
+    sendInput();
+}
+
+bool GameClient::poll() {
+    bool updated = false;
+    sf::Packet packet;
+    sf::IpAddress sender;
+    unsigned short senderPort;
+    while (socket.receive(packet, sender, senderPort) == sf::Socket::Done) {
+        if (sender != serverAddress || senderPort != serverPort) {
+            continue;
+        }
+        lastHeard = clock.getElapsedTime();
+        uint8_t type = 0;
+        packet >> type;
+        uint32_t pingTime = 0;
+        if (type == MessagePong && packet >> pingTime) {
+            float sample = float(lastHeard.asMilliseconds() - (int32_t) pingTime);
+            roundTrip = (roundTrip < 0) ? sample : roundTrip + (sample - roundTrip) / 8;
+        }
+        //States can arrive out of order; an older one is dropped. One whose baseline is
+        //gone cannot be read, and the acknowledgements make the server send a keyframe.
+        if (type == MessageState && readSnapshot(packet, history, incoming) && (newestTick == 0 || (int32_t) (incoming.tick - newestTick) > 0)) {
+            newestTick = incoming.tick;
+            newestArrival = lastHeard;
+            swap(history[newestTick & (snapshotHistory - 1)], incoming);
+            updated = true;
+        }
+    }
+    if (updated) {
+        //A new life starts facing its spawn direction, which the server used instead of ours
+        for (const SnapshotSnake &snake : state().snakes) {
+            if (snake.player == player && snake.inputSequence == inputSequence) {
+                direction = snake.direction;
+            }
+        }
+    }
+    if (player >= 0 && (updated || clock.getElapsedTime() - lastSent >= sf::milliseconds(serverTickMs))) {
+        sendInput();
+    }
+    if (player >= 0 && clock.getElapsedTime() - lastPing >= sf::milliseconds(pingMs)) {
+        lastPing = clock.getElapsedTime();
+        sf::Packet ping;
+        ping << MessagePing << (uint32_t) lastPing.asMilliseconds();
+        socket.send(ping, serverAddress, serverPort);
+    }
+    return updated;
+}
+
+bool GameClient::connected() const {
+    return player >= 0 && clock.getElapsedTime() - lastHeard < sf::milliseconds(clientTimeoutMs);
+}
+
+const RoomSnapshot &GameClient::state() const {
+    return history[newestTick & (snapshotHistory - 1)];
+}
+
+int GameClient::playerId() const {
+    return player;
+}
+
+int GameClient::tickMs() const {
+    return serverTickMs;
+}
+
+int GameClient::boardWidth() const {
+    return width;
+}
+
+int GameClient::boardHeight() const {
+    return height;
+}
+
+sf::Time GameClient::now() const {
+    return clock.getElapsedTime();
+}
+
+sf::Time GameClient::stateTime() const {
+    return newestArrival;
+}
+
+float GameClient::roundTripMs() const {
+    return (roundTrip < 0) ? float(serverTickMs) : roundTrip;
+}
+
+void GameClient::sendInput() {
+    sf::Packet input;
+    input << MessageInput << (uint8_t) player << inputSequence << direction << newestTick << inputTick;
+    socket.send(input, serverAddress, serverPort);
+    lastSent = clock.getElapsedTime();
+}
+
+SpectatorClient::SpectatorClient() {
+    open = false;
+    newestTick = 0;
+}
+
+bool SpectatorClient::connect(const sf::IpAddress &address, unsigned short port, uint32_t room, int timeoutMs, string &error) {
+    if (socket.connect(address, port, sf::milliseconds(timeoutMs)) != sf::Socket::Done) {
+        error = "could not connect to " + address.toString() + ":" + to_string(port);
+        return false;
+    }
+    sf::Packet watch;
+    watch << MessageWatch << protocolVersion << room;
+    if (socket.send(watch) != sf::Socket::Done) {
+        error = "the relay closed the connection";
+        return false;
+    }
+    socket.setBlocking(false);
+    open = true;
+    return true;
+}
+
+bool SpectatorClient::poll() {
+    bool updated = false;
+    sf::Packet packet;
+    while (open) {
+        sf::Socket::Status status = socket.receive(packet);
+        if (status == sf::Socket::Disconnected || status == sf::Socket::Error) {
+            open = false;
+        }
+        if (status != sf::Socket::Done) {
+            break;
+        }
+        //The relay only skips frames up to a keyframe, so every delta's baseline is here
+        uint8_t type = 0;
+        packet >> type;
+        if (type == MessageState && readSnapshot(packet, history, incoming)) {
+            newestTick = incoming.tick;
+            swap(history[newestTick & (snapshotHistory - 1)], incoming);
+            updated = true;
+        }
+    }
+    return updated;
+}
+
+bool SpectatorClient::connected() const {
+    return open;
+}
+
+const RoomSnapshot &SpectatorClient::state() const {
+    return history[newestTick & (snapshotHistory - 1)];
+}
+
+bool SpectatorClient::started() const {
+    return newestTick != 0;
+}
@@ -0,0 +1,153 @@
+//Client side of the room protocol: joins a snake_server, sends the player's direction
+//and keeps the newest room state the server broadcast. SpectatorClient watches a room
+//through the server's spectator relay instead.
+
+#ifndef GAME_CLIENT_HPP
+#define GAME_CLIENT_HPP
+
+#include "net_protocol.hpp"
+
+#include <SFML/Network.hpp>
+
+#include <string>
+
+class GameClient {
+public:
+    GameClient();
+
+    /**
+     Joins a server, repeating the join until it is answered
+     @param address The server address
+     @param port The server port
+     @param room The room to join on that server
+     @param timeoutMs How long to keep trying
+     @param error Receives the reason when joining fails
+     @return False if the server did not let the player in
+     */
+    bool connect(const sf::IpAddress &address, unsigned short port, uint32_t room, int timeoutMs, std::string &error);
+
+    /**
+     Tells the server the player is leaving
+     */
+    void disconnect();
+
+    /**
+     Sends a new direction right away
+     @param direction The direction constant
+     @param tick The tick it is meant for, 0 for whichever the server steps next
+     */
+    void setDirection(int direction, uint32_t tick = 0);
+
+    /**
+     Handles the datagrams that arrived. Every new state is acknowledged with the current
+     input; without new states the input is still resent once a tick, which tells the
+     server the player is there. Also measures the round trip now and then.
+     @return True if a newer room state arrived
+     */
+    bool poll();
+
+    /**
+     Checks whether the server is still sending
+     @return False once nothing has arrived for clientTimeoutMs
+     */
+    bool connected() const;
+
+    const RoomSnapshot &state() const;
+    int playerId() const;
+    int tickMs() const;
+    int boardWidth() const;
+    int boardHeight() const;
+
+    /**
+     Returns the client's clock, which stateTime() and the round trip are measured on
+     @return The time since the client was created
+     */
+    sf::Time now() const;
+
+    /**
+     Returns when the newest state arrived
+     @return The time on the client's clock
+     */
+    sf::Time stateTime() const;
+
+    /**
+     Returns the smoothed round trip to the server
+     @return Milliseconds, or the tick length before the first measurement
+     */
+    float roundTripMs() const;
+
+private:
+    /**
+     Sends the current input
+     */
+    void sendInput();
+
+    sf::UdpSocket socket;
+    sf::IpAddress serverAddress;
+    unsigned short serverPort;
+    sf::Clock clock;
+    sf::Time lastHeard;
+    sf::Time lastSent;
+    sf::Time lastPing;
+    sf::Time newestArrival;
+    float roundTrip; //Smoothed, in milliseconds; negative before the first pong
+    int player; //-1 until welcomed
+    int serverTickMs;
+    int width; //Board size from the welcome
+    int height;
+    uint32_t inputSequence;
+    uint8_t direction;
+    uint32_t inputTick; //Tick the current input is meant for
+    uint32_t newestTick; //Tick of the newest state, 0 before the first
+    RoomSnapshot history[snapshotHistory]; //States received, kept as baselines for the next ones
+    RoomSnapshot incoming;
+};
+
+class SpectatorClient {
+public:
+    SpectatorClient();
+
+    /**
+     Connects to a server's spectator relay and asks to watch a room
+     @param address The server address
+     @param port The relay's TCP port
+     @param room The room to watch
+     @param timeoutMs How long to wait for the connection
+     @param error Receives the reason when connecting fails
+     @return False if the relay could not be reached
+     */
+    bool connect(const sf::IpAddress &address, unsigned short port, uint32_t room, int timeoutMs, std::string &error);
+
+    /**
+     Reads the frames that arrived
+     @return True if a newer room state arrived
+     */
+    bool poll();
+
+    /**
+     Checks whether the relay is still connected
+     @return False once it closed the connection
+     */
+    bool connected() const;
+
+    /**
+     Returns the newest state
+     @return The state; empty before the first keyframe
+     */
+    const RoomSnapshot &state() const;
+
+    /**
+     Checks whether a state has arrived
+     @return False until the first keyframe
+     */
+    bool started() const;
+
+private:
+    sf::TcpSocket socket;
+    bool open;
+    uint32_t newestTick; //Tick of the newest state, 0 before the first
+    RoomSnapshot history[snapshotHistory]; //Each frame is a delta against the one before
+    RoomSnapshot incoming;
+};
+
+#endif
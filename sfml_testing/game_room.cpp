@@ -0,0 +1,255 @@
+//One room of the authoritative server, see game_room.hpp.
+
+#include "game_room.hpp"
+
+#include <algorithm>
+using namespace std;
+
+const int cellsPerFruit = 100; //Board cells for every fruit kept on the board
+
+GameRoom::GameRoom(int width, int height, int tickMs, uint64_t seed)
+    : game(width, height, roomPlayers, max(1, width * height / cellsPerFruit), seed), tickLength(max(1, tickMs)) {
+    //Every slot starts empty; snakes come on the board as players join
+    for (int i = 0; i < roomPlayers; ++i) {
+        game.removeSnake(i);
+        players[i] = RoomPlayer{false, sf::IpAddress::None, 0, 0, Right, 0, {}, 0, 0, sf::Time::Zero, 0};
+        joined[i] = 0;
+        directions[i] = Right;
+        inputSequences[i] = 0;
+        lives[i] = 0;
+    }
+    totals = RoomStats{0, 0, 0, 0};
+    spectatorTick = 0;
+    spectatorKeyframe = 0;
+}
+
+bool GameRoom::hasPlayer(const sf::IpAddress &address, unsigned short port) const {
+    return slots.count(endpointKey(address, port)) != 0;
+}
+
+void GameRoom::dropEndpoint(const sf::IpAddress &address, unsigned short port) {
+    map<uint64_t, int>::iterator slot = slots.find(endpointKey(address, port));
+    if (slot != slots.end()) {
+        dropPlayer(slot->second);
+    }
+}
+
+void GameRoom::takeDropped(vector<uint64_t> &endpoints) {
+    endpoints.clear();
+    endpoints.swap(dropped);
+}
+
+int GameRoom::playerCount() const {
+    return (int) slots.size();
+}
+
+int GameRoom::tickMs() const {
+    return tickLength;
+}
+
+const RoomStats &GameRoom::stats() const {
+    return totals;
+}
+
+void GameRoom::handle(sf::Packet &packet, const sf::IpAddress &address, unsigned short port, sf::Time now, sf::UdpSocket &socket) {
+    totals.packetsIn++;
+    uint8_t type = 0;
+    packet >> type;
+    map<uint64_t, int>::iterator slot = slots.find(endpointKey(address, port));
+    int player = (slot != slots.end()) ? slot->second : -1;
+    if (player >= 0) {
+        players[player].lastHeard = now;
+    }
+
+    if (type == MessageJoin) {
+        uint32_t version = 0;
+        uint32_t room = 0; //Already used by the server to pick this room
+        packet >> version >> room;
+        if (!packet || version != protocolVersion) {
+            return;
+        }
+        if (player < 0) {
+            player = (int) (find(joined, joined + roomPlayers, 0) - joined);
+            if (player == roomPlayers) {
+                sf::Packet full;
+                full << MessageRoomFull;
+                socket.send(full, address, port);
+                return;
+            }
+            RoomPlayer &entry = players[player];
+            entry = RoomPlayer{true, address, port, 0, Right, 0, {}, 0, game.tick(), now, 0};
+            if (game.spawnSnake(player)) {
+                entry.direction = game.snake(player).direction;
+                lives[player]++;
+            } else {
+                entry.respawnIn = 1; //Board full, try again next tick
+            }
+            joined[player] = 1;
+            directions[player] = entry.direction;
+            inputSequences[player] = 0;
+            slots[endpointKey(address, port)] = player;
+        }
+        //Answered again for a repeated join, in case the first welcome was lost
+        sf::Packet welcome;
+        welcome << MessageWelcome << (uint8_t) player << (uint16_t) game.width() << (uint16_t) game.height() << (uint16_t) tickLength;
+        socket.send(welcome, address, port);
+    } else if (type == MessageInput) {
+        uint8_t claimed = 0;
+        uint32_t sequence = 0;
+        uint8_t direction = 0;
+        uint32_t ackTick = 0;
+        uint32_t inputTick = 0;
+        packet >> claimed >> sequence >> direction >> ackTick >> inputTick;
+        if (!packet || player < 0 || claimed != player || direction > Right) {
+            return; //Only the address holding a slot may steer its snake
+        }
+        RoomPlayer &entry = players[player];
+        if ((int32_t) (ackTick - entry.ackTick) > 0 && (int32_t) (game.tick() - ackTick) >= 0) {
+            entry.ackTick = ackTick;
+        }
+        uint32_t newest = entry.pendingCount ? entry.pending[entry.pendingCount - 1].sequence : entry.inputSequence;
+        if ((int32_t) (sequence - newest) <= 0) {
+            return; //Inputs arriving out of order are older, so they are dropped
+        }
+        if (inputTick == 0 || (int32_t) (inputTick - game.tick()) <= 1) {
+            //Meant for the next tick, or already too late for its own. A late one sent
+            //before the snake respawned is not a turn of this life.
+            entry.inputSequence = sequence;
+            if (inputTick == 0 || (int32_t) (inputTick - entry.spawnTick) > 0) {
+                entry.direction = direction;
+            }
+            entry.pendingCount = 0;
+        } else {
+            if (entry.pendingCount == pendingInputs) {
+                entry.inputSequence = entry.pending[0].sequence; //No room, use the oldest now
+                entry.direction = entry.pending[0].direction;
+                copy(entry.pending + 1, entry.pending + pendingInputs, entry.pending);
+                entry.pendingCount--;
+            }
+            entry.pending[entry.pendingCount++] = PendingInput{inputTick, sequence, direction};
+        }
+    } else if (type == MessagePing) {
+        uint32_t clientMs = 0;
+        packet >> clientMs;
+        if (packet && player >= 0) {
+            sf::Packet pong;
+            pong << MessagePong << clientMs;
+            socket.send(pong, address, port);
+        }
+    } else if (type == MessageLeave) {
+        uint8_t claimed = 0;
+        packet >> claimed;
+        if (packet && player >= 0 && claimed == player) {
+            dropPlayer(player);
+        }
+    }
+}
+
+void GameRoom::tick(sf::Time now, sf::UdpSocket &socket) {
+    uint32_t nextTick = game.tick() + 1;
+    for (int i = 0; i < roomPlayers; ++i) {
+        //Held inputs whose tick has come, the newest of them winning
+        RoomPlayer &player = players[i];
+        int due = 0;
+        while (due < player.pendingCount && (int32_t) (player.pending[due].tick - nextTick) <= 0) {
+            player.inputSequence = player.pending[due].sequence;
+            player.direction = player.pending[due].direction;
+            due++;
+        }
+        copy(player.pending + due, player.pending + player.pendingCount, player.pending);
+        player.pendingCount -= due;
+        directions[i] = player.direction;
+        inputSequences[i] = player.inputSequence;
+    }
+    game.step(directions, events);
+
+    for (int i = 0; i < roomPlayers; ++i) {
+        RoomPlayer &player = players[i];
+        if (!player.joined) {
+            continue;
+        }
+        if (now - player.lastHeard > sf::milliseconds(clientTimeoutMs)) {
+            dropPlayer(i);
+            continue;
+        }
+        //A dead snake waits, then comes back facing the way it spawned
+        if (!game.snake(i).alive) {
+            if (player.respawnIn == 0) {
+                player.respawnIn = respawnTicks;
+            } else if (--player.respawnIn == 0) {
+                if (game.spawnSnake(i)) {
+                    //Held inputs are all for later ticks, so they still count
+                    player.direction = game.snake(i).direction;
+                    player.spawnTick = game.tick();
+                    lives[i]++;
+                } else {
+                    player.respawnIn = 1;
+                }
+            }
+        }
+    }
+
+    //Encode once per baseline in use and send the same bytes to every client that has it.
+    //A client whose acknowledged state has left the history gets a keyframe.
+    RoomSnapshot &snapshot = history[game.tick() & (snapshotHistory - 1)];
+    captureSnapshot(game, joined, inputSequences, lives, snapshot);
+    encoded.clear();
+    for (const pair<const uint64_t, int> &slot : slots) {
+        const RoomPlayer &player = players[slot.second];
+        uint32_t baseTick = player.ackTick;
+        const RoomSnapshot &baseline = history[baseTick & (snapshotHistory - 1)];
+        if (baseTick == 0 || baseline.tick != baseTick || game.tick() - baseTick >= (uint32_t) snapshotHistory) {
+            baseTick = 0;
+        }
+        size_t index = 0;
+        while (index < encoded.size() && encoded[index].first != baseTick) {
+            index++;
+        }
+        if (index == encoded.size()) {
+            encoded.emplace_back(baseTick, sf::Packet());
+            writeSnapshot(encoded[index].second, snapshot, baseTick ? &baseline : nullptr);
+        }
+        sf::Packet &state = encoded[index].second;
+        if (socket.send(state, player.address, player.port) == sf::Socket::Done) {
+            totals.packetsOut++;
+            totals.bytesOut += (long) state.getDataSize();
+            totals.keyframes += (baseTick == 0);
+        }
+    }
+}
+
+shared_ptr<const SpectatorFrame> GameRoom::spectatorFrame(bool restart) {
+    uint32_t tick = game.tick();
+    bool keyframe = restart || spectatorTick + 1 != tick || tick - spectatorKeyframe >= (uint32_t) spectatorKeyframeTicks;
+    sf::Packet state;
+    writeSnapshot(state, history[tick & (snapshotHistory - 1)], keyframe ? nullptr : &history[(tick - 1) & (snapshotHistory - 1)]);
+
+    //Framed the way sf::TcpSocket sends a packet, so viewers read it as one
+    shared_ptr<SpectatorFrame> frame = make_shared<SpectatorFrame>();
+    frame->tick = tick;
+    frame->keyframe = keyframe;
+    uint32_t size = (uint32_t) state.getDataSize();
+    const uint8_t *data = static_cast<const uint8_t *>(state.getData());
+    frame->bytes = {(uint8_t) (size >> 24), (uint8_t) (size >> 16), (uint8_t) (size >> 8), (uint8_t) size};
+    frame->bytes.insert(frame->bytes.end(), data, data + size);
+    spectatorTick = tick;
+    if (keyframe) {
+        spectatorKeyframe = tick;
+    }
+    return frame;
+}
+
+void GameRoom::dropPlayer(int player) {
+    RoomPlayer &entry = players[player];
+    slots.erase(endpointKey(entry.address, entry.port));
+    dropped.push_back(endpointKey(entry.address, entry.port));
+    game.removeSnake(player);
+    entry.joined = false;
+    entry.respawnIn = 0;
+    entry.ackTick = 0;
+    joined[player] = 0;
+}
+
+uint64_t GameRoom::endpointKey(const sf::IpAddress &address, unsigned short port) {
+    return ((uint64_t) address.toInteger() << 16) | port;
+}
@@ -0,0 +1,149 @@
+//One room of the authoritative server. Clients only send their direction; the room runs
+//the MultiGame at a fixed tick and broadcasts itself after every tick, so a client can
+//never move its snake anywhere the rules do not allow. The state is encoded once per
+//baseline: clients that acknowledged the same tick, which on a healthy connection is
+//nearly all of them, share one encoding, so the work per tick is one step of the game,
+//a few encodings and one send per player.
+//
+//A room does not own a socket or a thread; GameServer hands it its datagrams and calls
+//tick() on time, and the room answers through the server's socket.
+
+#ifndef GAME_ROOM_HPP
+#define GAME_ROOM_HPP
+
+#include "multi_game.hpp"
+#include "net_protocol.hpp"
+#include "spectator_relay.hpp"
+
+#include <SFML/Network.hpp>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+//Counters of a room
+struct RoomStats {
+    long packetsIn;
+    long packetsOut;
+    long bytesOut;
+    long keyframes; //States sent without a baseline
+};
+
+//An input held for the tick it names
+struct PendingInput {
+    uint32_t tick;
+    uint32_t sequence;
+    uint8_t direction;
+};
+
+//One player slot
+struct RoomPlayer {
+    bool joined;
+    sf::IpAddress address;
+    unsigned short port;
+    uint32_t inputSequence; //Newest input used
+    uint8_t direction; //Direction from that input
+    uint32_t ackTick; //Newest state the client has, 0 for none
+    PendingInput pending[pendingInputs]; //Inputs for later ticks, oldest first
+    int pendingCount;
+    uint32_t spawnTick; //Tick the snake last came on the board; older inputs were for its last life
+    sf::Time lastHeard;
+    int respawnIn; //Ticks until a dead snake comes back, 0 while alive
+};
+
+class GameRoom {
+public:
+    /**
+     Sets up an empty room
+     @param width Number of tiles in width
+     @param height Number of tiles in height
+     @param tickMs Milliseconds per tick
+     @param seed The seed for spawns and fruit placement
+     */
+    GameRoom(int width, int height, int tickMs, uint64_t seed);
+
+    /**
+     Handles one datagram from a client
+     @param packet The datagram
+     @param address The sender's address
+     @param port The sender's port
+     @param now The server's clock
+     @param socket The socket to answer on
+     */
+    void handle(sf::Packet &packet, const sf::IpAddress &address, unsigned short port, sf::Time now, sf::UdpSocket &socket);
+
+    /**
+     Steps the game, respawns and drops players, and broadcasts the room
+     @param now The server's clock
+     @param socket The socket to send on
+     */
+    void tick(sf::Time now, sf::UdpSocket &socket);
+
+    /**
+     Encodes the last tick for spectators, once for all of them: a delta against the
+     tick before, or a keyframe every spectatorKeyframeTicks ticks and when the stream
+     starts over
+     @param restart True if the frames stopped since the last call, so the viewers need a keyframe
+     @return The frame
+     */
+    std::shared_ptr<const SpectatorFrame> spectatorFrame(bool restart);
+
+    /**
+     Checks whether an address and port hold a player slot
+     @param address The address
+     @param port The port
+     @return True if the endpoint has joined and not been dropped
+     */
+    bool hasPlayer(const sf::IpAddress &address, unsigned short port) const;
+
+    /**
+     Drops the player of an address and port, if there is one
+     @param address The address
+     @param port The port
+     */
+    void dropEndpoint(const sf::IpAddress &address, unsigned short port);
+
+    /**
+     Hands over the endpoints of the players dropped since the last call, for whatever
+     routes datagrams to the room
+     @param endpoints Receives the endpoints, as the keys endpointKey makes; cleared first
+     */
+    void takeDropped(std::vector<uint64_t> &endpoints);
+
+    int playerCount() const;
+    int tickMs() const;
+    const RoomStats &stats() const;
+
+private:
+    /**
+     Frees a player slot and takes its snake off the board
+     @param player The slot
+     */
+    void dropPlayer(int player);
+
+    /**
+     Returns the key of an address in `slots`
+     @param address The address
+     @param port The port
+     @return The key
+     */
+    static uint64_t endpointKey(const sf::IpAddress &address, unsigned short port);
+
+    MultiGame game;
+    int tickLength;
+    RoomPlayer players[roomPlayers];
+    std::map<uint64_t, int> slots; //Player slot of every joined address and port
+    std::vector<uint64_t> dropped; //Endpoints dropped since takeDropped was last called
+    uint8_t joined[roomPlayers];
+    uint8_t directions[roomPlayers];
+    uint8_t events[roomPlayers];
+    uint32_t inputSequences[roomPlayers];
+    uint16_t lives[roomPlayers]; //Spawns of each slot's snake
+    RoomSnapshot history[snapshotHistory]; //The last states sent, each at its tick modulo snapshotHistory
+    std::vector<std::pair<uint32_t, sf::Packet>> encoded; //This tick's state for each baseline tick in use
+    uint32_t spectatorTick; //Tick of the last spectator frame
+    uint32_t spectatorKeyframe; //Tick of the last spectator keyframe
+    RoomStats totals;
+};
+
+#endif
@@ -0,0 +1,405 @@
+//Multi-room server, see game_server.hpp.
+
+#include "game_server.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#include <pthread.h>
+#endif
+using namespace std;
+
+const int ioWaitMs = 100; //Longest the I/O thread waits before checking for stop()
+
+/**
+ Keeps the calling thread on one core. Linux pins it; macOS only takes a hint that
+ threads with different tags should run on different cores.
+ @param core The core number, wrapped around the cores there are
+ */
+static void pinToCore(int core) {
+    int cores = max(1, (int) thread::hardware_concurrency());
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core % cores, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(__APPLE__)
+    thread_affinity_policy_data_t policy = {core % cores + 1}; //Tag 0 means no affinity
+    thread_policy_set(pthread_mach_thread_np(pthread_self()), THREAD_AFFINITY_POLICY, (thread_policy_t) &policy,
+                      THREAD_AFFINITY_POLICY_COUNT);
+#else
+    (void) core;
+    (void) cores;
+#endif
+}
+
+/**
+ Returns the key of an address in the routes
+ @param address The address
+ @param port The port
+ @return The key
+ */
+static uint64_t endpointKey(const sf::IpAddress &address, unsigned short port) {
+    return ((uint64_t) address.toInteger() << 16) | port;
+}
+
+/**
+ Counts a duration in a histogram of WorkerStats
+ @param histogram The histogram
+ @param us The duration in microseconds
+ */
+static void record(atomic<long> histogram[tickHistogramBuckets], long us) {
+    int bucket = 0;
+    while (bucket < tickHistogramBuckets - 1 && us >= (1L << bucket)) {
+        bucket++;
+    }
+    histogram[bucket].fetch_add(1, memory_order_relaxed);
+}
+
+/**
+ Reads a big-endian 32-bit number the way sf::Packet writes it
+ @param bytes The first byte
+ @return The number
+ */
+static uint32_t readUint32(const uint8_t *bytes) {
+    return ((uint32_t) bytes[0] << 24) | ((uint32_t) bytes[1] << 16) | ((uint32_t) bytes[2] << 8) | bytes[3];
+}
+
+GameServer::GameServer(int width, int height, int tickMs, uint64_t seed, int rooms, int workers)
+    : boardWidth(width), boardHeight(height), tickMs(max(1, tickMs)), seed(seed), roomLimit(max(1, rooms)), stopping(false),
+      running(false), relay(max(1, rooms)) {
+    int count = workers > 0 ? workers : max(1, (int) thread::hardware_concurrency());
+    count = min(count, roomLimit);
+    for (int i = 0; i < count; ++i) {
+        this->workers.emplace_back(new Worker());
+        this->workers.back()->index = i;
+        this->workers.back()->rooms.resize((roomLimit - i + count - 1) / count);
+        this->workers.back()->nextTicks.resize(this->workers.back()->rooms.size());
+        this->workers.back()->watched.resize(this->workers.back()->rooms.size(), 0);
+    }
+}
+
+GameServer::~GameServer() {
+    stop();
+    //Datagrams and route changes that were never taken out of their queues
+    for (unique_ptr<Worker> &worker : workers) {
+        while (Inbound *message = worker->inbox.pop()) {
+            delete message;
+        }
+    }
+    while (RouteChange *change = routeChanges.pop()) {
+        delete change;
+    }
+}
+
+bool GameServer::start(unsigned short port, string &error) {
+    if (running) {
+        return true;
+    }
+    if (socket.bind(port) != sf::Socket::Done) {
+        error = "could not bind UDP port " + to_string(port);
+        return false;
+    }
+    socket.setBlocking(false); //The I/O thread waits on a selector, and workers never block on a send
+    stopping = false;
+    running = true;
+    for (int i = 0; i < (int) workers.size(); ++i) {
+        workers[i]->thread = thread([this, i] {
+            pinToCore(i);
+            workerLoop(i);
+        });
+    }
+    ioThread = thread([this] { ioLoop(); });
+    return true;
+}
+
+bool GameServer::startSpectators(unsigned short port, string &error) {
+    return relay.start(port, error);
+}
+
+void GameServer::stop() {
+    relay.stop();
+    if (!running) {
+        return;
+    }
+    stopping = true;
+    for (unique_ptr<Worker> &worker : workers) {
+        {
+            lock_guard<mutex> hold(worker->lock);
+            worker->woken = true;
+        }
+        worker->wake.notify_one();
+    }
+    ioThread.join();
+    for (unique_ptr<Worker> &worker : workers) {
+        worker->thread.join();
+    }
+    socket.unbind();
+    running = false;
+}
+
+unsigned short GameServer::port() const {
+    return socket.getLocalPort();
+}
+
+unsigned short GameServer::spectatorPort() const {
+    return relay.port();
+}
+
+SpectatorStats GameServer::spectatorStats() const {
+    return relay.stats();
+}
+
+int GameServer::workerCount() const {
+    return (int) workers.size();
+}
+
+WorkerStats GameServer::workerStats(int index) const {
+    const Worker &worker = *workers[index];
+    WorkerStats stats;
+    stats.rooms = worker.roomCount.load(memory_order_relaxed);
+    stats.activeRooms = worker.activeCount.load(memory_order_relaxed);
+    stats.players = worker.players.load(memory_order_relaxed);
+    stats.ticks = worker.ticks.load(memory_order_relaxed);
+    stats.packetsIn = worker.packetsIn.load(memory_order_relaxed);
+    stats.packetsOut = worker.packetsOut.load(memory_order_relaxed);
+    stats.bytesOut = worker.bytesOut.load(memory_order_relaxed);
+    stats.keyframes = worker.keyframes.load(memory_order_relaxed);
+    for (int i = 0; i < tickHistogramBuckets; ++i) {
+        stats.histogram[i] = worker.histogram[i].load(memory_order_relaxed);
+        stats.lateHistogram[i] = worker.lateHistogram[i].load(memory_order_relaxed);
+    }
+    return stats;
+}
+
+long GameServer::percentileUs(const long histogram[tickHistogramBuckets], double fraction) {
+    long total = 0;
+    for (int i = 0; i < tickHistogramBuckets; ++i) {
+        total += histogram[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    long rank = max(1L, (long) (fraction * total + 0.5));
+    for (int i = 0; i < tickHistogramBuckets; ++i) {
+        rank -= histogram[i];
+        if (rank <= 0) {
+            return 1L << i;
+        }
+    }
+    return 1L << (tickHistogramBuckets - 1);
+}
+
+void GameServer::ioLoop() {
+    sf::SocketSelector selector;
+    selector.add(socket);
+    Inbound *message = new Inbound();
+    while (!stopping.load(memory_order_relaxed)) {
+        bool ready = selector.wait(sf::milliseconds(ioWaitMs));
+        applyRouteChanges();
+        if (!ready) {
+            continue;
+        }
+        while (socket.receive(message->packet, message->address, message->port) == sf::Socket::Done) {
+            //A join goes to the room it names, and is routed only once the room takes it
+            //in; everything else goes where the sender joined. The join is
+            //[type][u32 version][u32 room], read without moving the packet.
+            const uint8_t *bytes = (const uint8_t *) message->packet.getData();
+            if (message->packet.getDataSize() >= 9 && bytes[0] == MessageJoin) {
+                message->room = readUint32(bytes + 5);
+                if (message->room >= (uint32_t) roomLimit) {
+                    continue;
+                }
+            } else {
+                map<uint64_t, uint32_t>::iterator route = routes.find(endpointKey(message->address, message->port));
+                if (route == routes.end()) {
+                    continue;
+                }
+                message->room = route->second;
+            }
+            deliver(*workers[message->room % workers.size()], message);
+            message = new Inbound();
+        }
+    }
+    delete message;
+}
+
+void GameServer::applyRouteChanges() {
+    while (RouteChange *change = routeChanges.pop()) {
+        map<uint64_t, uint32_t>::iterator route = routes.find(change->endpoint);
+        if (change->joined) {
+            if (route != routes.end() && route->second != change->room) {
+                //Joined a second room: the first one lets go of the player straight away
+                //instead of waiting for it to time out
+                Inbound *moved = new Inbound();
+                moved->room = route->second;
+                moved->address = sf::IpAddress((uint32_t) (change->endpoint >> 16));
+                moved->port = (unsigned short) (change->endpoint & 0xFFFF);
+                moved->moved = true;
+                deliver(*workers[moved->room % workers.size()], moved);
+            }
+            routes[change->endpoint] = change->room;
+        } else if (route != routes.end() && route->second == change->room) {
+            routes.erase(route); //A drop from a room the endpoint has since left changes nothing
+        }
+        delete change;
+    }
+}
+
+void GameServer::reportDrops(GameRoom &room, uint32_t number) {
+    static thread_local vector<uint64_t> endpoints;
+    room.takeDropped(endpoints);
+    for (uint64_t endpoint : endpoints) {
+        routeChanges.push(new RouteChange{{nullptr}, endpoint, number, false});
+    }
+}
+
+void GameServer::deliver(Worker &worker, Inbound *message) {
+    worker.inbox.push(message);
+    //Pairs with the fence in workerLoop: either the worker sees the message before it
+    //sleeps, or this sees it sleeping and wakes it
+    atomic_thread_fence(memory_order_seq_cst);
+    if (worker.sleeping.load(memory_order_relaxed)) {
+        {
+            lock_guard<mutex> hold(worker.lock);
+            worker.woken = true;
+        }
+        worker.wake.notify_one();
+    }
+}
+
+void GameServer::workerLoop(int index) {
+    Worker &worker = *workers[index];
+    while (!stopping.load(memory_order_relaxed)) {
+        while (Inbound *message = worker.inbox.pop()) {
+            dispatch(worker, *message);
+            delete message;
+        }
+
+        //Tick the rooms that are due; a room late by more than a tick skips ahead
+        //instead of stepping several times in a row
+        sf::Time now = clock.getElapsedTime();
+        sf::Time deadline = sf::Time::Zero;
+        bool haveDeadline = false;
+        for (size_t i = 0; i < worker.active.size();) {
+            int local = worker.active[i];
+            if (worker.nextTicks[local] <= now) {
+                tickRoom(worker, local);
+                worker.nextTicks[local] += sf::milliseconds(tickMs);
+                if (worker.nextTicks[local] <= now) {
+                    worker.nextTicks[local] = now + sf::milliseconds(tickMs);
+                }
+                if (worker.rooms[local]->playerCount() == 0) {
+                    //Everyone left or timed out: the room stops ticking until the next join
+                    worker.active[i] = worker.active.back();
+                    worker.active.pop_back();
+                    worker.activeCount.store((int) worker.active.size(), memory_order_relaxed);
+                    continue;
+                }
+            }
+            if (!haveDeadline || worker.nextTicks[local] < deadline) {
+                deadline = worker.nextTicks[local];
+                haveDeadline = true;
+            }
+            ++i;
+        }
+        now = clock.getElapsedTime();
+        if (haveDeadline && deadline <= now) {
+            continue;
+        }
+
+        //Sleep until the next tick, or until the I/O thread has something
+        worker.sleeping.store(true, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (Inbound *message = worker.inbox.pop()) {
+            worker.sleeping.store(false, memory_order_relaxed);
+            dispatch(worker, *message);
+            delete message;
+            continue;
+        }
+        unique_lock<mutex> hold(worker.lock);
+        if (haveDeadline) {
+            worker.wake.wait_for(hold, chrono::microseconds((deadline - now).asMicroseconds()), [&worker] { return worker.woken; });
+        } else {
+            worker.wake.wait(hold, [&worker] { return worker.woken; });
+        }
+        worker.woken = false;
+        worker.sleeping.store(false, memory_order_relaxed);
+    }
+}
+
+void GameServer::dispatch(Worker &worker, Inbound &message) {
+    int local = (int) (message.room / workers.size());
+    unique_ptr<GameRoom> &room = worker.rooms[local];
+    if (message.moved) {
+        if (room) {
+            int playersBefore = room->playerCount();
+            room->dropEndpoint(message.address, message.port);
+            worker.players.fetch_add(room->playerCount() - playersBefore, memory_order_relaxed);
+            reportDrops(*room, message.room);
+        }
+        return;
+    }
+    uint8_t type = 0;
+    if (message.packet.getDataSize() >= 1) {
+        memcpy(&type, message.packet.getData(), 1);
+    }
+    if (!room) {
+        if (type != MessageJoin) {
+            return; //Nobody can be in a room that was never joined
+        }
+        //Each room gets its own spawns and fruit from the server's seed
+        room.reset(new GameRoom(boardWidth, boardHeight, tickMs, seed ^ ((uint64_t) (message.room + 1) * 0x9E3779B97F4A7C15ULL)));
+        worker.roomCount.fetch_add(1, memory_order_relaxed);
+    }
+    RoomStats before = room->stats();
+    int playersBefore = room->playerCount();
+    sf::Time now = clock.getElapsedTime();
+    room->handle(message.packet, message.address, message.port, now, socket);
+    const RoomStats &after = room->stats();
+    worker.packetsIn.fetch_add(after.packetsIn - before.packetsIn, memory_order_relaxed);
+    worker.packetsOut.fetch_add(after.packetsOut - before.packetsOut, memory_order_relaxed);
+    worker.bytesOut.fetch_add(after.bytesOut - before.bytesOut, memory_order_relaxed);
+    worker.players.fetch_add(room->playerCount() - playersBefore, memory_order_relaxed);
+    if (type == MessageJoin && room->hasPlayer(message.address, message.port)) {
+        //Also sent for a repeated join, which leaves the route as it is
+        routeChanges.push(new RouteChange{{nullptr}, endpointKey(message.address, message.port), message.room, true});
+    }
+    reportDrops(*room, message.room);
+    if (playersBefore == 0 && room->playerCount() > 0 && find(worker.active.begin(), worker.active.end(), local) == worker.active.end()) {
+        //The first player wakes the room; it ticks one tick from now
+        worker.nextTicks[local] = now + sf::milliseconds(tickMs);
+        worker.active.push_back(local);
+        worker.activeCount.store((int) worker.active.size(), memory_order_relaxed);
+    }
+}
+
+void GameServer::tickRoom(Worker &worker, int local) {
+    GameRoom &room = *worker.rooms[local];
+    RoomStats before = room.stats();
+    int playersBefore = room.playerCount();
+    sf::Time now = clock.getElapsedTime();
+    record(worker.lateHistogram, (long) (now - worker.nextTicks[local]).asMicroseconds());
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    room.tick(now, socket);
+    uint32_t number = (uint32_t) (local * workers.size() + worker.index);
+    reportDrops(room, number);
+    bool watched = relay.watchers(number) > 0;
+    if (watched) {
+        relay.publish(number, room.spectatorFrame(!worker.watched[local]));
+    }
+    worker.watched[local] = watched;
+    record(worker.histogram, (long) chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count());
+    worker.ticks.fetch_add(1, memory_order_relaxed);
+    const RoomStats &after = room.stats();
+    worker.packetsOut.fetch_add(after.packetsOut - before.packetsOut, memory_order_relaxed);
+    worker.bytesOut.fetch_add(after.bytesOut - before.bytesOut, memory_order_relaxed);
+    worker.keyframes.fetch_add(after.keyframes - before.keyframes, memory_order_relaxed);
+    worker.players.fetch_add(room.playerCount() - playersBefore, memory_order_relaxed);
+}
@@ -0,0 +1,217 @@
+//Server hosting many independent rooms in one process. Rooms are sharded over worker
+//threads by room number, each worker pinned to a core; a room only ever runs on its
+//worker, so rooms need no locks. One I/O thread receives every datagram and routes it
+//to its room's worker through a lock-free MPSC inbox; workers send their answers on
+//the same socket themselves.
+//
+//The I/O thread routes a player's datagrams once its room has taken it in: workers tell
+//it through a second MPSC queue when a room accepts a join and when a room drops a
+//player, so the routes only ever hold endpoints that are in a room.
+//
+//A worker only looks at rooms that have players, and sleeps until the next tick of one
+//of them is due or a datagram arrives, so empty rooms cost memory but no CPU. Every
+//worker keeps histograms of how long its ticks take and how late they start.
+//
+//Rooms someone watches also encode a spectator frame per tick for the SpectatorRelay,
+//which the server runs once startSpectators() is called.
+
+#ifndef GAME_SERVER_HPP
+#define GAME_SERVER_HPP
+
+#include "game_room.hpp"
+#include "mpsc_queue.hpp"
+#include "spectator_relay.hpp"
+
+#include <SFML/Network.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+const int tickHistogramBuckets = 24; //Bucket b counts ticks that took under 2^b microseconds
+
+//A datagram on its way from the I/O thread to a room
+struct Inbound {
+    std::atomic<Inbound *> next;
+    uint32_t room;
+    sf::IpAddress address;
+    unsigned short port;
+    sf::Packet packet;
+    bool moved = false; //Set by the I/O thread when the sender has joined another room, to drop it from this one
+};
+
+//A change to the routes, from a worker to the I/O thread
+struct RouteChange {
+    std::atomic<RouteChange *> next;
+    uint64_t endpoint; //Address and port, as endpointKey makes them
+    uint32_t room;
+    bool joined; //True when the room took the endpoint in, false when it dropped it
+};
+
+//Counters of one worker, copied out by GameServer::workerStats
+struct WorkerStats {
+    int rooms; //Rooms created on this worker
+    int activeRooms; //Rooms with players
+    int players;
+    long ticks;
+    long packetsIn;
+    long packetsOut;
+    long bytesOut;
+    long keyframes;
+    long histogram[tickHistogramBuckets]; //Tick times
+    long lateHistogram[tickHistogramBuckets]; //How long after its due time each tick started
+};
+
+class GameServer {
+public:
+    /**
+     Sets up a server with no rooms yet; rooms are created when a player first joins one
+     @param width Number of tiles in width of every room
+     @param height Number of tiles in height
+     @param tickMs Milliseconds per tick
+     @param seed Seed for the rooms, each mixing in its number
+     @param rooms Number of room numbers players can join, from 0
+     @param workers Number of worker threads, 0 for one per core
+     */
+    GameServer(int width, int height, int tickMs, uint64_t seed, int rooms, int workers);
+    ~GameServer();
+
+    GameServer(const GameServer &) = delete;
+    GameServer &operator=(const GameServer &) = delete;
+
+    /**
+     Binds the UDP socket and starts the I/O and worker threads
+     @param port The port to listen on, 0 for any free port
+     @param error Receives the reason when binding fails
+     @return False if the socket could not be bound
+     */
+    bool start(unsigned short port, std::string &error);
+
+    /**
+     Starts the spectator relay; rooms start encoding frames once someone watches them
+     @param port The TCP port, 0 for any free port
+     @param error Receives the reason when listening fails
+     @return False if the port could not be opened
+     */
+    bool startSpectators(unsigned short port, std::string &error);
+
+    /**
+     Stops and joins every thread, the relay's too; safe to call more than once
+     */
+    void stop();
+
+    unsigned short port() const;
+    unsigned short spectatorPort() const;
+    SpectatorStats spectatorStats() const;
+    int workerCount() const;
+
+    /**
+     Copies one worker's counters; safe while the server runs
+     @param worker The worker number
+     @return The counters
+     */
+    WorkerStats workerStats(int worker) const;
+
+    /**
+     Reads a percentile off one of the histograms in WorkerStats
+     @param histogram The histogram
+     @param fraction The percentile, 0.5 for the median
+     @return Upper bound of the bucket holding it, in microseconds
+     */
+    static long percentileUs(const long histogram[tickHistogramBuckets], double fraction);
+
+private:
+    //One worker thread and the rooms sharded to it
+    struct Worker {
+        int index; //Worker number; its rooms are index, index + worker count and so on
+        std::thread thread;
+        MpscQueue<Inbound> inbox;
+        std::mutex lock;
+        std::condition_variable wake;
+        bool woken = false; //Set under `lock` by the I/O thread
+        std::atomic<bool> sleeping{false}; //True while the worker may be waiting on `wake`
+        std::vector<std::unique_ptr<GameRoom>> rooms; //Room number / worker count, created on first join
+        std::vector<sf::Time> nextTicks; //When each room ticks next
+        std::vector<int> active; //Rooms with players
+        std::vector<uint8_t> watched; //Rooms whose last tick went to spectators
+
+        //Counters, written by the worker and read by workerStats
+        std::atomic<int> roomCount{0};
+        std::atomic<int> activeCount{0};
+        std::atomic<int> players{0};
+        std::atomic<long> ticks{0};
+        std::atomic<long> packetsIn{0};
+        std::atomic<long> packetsOut{0};
+        std::atomic<long> bytesOut{0};
+        std::atomic<long> keyframes{0};
+        std::atomic<long> histogram[tickHistogramBuckets] = {};
+        std::atomic<long> lateHistogram[tickHistogramBuckets] = {};
+    };
+
+    /**
+     Receives datagrams and routes them to the workers until stopped
+     */
+    void ioLoop();
+
+    /**
+     Runs one worker's rooms until stopped
+     @param index The worker number
+     */
+    void workerLoop(int index);
+
+    /**
+     Applies the route changes the workers have sent; I/O thread only
+     */
+    void applyRouteChanges();
+
+    /**
+     Tells the I/O thread which players a room has dropped since the last call
+     @param room The room
+     @param number The room number
+     */
+    void reportDrops(GameRoom &room, uint32_t number);
+
+    /**
+     Hands a datagram to a worker, waking it if it sleeps
+     @param worker The worker
+     @param message The datagram
+     */
+    void deliver(Worker &worker, Inbound *message);
+
+    /**
+     Passes a datagram to its room, creating the room on a join
+     @param worker The room's worker
+     @param message The datagram
+     */
+    void dispatch(Worker &worker, Inbound &message);
+
+    /**
+     Ticks a room, hands the tick to its spectators, and records the time it took and how
+     late it started
+     @param worker The room's worker
+     @param local The room's place in worker.rooms, whose next tick is due
+     */
+    void tickRoom(Worker &worker, int local);
+
+    int boardWidth;
+    int boardHeight;
+    int tickMs;
+    uint64_t seed;
+    int roomLimit;
+    sf::UdpSocket socket;
+    sf::Clock clock;
+    std::atomic<bool> stopping;
+    bool running;
+    std::thread ioThread;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::map<uint64_t, uint32_t> routes; //Room of every address and port a room has taken in, used by the I/O thread only
+    MpscQueue<RouteChange> routeChanges; //From the workers to the I/O thread
+    SpectatorRelay relay;
+};
+
+#endif
@@ -0,0 +1,351 @@
+//Headless rules for the snake game, see game_state.hpp.
+
+#include "game_state.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+using namespace std;
+
+//Random keys XORed into GameState::hash for each piece of the game
+struct ZobristKeys {
+    uint64_t body[gridCells];
+    uint64_t head[gridCells];
+    uint64_t fruit[gridCells];
+    uint64_t specialFruit[gridCells];
+    uint64_t direction[4];
+};
+
+/**
+ Builds the Zobrist keys at compile time, so every build and machine hashes games the same way
+ @return The key tables
+ */
+static constexpr ZobristKeys makeZobristKeys() {
+    ZobristKeys keys = {};
+    uint64_t rng = 0x5A0B8157C0FFEE00ull;
+    for (int i = 0; i < gridCells; ++i) {
+        keys.body[i] = nextRandom(rng);
+        keys.head[i] = nextRandom(rng);
+        keys.fruit[i] = nextRandom(rng);
+        keys.specialFruit[i] = nextRandom(rng);
+    }
+    for (int i = 0; i < 4; ++i) {
+        keys.direction[i] = nextRandom(rng);
+    }
+    return keys;
+}
+
+static constexpr ZobristKeys zobrist = makeZobristKeys();
+
+/**
+ Writes one 2-bit move into the ring buffer
+ @param state The game state
+ @param slot The ring buffer position
+ @param direction The move
+ */
+static void setMove(GameState &state, int slot, int direction) {
+    int shift = (slot & 3) * 2;
+    state.moves[slot >> 2] = (uint8_t) ((state.moves[slot >> 2] & ~(3 << shift)) | (direction << shift));
+}
+
+/**
+ Moves the fruit, keeping the hash up to date
+ @param state The game state
+ @param x The new x-coordinate, or -1 to take the fruit off the board
+ @param y The new y-coordinate, or -1 to take the fruit off the board
+ */
+static void setFruit(GameState &state, int x, int y) {
+    if (state.fruitX >= 0) {
+        state.hash ^= zobrist.fruit[cellAt(state.fruitX, state.fruitY)];
+    }
+    state.fruitX = (int8_t) x;
+    state.fruitY = (int8_t) y;
+    if (x >= 0) {
+        state.hash ^= zobrist.fruit[cellAt(x, y)];
+    }
+}
+
+/**
+ Moves the special fruit, keeping the hash up to date
+ @param state The game state
+ @param x The new x-coordinate, or -1 to take the special fruit off the board
+ @param y The new y-coordinate, or -1 to take the special fruit off the board
+ */
+static void setSpecialFruit(GameState &state, int x, int y) {
+    if (state.specialFruitX >= 0) {
+        state.hash ^= zobrist.specialFruit[cellAt(state.specialFruitX, state.specialFruitY)];
+    }
+    state.specialFruitX = (int8_t) x;
+    state.specialFruitY = (int8_t) y;
+    if (x >= 0) {
+        state.hash ^= zobrist.specialFruit[cellAt(x, y)];
+    }
+}
+
+int pickFreeCell(const uint32_t occupied[], int length, int avoidCell, uint64_t &rng) {
+    int freeCells = gridCells - length;
+    if (avoidCell >= 0 && !((occupied[cellY(avoidCell)] >> cellX(avoidCell)) & 1u)) {
+        freeCells--;
+    }
+    if (freeCells <= 0) {
+        return -1;
+    }
+
+    //Choose the n-th free cell so each placement uses exactly one random number
+    int n = (int) (((nextRandom(rng) >> 32) * (uint64_t) freeCells) >> 32);
+    const uint32_t rowMask = (gridWidth == 32) ? 0xFFFFFFFFu : ((1u << gridWidth) - 1);
+    for (int y = 0; y < gridHeight; ++y) {
+        uint32_t row = ~occupied[y] & rowMask;
+        if (avoidCell >= 0 && cellY(avoidCell) == y) {
+            row &= ~(1u << cellX(avoidCell));
+        }
+        int count = __builtin_popcount(row);
+        if (n < count) {
+            for (int i = 0; i < n; ++i) {
+                row &= row - 1; //Drop the lowest free cell
+            }
+            return cellAt(__builtin_ctz(row), y);
+        }
+        n -= count;
+    }
+    return -1;
+}
+
+/**
+ Places the fruit on a random free cell
+ @param state The game state
+ @return False if there is no room left for a fruit
+ */
+static bool placeFruit(GameState &state) {
+    int cell = pickFreeCell(state.occupied, state.length, state.specialFruitX >= 0 ? cellAt(state.specialFruitX, state.specialFruitY) : -1, state.rng);
+    if (cell < 0) {
+        setFruit(state, -1, -1);
+        return false;
+    }
+    setFruit(state, cellX(cell), cellY(cell));
+    return true;
+}
+
+/**
+ Places the special fruit on a random free cell, or takes it off the board if there is no room
+ @param state The game state
+ */
+static void placeSpecialFruit(GameState &state) {
+    int cell = pickFreeCell(state.occupied, state.length, state.fruitX >= 0 ? cellAt(state.fruitX, state.fruitY) : -1, state.rng);
+    if (cell < 0) {
+        setSpecialFruit(state, -1, -1);
+        return;
+    }
+    setSpecialFruit(state, cellX(cell), cellY(cell));
+}
+
+void newGame(GameState &state, uint64_t seed) {
+    memset(&state, 0, sizeof(state));
+    state.rng = seed;
+    state.direction = Right; //Snake starts moving to the right initially
+    state.length = 1;
+    state.headCell = state.tailCell = (uint16_t) cellAt(gridWidth / 2, gridHeight / 2);
+    state.occupied[gridHeight / 2] = 1u << (gridWidth / 2);
+    state.specialFruitX = -1; //Initially no special fruit
+    state.specialFruitY = -1;
+    state.fruitX = -1;
+    state.fruitY = -1;
+    placeFruit(state);
+    state.hash = computeHash(state);
+}
+
+void pushHead(GameState &state, int direction) {
+    int x = cellX(state.headCell) + moveDX[direction];
+    int y = cellY(state.headCell) + moveDY[direction];
+    setMove(state, (state.ringStart + state.length - 1) % gridCells, direction);
+    state.length++;
+    state.hash ^= zobrist.head[state.headCell] ^ zobrist.head[cellAt(x, y)] ^ zobrist.body[cellAt(x, y)];
+    state.headCell = (uint16_t) cellAt(x, y);
+    state.occupied[y] |= 1u << x;
+}
+
+void popTail(GameState &state) {
+    int direction = moveAt(state, 0);
+    state.occupied[cellY(state.tailCell)] &= ~(1u << cellX(state.tailCell));
+    state.hash ^= zobrist.body[state.tailCell];
+    state.tailCell = (uint16_t) cellAt(cellX(state.tailCell) + moveDX[direction], cellY(state.tailCell) + moveDY[direction]);
+    state.ringStart = (uint16_t) ((state.ringStart + 1) % gridCells);
+    state.length--;
+}
+
+void moveSnake(GameState &state, int direction, bool grow) {
+    int oldTail = state.tailCell;
+    pushHead(state, direction);
+    if (!grow) {
+        popTail(state); //Remove the tail if no fruit eaten
+        if (state.headCell == oldTail) {
+            //The head moved into the old tail cell, which is still covered
+            state.occupied[cellY(oldTail)] |= 1u << cellX(oldTail);
+        }
+    }
+}
+
+int moveAt(const GameState &state, int index) {
+    int slot = (state.ringStart + index) % gridCells;
+    return (state.moves[slot >> 2] >> ((slot & 3) * 2)) & 3;
+}
+
+int copyBody(const GameState &state, Segment body[]) {
+    int x = cellX(state.tailCell);
+    int y = cellY(state.tailCell);
+    body[state.length - 1] = {x, y};
+    for (int i = 0; i < state.length - 1; ++i) {
+        int direction = moveAt(state, i);
+        x += moveDX[direction];
+        y += moveDY[direction];
+        body[state.length - 2 - i] = {x, y};
+    }
+    return state.length;
+}
+
+int stepGame(GameState &state, int direction, int elapsedMs) {
+    if (state.gameOver != 0) {
+        return 0;
+    }
+    if (direction == oppositeDirection(state.direction)) {
+        direction = state.direction; //Cannot go in the opposite direction
+    }
+    state.specialFruitMs = (uint16_t) min(state.specialFruitMs + elapsedMs, specialFruitMoveMs);
+
+    //Determine new head position based on direction
+    int x = cellX(state.headCell) + moveDX[direction];
+    int y = cellY(state.headCell) + moveDY[direction];
+
+    //Check if the snake hits the wall (game over)
+    if (x < 0 || x >= gridWidth || y < 0 || y >= gridHeight) {
+        state.gameOver = StepHitWall;
+        return StepHitWall;
+    }
+
+    bool ateFruit = (x == state.fruitX && y == state.fruitY);
+    bool ateSpecialFruit = (x == state.specialFruitX && y == state.specialFruitY);
+    bool grow = ateFruit || ateSpecialFruit;
+
+    //Check if the snake collides with itself (game over). The tail moves out of the way unless the snake grows
+    if (isOccupied(state, x, y) && (grow || cellAt(x, y) != state.tailCell)) {
+        state.gameOver = StepHitSelf;
+        return StepHitSelf;
+    }
+
+    if (state.fruitCounter >= numForSpecialFruit && state.specialFruitX == -1) {
+        placeSpecialFruit(state); //Place special fruit
+    }
+    if (state.fruitCounter >= numForSpecialFruit && state.specialFruitMs >= specialFruitMoveMs) {
+        placeSpecialFruit(state); //Moves the special fruit around every 3 seconds
+        state.specialFruitMs = 0;
+    }
+    //The special fruit may have just landed on the new head
+    ateSpecialFruit = (x == state.specialFruitX && y == state.specialFruitY);
+    grow = ateFruit || ateSpecialFruit;
+
+    int events = 0;
+    moveSnake(state, direction, grow);
+    state.hash ^= zobrist.direction[state.direction] ^ zobrist.direction[direction];
+    state.direction = (uint8_t) direction;
+    state.tick++;
+
+    //Check if the snake eats the special fruit
+    if (ateSpecialFruit) {
+        events |= StepAteSpecialFruit;
+        state.score += specialFruitPoints; //Give extra points
+        state.fruitCounter = 0;
+        setSpecialFruit(state, -1, -1);
+    }
+
+    //Check if the snake eats the fruit
+    if (ateFruit) {
+        events |= StepAteFruit;
+        state.score++;
+        state.fruitCounter++;
+        if (!placeFruit(state)) {
+            state.gameOver = StepBoardFull; //No room left, the board is cleared
+            events |= StepBoardFull;
+        }
+    }
+
+#ifdef DEBUG
+    assert(state.hash == computeHash(state)); //The incremental hash must match a full recompute
+#endif
+    return events;
+}
+
+uint64_t computeHash(const GameState &state) {
+    uint64_t hash = zobrist.head[state.headCell] ^ zobrist.direction[state.direction];
+    for (int y = 0; y < gridHeight; ++y) {
+        for (uint32_t row = state.occupied[y]; row != 0; row &= row - 1) {
+            hash ^= zobrist.body[cellAt(__builtin_ctz(row), y)];
+        }
+    }
+    if (state.fruitX >= 0) {
+        hash ^= zobrist.fruit[cellAt(state.fruitX, state.fruitY)];
+    }
+    if (state.specialFruitX >= 0) {
+        hash ^= zobrist.specialFruit[cellAt(state.specialFruitX, state.specialFruitY)];
+    }
+    return hash;
+}
+
+uint64_t stateDigest(const GameState &state) {
+    //FNV-1a over the fields, one whole number at a time
+    uint64_t digest = 0xCBF29CE484222325ull;
+    auto mix = [&digest](uint64_t value) {
+        digest = (digest ^ value) * 0x100000001B3ull;
+    };
+    mix(state.hash);
+    mix(state.rng);
+    mix(state.tick);
+    mix((uint32_t) state.score);
+    mix(state.length);
+    mix(state.specialFruitMs);
+    mix(state.fruitCounter);
+    mix(state.gameOver);
+    for (int i = 0; i < state.length - 1; ++i) {
+        mix((uint64_t) moveAt(state, i));
+    }
+    return digest;
+}
+
+bool makeDelta(const GameState &base, const GameState &current, GameDelta &delta) {
+    if (current.tick < base.tick || current.tick - base.tick > (uint32_t) maxDeltaMoves) {
+        return false;
+    }
+    int headMoves = (int) (current.tick - base.tick);
+    int tailTrims = base.length + headMoves - current.length;
+    if (headMoves > current.length - 1 || tailTrims < 0) {
+        return false;
+    }
+
+    delta.baseTick = base.tick;
+    delta.headMoves = (uint16_t) headMoves;
+    delta.tailTrims = (uint16_t) tailTrims;
+    memcpy(delta.header, &current, gameHeaderBytes);
+    memset(delta.moves, 0, sizeof(delta.moves));
+    int first = current.length - 1 - headMoves; //The newest moves are at the end of the ring
+    for (int i = 0; i < headMoves; ++i) {
+        delta.moves[i >> 2] |= (uint8_t) (moveAt(current, first + i) << ((i & 3) * 2));
+    }
+    return true;
+}
+
+void applyDelta(const GameState &base, const GameDelta &delta, GameState &state) {
+    state = base;
+
+    //makeDelta keeps the new moves within the current body, so every trimmed cell is one
+    //of the base body's: trimming first keeps the ring from holding more moves than the
+    //final body, and never clears a cell the new head moves came back to
+#ifdef DEBUG
+    assert(delta.tailTrims <= base.length - 1);
+#endif
+    for (int i = 0; i < delta.tailTrims; ++i) {
+        popTail(state);
+    }
+    for (int i = 0; i < delta.headMoves; ++i) {
+        pushHead(state, (delta.moves[i >> 2] >> ((i & 3) * 2)) & 3);
+    }
+    memcpy(&state, delta.header, gameHeaderBytes);
+}
@@ -0,0 +1,249 @@
+//Headless rules for the snake game. Everything the game needs to keep playing
+//lives in one plain GameState struct with no pointers or containers, so a whole
+//game can be copied with a single assignment (memcpy) for bots, replays and rewind.
+
+#ifndef GAME_STATE_HPP
+#define GAME_STATE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+const int gridWidth = 20; //Number of tiles in width
+const int gridHeight = 15; //Number of tiles in height
+const int gridCells = gridWidth * gridHeight; //Number of tiles on the board
+
+//Direction constants
+const int Up = 0;
+const int Down = 1;
+const int Left = 2;
+const int Right = 3;
+
+//Board offsets for each direction constant
+const int moveDX[4] = {0, 0, -1, 1};
+const int moveDY[4] = {-1, 1, 0, 0};
+
+const int numForSpecialFruit = 10; //Eat 10 regular fruits for a special fruit to show up
+const int specialFruitPoints = 5; //Points for eating the special fruit
+const int specialFruitMoveMs = 3000; //The special fruit moves around every 3 seconds
+
+//Flags returned by stepGame and stored in GameState::gameOver
+const int StepAteFruit = 1;
+const int StepAteSpecialFruit = 2;
+const int StepHitWall = 4;
+const int StepHitSelf = 8;
+const int StepBoardFull = 16;
+const int StepTimedOut = 32; //Never set by stepGame: a runner stopping a game at its tick limit records it instead of an end
+
+const int maxDeltaMoves = 64; //Most head moves a GameDelta can record
+
+//Snake segment structure
+struct Segment {
+    int x;
+    int y;
+};
+
+//Complete state of one game. The body is stored as the tail cell plus a ring
+//buffer of 2-bit moves from the tail to the head, and an occupancy bitboard
+//(one 32-bit row per board row) answers "is the snake here?" in one lookup.
+struct GameState {
+    //Header: everything before `occupied` is copied as-is by delta snapshots
+    uint64_t rng; //Random number generator state used for fruit placement
+    uint64_t hash; //Zobrist hash of the snake, fruits and direction, kept up to date by every move
+    uint32_t tick; //Number of moves made so far
+    int32_t score;
+    uint16_t headCell; //Cell index (y * gridWidth + x) of the head
+    uint16_t tailCell; //Cell index of the last segment
+    uint16_t length; //Number of segments
+    uint16_t ringStart; //Position of the oldest move in `moves`
+    uint16_t specialFruitMs; //Time since the special fruit last moved
+    int8_t fruitX;
+    int8_t fruitY;
+    int8_t specialFruitX; //-1 when there is no special fruit
+    int8_t specialFruitY;
+    uint8_t fruitCounter; //Fruits eaten since the last special fruit
+    uint8_t direction; //Direction of the last move
+    uint8_t gameOver; //0 while playing, otherwise the Step flag that ended the game
+
+    //Body
+    uint32_t occupied[gridHeight]; //Bit x of row y is set when the snake covers (x, y)
+    uint8_t moves[(gridCells + 3) / 4]; //Ring buffer of 2-bit moves, four per byte
+};
+
+static_assert(std::is_trivially_copyable<GameState>::value, "GameState must stay memcpy-able");
+static_assert(gridWidth <= 32, "Each board row must fit in one occupancy word");
+static_assert(gridCells <= 65535, "Cell indices must fit in 16 bits");
+
+const size_t gameHeaderBytes = offsetof(GameState, occupied);
+
+//Changes between two states of the same game: the moves added at the head,
+//how many segments were trimmed from the tail, and a copy of the header.
+struct GameDelta {
+    uint32_t baseTick; //Tick of the state the delta applies to
+    uint16_t headMoves; //Number of moves added at the head
+    uint16_t tailTrims; //Number of segments removed from the tail
+    uint8_t header[gameHeaderBytes];
+    uint8_t moves[maxDeltaMoves / 4];
+};
+
+/**
+ Returns the cell index of a board position
+ @param x The x-coordinate on the board
+ @param y The y-coordinate on the board
+ @return The cell index
+ */
+inline int cellAt(int x, int y) {
+    return y * gridWidth + x;
+}
+
+/**
+ Returns the x-coordinate of a cell index
+ @param cell The cell index
+ @return The x-coordinate on the board
+ */
+inline int cellX(int cell) {
+    return cell % gridWidth;
+}
+
+/**
+ Returns the y-coordinate of a cell index
+ @param cell The cell index
+ @return The y-coordinate on the board
+ */
+inline int cellY(int cell) {
+    return cell / gridWidth;
+}
+
+/**
+ Returns the direction opposite to the one given
+ @param direction A direction constant
+ @return The opposite direction constant
+ */
+inline int oppositeDirection(int direction) {
+    return direction ^ 1;
+}
+
+/**
+ Checks whether the snake covers a position on the board
+ @param state The game state
+ @param x The x-coordinate on the board
+ @param y The y-coordinate on the board
+ @return True if a snake segment is on that position
+ */
+inline bool isOccupied(const GameState &state, int x, int y) {
+    return (state.occupied[y] >> x) & 1u;
+}
+
+/**
+ Returns the next number from a game's random number generator (splitmix64)
+ @param rng The generator state, advanced by the call
+ @return A 64-bit random number
+ */
+constexpr uint64_t nextRandom(uint64_t &rng) {
+    uint64_t z = (rng += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/**
+ Starts a new game with a one-segment snake in the middle of the board moving right
+ @param state The game state to reset
+ @param seed The seed for fruit placement
+ */
+void newGame(GameState &state, uint64_t seed);
+
+/**
+ Picks a random cell the snake does not cover, also avoiding one extra cell.
+ Works on any occupancy rows so batched games place fruit exactly like GameState.
+ @param occupied The occupancy rows of the board
+ @param length Number of snake segments on the board
+ @param avoidCell A cell to avoid as well, or -1
+ @param rng The game's random number generator, advanced once
+ @return The cell index, or -1 if the board is full
+ */
+int pickFreeCell(const uint32_t occupied[], int length, int avoidCell, uint64_t &rng);
+
+/**
+ Moves the snake one tile and applies the rules: eating fruits, placing and moving the
+ special fruit, growing, and ending the game on hitting a wall or itself.
+ A direction opposite to the last move is ignored.
+ @param state The game state
+ @param direction The direction to move in
+ @param elapsedMs Time since the previous move, used to move the special fruit
+ @return A combination of the Step flags describing what happened
+ */
+int stepGame(GameState &state, int direction, int elapsedMs);
+
+/**
+ Adds a segment in front of the head without applying any rules
+ @param state The game state
+ @param direction The direction of the new segment from the head
+ */
+void pushHead(GameState &state, int direction);
+
+/**
+ Removes the last segment without applying any rules
+ @param state The game state
+ */
+void popTail(GameState &state);
+
+/**
+ Moves the snake one tile without applying any rules, as stepGame does after its checks
+ @param state The game state
+ @param direction The direction to move in
+ @param grow True to keep the tail where it is
+ */
+void moveSnake(GameState &state, int direction, bool grow);
+
+/**
+ Returns one of the moves that make up the body
+ @param state The game state
+ @param index The move number, 0 being the move just in front of the tail
+ @return The direction of that move
+ */
+int moveAt(const GameState &state, int index);
+
+/**
+ Copies the body into an array of segments, head first
+ @param state The game state
+ @param body An array with room for gridCells segments
+ @return The number of segments copied
+ */
+int copyBody(const GameState &state, Segment body[]);
+
+/**
+ Records the changes from a base state to a later state of the same game
+ @param base The earlier state
+ @param current The later state
+ @param delta The delta to fill in
+ @return False if the states are too far apart for a delta, in which case a full copy should be kept
+ */
+bool makeDelta(const GameState &base, const GameState &current, GameDelta &delta);
+
+/**
+ Computes the Zobrist hash of a game from scratch. GameState::hash always holds the same
+ value, updated piece by piece as the snake moves and the fruits change.
+ @param state The game state
+ @return The 64-bit hash of the snake, head, fruits and direction
+ */
+uint64_t computeHash(const GameState &state);
+
+/**
+ Hashes everything that decides how a game goes on: the Zobrist hash, the body's moves
+ in order, the generator, the counters and the timer. Only integers go in, so the same
+ game gives the same digest on every compiler and CPU; golden files compare these.
+ @param state The game state
+ @return The 64-bit digest
+ */
+uint64_t stateDigest(const GameState &state);
+
+/**
+ Rebuilds a later state from a base state and a delta made against it
+ @param base The state passed to makeDelta as the base
+ @param delta The delta
+ @param state The rebuilt state
+ */
+void applyDelta(const GameState &base, const GameDelta &delta, GameState &state);
+
+#endif
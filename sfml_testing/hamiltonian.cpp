@@ -0,0 +1,85 @@
+//Hamiltonian-cycle policy, see hamiltonian.hpp.
+
+#include "hamiltonian.hpp"
+
+using namespace std;
+
+bool buildHamiltonianCycle(int width, int height, vector<uint16_t> &next, vector<uint16_t> &index) {
+    vector<uint16_t> order(width * height);
+    if (!buildCycleOrder(width, height, order.data())) {
+        return false;
+    }
+    next.assign(width * height, 0);
+    index.assign(width * height, 0);
+    for (int i = 0; i < width * height; ++i) {
+        next[order[i]] = order[(i + 1) % (width * height)];
+        index[order[i]] = (uint16_t) i;
+    }
+    return true;
+}
+
+/**
+ Returns how far ahead one cell is from another going forward along the cycle
+ @param from The cell to start from
+ @param to The cell to reach
+ @return The number of steps along the cycle
+ */
+static int cycleDistance(int from, int to) {
+    int distance = boardCycle.index[to] - boardCycle.index[from];
+    return (distance < 0) ? distance + gridCells : distance;
+}
+
+int hamiltonianDecide(const GameState &state) {
+    int head = state.headCell;
+    int emptyCells = gridCells - state.length;
+    int toTail = (state.length > 1) ? cycleDistance(head, state.tailCell) : gridCells;
+    int toFruit = (state.fruitX >= 0) ? cycleDistance(head, cellAt(state.fruitX, state.fruitY)) : gridCells;
+
+    //How far ahead along the cycle the head may jump without catching up with the tail.
+    //Keep a margin for growing, and stop cutting once half the board is snake.
+    int allowed = 0;
+    if (emptyCells >= gridCells / 2) {
+        allowed = toTail - 4;
+        if (toFruit < toTail) {
+            allowed--;
+            if ((toTail - allowed) * 4 > emptyCells) {
+                allowed -= 10;
+            }
+        }
+        allowed = min(allowed, toFruit); //Never jump past the fruit
+    }
+
+    //Take the neighbour furthest along the cycle within that distance, or else the next cell on the cycle
+    int bestDirection = -1;
+    int bestDistance = 0;
+    for (int direction = 0; direction < 4; ++direction) {
+        int x = cellX(head) + moveDX[direction];
+        int y = cellY(head) + moveDY[direction];
+        if (x < 0 || x >= gridWidth || y < 0 || y >= gridHeight || direction == oppositeDirection(state.direction)) {
+            continue;
+        }
+        bool grow = (x == state.fruitX && y == state.fruitY) || (x == state.specialFruitX && y == state.specialFruitY);
+        if (isOccupied(state, x, y) && (grow || cellAt(x, y) != state.tailCell)) {
+            continue; //The tail is the only body cell that moves out of the way in time
+        }
+        int distance = cycleDistance(head, cellAt(x, y));
+        bool onCycle = (distance == 1);
+        if ((onCycle || distance <= allowed) && distance > bestDistance) {
+            bestDistance = distance;
+            bestDirection = direction;
+        }
+    }
+    if (bestDirection >= 0) {
+        return bestDirection;
+    }
+
+    //Nothing safe ahead (only possible off the cycle at the start): take any free neighbour
+    for (int direction = 0; direction < 4; ++direction) {
+        int x = cellX(head) + moveDX[direction];
+        int y = cellY(head) + moveDY[direction];
+        if (x >= 0 && x < gridWidth && y >= 0 && y < gridHeight && !isOccupied(state, x, y) && direction != oppositeDirection(state.direction)) {
+            return direction;
+        }
+    }
+    return state.direction;
+}
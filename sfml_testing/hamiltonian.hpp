@@ -0,0 +1,103 @@
+//Hamiltonian-cycle policy: a path that visits every cell once and comes back to
+//its start. A snake that follows it can never trap itself, so it is a safe
+//fallback for long attract-mode games and a baseline for other bots. The policy
+//cuts across the cycle toward the fruit while the board is still mostly empty.
+
+#ifndef HAMILTONIAN_HPP
+#define HAMILTONIAN_HPP
+
+#include "game_state.hpp"
+
+#include <vector>
+
+/**
+ Writes the cells of a Hamiltonian cycle of a board in visiting order. One side
+ of the board is kept as the way back to the start and the rest is swept in a zigzag.
+ @param width The board width
+ @param height The board height
+ @param order Receives width * height cell indices (y * width + x)
+ @return False if the board has no such cycle (both sides odd, or a side shorter than 2)
+ */
+constexpr bool buildCycleOrder(int width, int height, uint16_t order[]) {
+    if (width < 2 || height < 2 || (width % 2 != 0 && height % 2 != 0)) {
+        return false;
+    }
+    int i = 0;
+    if (height % 2 == 0) {
+        //Along the top row, zigzag down through the other columns, then back up the left column
+        for (int x = 0; x < width; ++x) {
+            order[i++] = (uint16_t) x;
+        }
+        for (int y = 1; y < height; ++y) {
+            for (int step = 1; step < width; ++step) {
+                int x = (y % 2 == 1) ? width - step : step;
+                order[i++] = (uint16_t) (y * width + x);
+            }
+        }
+        for (int y = height - 1; y >= 1; --y) {
+            order[i++] = (uint16_t) (y * width);
+        }
+    } else {
+        //Down the left column, zigzag right through the other rows, then back along the top row
+        for (int y = 0; y < height; ++y) {
+            order[i++] = (uint16_t) (y * width);
+        }
+        for (int x = 1; x < width; ++x) {
+            for (int step = 1; step < height; ++step) {
+                int y = (x % 2 == 1) ? height - step : step;
+                order[i++] = (uint16_t) (y * width + x);
+            }
+        }
+        for (int x = width - 1; x >= 1; --x) {
+            order[i++] = (uint16_t) x;
+        }
+    }
+    return true;
+}
+
+//Lookup tables for one board size, built at compile time
+template <int W, int H>
+struct CycleTable {
+    uint16_t next[W * H]; //Cell that follows each cell on the cycle
+    uint16_t index[W * H]; //Position of each cell along the cycle
+};
+
+/**
+ Builds the cycle lookup tables for a board size at compile time
+ @return The next-cell and position tables
+ */
+template <int W, int H>
+constexpr CycleTable<W, H> makeCycleTable() {
+    static_assert(W % 2 == 0 || H % 2 == 0, "A Hamiltonian cycle needs an even side");
+    CycleTable<W, H> table = {};
+    uint16_t order[W * H] = {};
+    buildCycleOrder(W, H, order);
+    for (int i = 0; i < W * H; ++i) {
+        table.next[order[i]] = order[(i + 1) % (W * H)];
+        table.index[order[i]] = (uint16_t) i;
+    }
+    return table;
+}
+
+//Tables for the board the game is played on
+constexpr CycleTable<gridWidth, gridHeight> boardCycle = makeCycleTable<gridWidth, gridHeight>();
+
+/**
+ Builds cycle lookup tables at run time, for board sizes without a compile-time table
+ @param width The board width
+ @param height The board height
+ @param next Receives the cell that follows each cell on the cycle
+ @param index Receives the position of each cell along the cycle
+ @return False if the board has no Hamiltonian cycle
+ */
+bool buildHamiltonianCycle(int width, int height, std::vector<uint16_t> &next, std::vector<uint16_t> &index);
+
+/**
+ Chooses the next direction by following the board cycle, cutting ahead along it
+ toward the fruit when that cannot run into the tail
+ @param state The current game state
+ @return The direction constant to pass to stepGame
+ */
+int hamiltonianDecide(const GameState &state);
+
+#endif
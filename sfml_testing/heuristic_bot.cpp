@@ -0,0 +1,91 @@
+//Weighted heuristic bot, see heuristic_bot.hpp.
+
+#include "heuristic_bot.hpp"
+#include "bitboard.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+using namespace std;
+
+const int boardSpan = gridWidth + gridHeight; //Longest Manhattan distance, used to scale distances
+const int64_t featureOne = 1 << 20; //A feature value of 1 in fixed point
+const double weightOne = 65536; //A weight of 1 in fixed point
+
+/**
+ Rounds a weight to fixed point. Moves are scored in integers only, so the same weights
+ choose the same moves on every CPU: with doubles, a compiler that fuses a multiply and
+ an add (as ARM builds do) could round a close call the other way.
+ @param weight The weight
+ @return The weight in 1/65536ths
+ */
+static int64_t fixedWeight(double weight) {
+    return llround(weight * weightOne);
+}
+
+int heuristicDecide(const GameState &state, const HeuristicWeights &weights) {
+    const int64_t fruitWeight = fixedWeight(weights.fruitDistance);
+    const int64_t freeWeight = fixedWeight(weights.freeSpace);
+    const int64_t tailWeight = fixedWeight(weights.tailDistance);
+    const int64_t specialWeight = fixedWeight(weights.specialFruit);
+    int bestDirection = state.direction;
+    int64_t bestScore = INT64_MIN;
+    for (int direction = 0; direction < 4; ++direction) {
+        int x = cellX(state.headCell) + moveDX[direction];
+        int y = cellY(state.headCell) + moveDY[direction];
+        if (direction == oppositeDirection(state.direction) || x < 0 || x >= gridWidth || y < 0 || y >= gridHeight) {
+            continue;
+        }
+        bool ateFruit = (x == state.fruitX && y == state.fruitY);
+        bool grow = ateFruit || (x == state.specialFruitX && y == state.specialFruitY);
+        if (isOccupied(state, x, y) && (grow || cellAt(x, y) != state.tailCell)) {
+            continue; //The tail is the only body cell that moves out of the way in time
+        }
+
+        //Look at the board after the move
+        GameState next = state;
+        moveSnake(next, direction, grow);
+        uint32_t freeRows[gridHeight];
+        freeBoard(next, freeRows, true);
+        FloodResult flood = floodFill(freeRows, next.headCell, (next.length > 1) ? next.tailCell : -1, nullptr, 0);
+        int freeCells = gridCells - next.length;
+
+        //Each feature is a fraction from 0 to 1 in fixed point
+        int64_t score = 0;
+        if (state.fruitX >= 0) {
+            score -= fruitWeight * ((abs(x - state.fruitX) + abs(y - state.fruitY)) * featureOne / boardSpan);
+        }
+        score += freeWeight * ((freeCells > 0) ? (flood.reachable - 1) * featureOne / freeCells : featureOne);
+        if (next.length <= 2 || flood.targetDistance >= 0) {
+            score += tailWeight * (featureOne - max(flood.targetDistance, 0) * featureOne / gridCells);
+        } else {
+            score -= tailWeight * featureOne;
+        }
+        if (state.specialFruitX >= 0) {
+            score -= specialWeight * ((abs(x - state.specialFruitX) + abs(y - state.specialFruitY)) * featureOne / boardSpan);
+        }
+        if (score > bestScore) {
+            bestScore = score;
+            bestDirection = direction;
+        }
+    }
+    return bestDirection;
+}
+
+bool loadHeuristicWeights(const string &path, HeuristicWeights &weights) {
+    ifstream inFile(path);
+    HeuristicWeights loaded;
+    if (!(inFile >> loaded.fruitDistance >> loaded.freeSpace >> loaded.tailDistance >> loaded.specialFruit)) {
+        return false;
+    }
+    weights = loaded;
+    return true;
+}
+
+bool saveHeuristicWeights(const string &path, const HeuristicWeights &weights) {
+    ofstream outFile(path);
+    outFile.precision(17);
+    outFile << weights.fruitDistance << " " << weights.freeSpace << " " << weights.tailDistance << " " << weights.specialFruit << endl;
+    return (bool) outFile;
+}
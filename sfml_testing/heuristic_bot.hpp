@@ -0,0 +1,48 @@
+//Weighted heuristic bot. Every safe move is scored by a weighted sum of a few
+//features of the board after the move: closeness to the fruit, free space the
+//head can still reach, whether (and how quickly) it can reach its own tail, and
+//closeness to the special fruit. The weights are meant to be tuned by snake_tune.
+//Scores are summed in fixed point, so a game plays out the same on every CPU.
+
+#ifndef HEURISTIC_BOT_HPP
+#define HEURISTIC_BOT_HPP
+
+#include "game_state.hpp"
+
+#include <string>
+
+const int heuristicWeightCount = 4;
+
+//Weights of the move features
+struct HeuristicWeights {
+    double fruitDistance = 1.0; //Reward for moving closer to the fruit
+    double freeSpace = 2.0; //Reward for keeping a large area reachable
+    double tailDistance = 1.0; //Reward for being able to follow the tail, more when it is close
+    double specialFruit = 0.5; //Reward for moving closer to the special fruit
+};
+
+/**
+ Chooses the direction for the next move
+ @param state The current game state
+ @param weights The feature weights
+ @return The direction constant to pass to stepGame
+ */
+int heuristicDecide(const GameState &state, const HeuristicWeights &weights);
+
+/**
+ Reads weights written by saveHeuristicWeights
+ @param path The file to read
+ @param weights The weights to fill in
+ @return False if the file is missing or malformed
+ */
+bool loadHeuristicWeights(const std::string &path, HeuristicWeights &weights);
+
+/**
+ Writes weights as one line of text
+ @param path The file to write
+ @param weights The weights
+ @return False if the file could not be written
+ */
+bool saveHeuristicWeights(const std::string &path, const HeuristicWeights &weights);
+
+#endif
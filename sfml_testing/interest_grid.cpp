@@ -0,0 +1,92 @@
+//Buckets of what each player can see, see interest_grid.hpp.
+
+#include "interest_grid.hpp"
+
+#include <algorithm>
+using namespace std;
+
+InterestGrid::InterestGrid(int width, int height) {
+    boardWidth = width;
+    boardHeight = height;
+    bucketsWide = (width + (1 << interestBucketShift) - 1) >> interestBucketShift;
+    int bucketsHigh = (height + (1 << interestBucketShift) - 1) >> interestBucketShift;
+    buckets.resize((size_t) bucketsWide * bucketsHigh);
+    bandRows = (bucketsHigh + maxInterestBands - 1) / maxInterestBands;
+    bands = (bucketsHigh + bandRows - 1) / bandRows;
+}
+
+void InterestGrid::apply(const InterestEdit &edit) {
+    Bucket &bucket = bucketOf(edit.cell);
+    if (edit.type == InterestAddSegment) {
+        bucket.segments.push_back(InterestEntry{edit.cell, edit.id});
+    } else if (edit.type == InterestRemoveSegment) {
+        removeEntry(bucket.segments, edit.cell, edit.id);
+    } else if (edit.type == InterestAddFruit) {
+        bucket.fruits.push_back(InterestEntry{edit.cell, edit.id});
+    } else {
+        removeEntry(bucket.fruits, edit.cell, edit.id);
+    }
+}
+
+int InterestGrid::bandCount() const {
+    return bands;
+}
+
+void InterestGrid::query(const ArenaViewport &viewport, int snakeCount, VisibleSet &visible) const {
+    int left = max(0, viewport.x), top = max(0, viewport.y);
+    int right = min(boardWidth, viewport.x + viewport.width), bottom = min(boardHeight, viewport.y + viewport.height);
+    visible.viewport = ArenaViewport{left, top, max(0, right - left), max(0, bottom - top)};
+    visible.segments.clear();
+    visible.fruits.clear();
+    visible.snakes.clear();
+    if (visible.seen.size() != (size_t) snakeCount) {
+        visible.seen.assign(snakeCount, 0);
+        visible.query = 0;
+    }
+    if (++visible.query == 0) {
+        //Wrapped around: older numbers could come back, so start them over
+        fill(visible.seen.begin(), visible.seen.end(), 0);
+        visible.query = 1;
+    }
+    if (right <= left || bottom <= top) {
+        return;
+    }
+
+    //Buckets inside the viewport are taken whole; only the ones on its edge are filtered
+    auto inside = [&](uint32_t cell) {
+        int x = (int) (cell & 0xFFFF), y = (int) (cell >> 16);
+        return x >= left && x < right && y >= top && y < bottom;
+    };
+    for (int by = top >> interestBucketShift; by <= (bottom - 1) >> interestBucketShift; ++by) {
+        for (int bx = left >> interestBucketShift; bx <= (right - 1) >> interestBucketShift; ++bx) {
+            const Bucket &bucket = buckets[(size_t) by * bucketsWide + bx];
+            bool whole = (bx << interestBucketShift) >= left && ((bx + 1) << interestBucketShift) <= right &&
+                         (by << interestBucketShift) >= top && ((by + 1) << interestBucketShift) <= bottom;
+            for (const InterestEntry &segment : bucket.segments) {
+                if (!whole && !inside(segment.cell)) {
+                    continue;
+                }
+                visible.segments.push_back(segment);
+                if (visible.seen[segment.id] != visible.query) {
+                    visible.seen[segment.id] = visible.query;
+                    visible.snakes.push_back(segment.id);
+                }
+            }
+            for (const InterestEntry &fruit : bucket.fruits) {
+                if (whole || inside(fruit.cell)) {
+                    visible.fruits.push_back(fruit);
+                }
+            }
+        }
+    }
+}
+
+void InterestGrid::removeEntry(vector<InterestEntry> &entries, uint32_t cell, int id) {
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].cell == cell && entries[i].id == id) {
+            entries[i] = entries.back();
+            entries.pop_back();
+            return;
+        }
+    }
+}
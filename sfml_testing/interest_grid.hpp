@@ -0,0 +1,116 @@
+//Which snake segments and fruit each player of an arena can see. The board is cut into
+//square buckets of 16x16 tiles, each listing the snake segments and fruit inside it.
+//The arena keeps the lists up to date as heads move in and tails move out, so a tick
+//costs a few list edits per snake and nothing is rebuilt. Bucket rows are grouped in
+//bands so that a tick's edits can be shared out over threads by band. A viewport only
+//visits the buckets it overlaps, so what it costs depends on what is in view, not on
+//how many snakes the arena holds.
+
+#ifndef INTEREST_GRID_HPP
+#define INTEREST_GRID_HPP
+
+#include <cstdint>
+#include <vector>
+
+const int interestBucketShift = 4; //Buckets of 16x16 tiles
+const int maxInterestBands = 64; //Groups of bucket rows that can be edited in parallel
+
+//Kinds of InterestEdit
+const uint8_t InterestAddSegment = 0;
+const uint8_t InterestRemoveSegment = 1;
+const uint8_t InterestAddFruit = 2;
+const uint8_t InterestRemoveFruit = 3;
+
+//A segment or fruit in a bucket: its cell (x low, y high, as ArenaCell) and owner
+struct InterestEntry {
+    uint32_t cell;
+    uint16_t id; //Snake number for a segment, fruit number for a fruit
+};
+
+//One change to the buckets
+struct InterestEdit {
+    uint32_t cell;
+    uint16_t id;
+    uint8_t type; //One of the Interest edit constants
+};
+
+//A rectangle of the board a player sees, in tiles
+struct ArenaViewport {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+//What a viewport holds; kept between queries so the lists keep their memory
+struct VisibleSet {
+    ArenaViewport viewport;
+    std::vector<InterestEntry> segments; //Snake segments in view
+    std::vector<InterestEntry> fruits; //Fruit in view
+    std::vector<uint16_t> snakes; //Each snake with a segment in view, once
+    std::vector<uint32_t> seen; //Query number each snake was last listed in, to list it once
+    uint32_t query = 0;
+};
+
+class InterestGrid {
+public:
+    /**
+     Sets up empty buckets over a board
+     @param width Number of tiles in width
+     @param height Number of tiles in height
+     */
+    InterestGrid(int width, int height);
+
+    /**
+     Applies a change. Changes in different bands may be applied on different threads
+     at once; the order within a band decides the order of the lists.
+     @param edit The change
+     */
+    void apply(const InterestEdit &edit);
+
+    /**
+     Returns the band of rows a cell's bucket is in
+     @param cell The cell
+     @return The band, from 0 to bandCount() - 1
+     */
+    int bandOf(uint32_t cell) const {
+        return ((cell >> 16) >> interestBucketShift) / bandRows;
+    }
+
+    int bandCount() const;
+
+    /**
+     Lists the segments and fruit in a viewport
+     @param viewport The rectangle, clipped to the board
+     @param snakeCount Number of snakes in the arena
+     @param visible Receives the lists
+     */
+    void query(const ArenaViewport &viewport, int snakeCount, VisibleSet &visible) const;
+
+private:
+    struct Bucket {
+        std::vector<InterestEntry> segments;
+        std::vector<InterestEntry> fruits;
+    };
+
+    Bucket &bucketOf(uint32_t cell) {
+        return buckets[((cell >> 16) >> interestBucketShift) * bucketsWide + ((cell & 0xFFFF) >> interestBucketShift)];
+    }
+
+    /**
+     Takes one entry out of a list, not keeping the order
+     @param entries The list
+     @param cell The entry's cell
+     @param id The entry's owner
+     */
+    static void removeEntry(std::vector<InterestEntry> &entries, uint32_t cell, int id);
+
+    int boardWidth;
+    int boardHeight;
+    int bucketsWide;
+    int bandRows; //Rows of buckets per band
+    int bands;
+    std::vector<Bucket> buckets; //Row-major
+};
+
+#endif
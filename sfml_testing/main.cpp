@@ -12,81 +12,37 @@
 #include <SFML/Graphics.hpp>
 #include <SFML/Audio.hpp>
 
+#include "game_state.hpp"
+#include "autopilot.hpp"
+#include "bitboard.hpp"
+#include "bot_channel.hpp"
+#include "game_client.hpp"
+#include "hamiltonian.hpp"
+#include "mcts.hpp"
+#include "multi_game.hpp"
+#include "plugin_bot.hpp"
+#include "prediction.hpp"
+
+#include <algorithm>
 #include <iostream>
 #include <cstdlib>
 #include <ctime>
 #include <vector>
 #include <fstream>
+#include <cmath>
 using namespace std;
 using namespace sf;
 
 const int tileSize = 40;  //Size of each tile
-const int gridWidth = 20; //Number of tiles in width
-const int gridHeight = 15; //Number of tiles in height
-
-//Direction constants
-const int Up = 0;
-const int Down = 1;
-const int Left = 2;
-const int Right = 3;
-
-//Snake segment structure
-struct Segment {
-    int x;
-    int y;
-};
 
 /**
- This function places a fruit randomly on the screen passed through reference, and ensures it is not on the snake.
- @param fruitX The x-coordinate of the fruit.
- @param fruitY The y-coordinate of the fruit.
- @param snakeBody A vector of structures indicating the coordinates.
- @param fruitSprite The sprite object representing the fruit
+ Returns the time between moves for a speed level, in whole milliseconds so the game
+ state advances by the same amount on every machine
+ @param speedLevel The speed level, 1 to 10
+ @return The delay in milliseconds, 460 at level 1 down to 100 at level 10
  */
-void placeFruit(int &fruitX, int &fruitY, const vector<Segment> &snakeBody, Sprite &fruitSprite) {
-    //Randomly pick a spot on the board
-    fruitX = rand()%gridWidth;
-    fruitY = rand()%gridHeight;
-
-    //Ensure the fruit doesn't land on the snake
-    for (const Segment &segment:snakeBody) {
-        if (segment.x == fruitX && segment.y == fruitY) {
-            placeFruit(fruitX, fruitY, snakeBody, fruitSprite);  //Recurse if the fruit is on the snake
-            return;
-        }
-    }
-    
-    fruitSprite.setPosition(fruitX * tileSize, fruitY * tileSize);
-
-}
-
-/**
- * This function places a special fruit randomly on the screen passed through reference, and ensures it is not on the snake.
- * @param specialFruitX The x-coordinate of the special fruit.
- * @param specialFruitY The y-coordinate of the special fruit.
- * @param snakeBody A vector of structures indicating the coordinates
- * @param specialFruitSprite The sprite object representing the special fruit
- * @param specialFruitOnScreen Whether the special fruit is currently visible on the screen.
- */
-void placeSpecialFruit(int &specialFruitX, int &specialFruitY, const vector<Segment> &snakeBody, Sprite &specialFruitSprite, bool ateSpecialFruit) {
-    if (ateSpecialFruit == true) { //If eaten, special fruit is moved off screen
-        specialFruitX = -1;
-        specialFruitY = -1;
-    }
-    else {
-        specialFruitX = rand() % gridWidth;
-        specialFruitY = rand() % gridHeight;
-    }
-
-    //Ensure the fruit doesn't land on the snake
-    for (const Segment &segment: snakeBody) {
-        if (segment.x == specialFruitX && segment.y == specialFruitY) {
-            placeFruit(specialFruitX, specialFruitY, snakeBody, specialFruitSprite);  //Recurse if the fruit is on the snake
-            return;
-        }
-    }
-    
-    specialFruitSprite.setPosition(specialFruitX * tileSize , specialFruitY * tileSize);
+int speedDelayMs(int speedLevel) {
+    return 460 - (speedLevel - 1) * 40;
 }
 
 /**
@@ -94,8 +50,9 @@ void placeSpecialFruit(int &specialFruitX, int &specialFruitY, const vector<Segm
  @param window The SFML RenderWindow for the game
  @param snakeColor The snake's color reference,  updated based on user input
  @param speedLevel The speed level reference, updated based on user input
+ @param players The number of players reference, updated based on user input
  */
-void displayStartScreen(RenderWindow &window, Color &snakeColor, int &speedLevel) {
+void displayStartScreen(RenderWindow &window, Color &snakeColor, int &speedLevel, int &players) {
     Font font;
     if (!font.loadFromFile("Roboto-Regular.ttf")) {
         cout << "Error loading font!" << endl;
@@ -108,7 +65,7 @@ void displayStartScreen(RenderWindow &window, Color &snakeColor, int &speedLevel
     title.setPosition(gridWidth * tileSize / 2 - title.getGlobalBounds().width / 2, 50);
 
     //Instructions text
-    Text instructions("Press UP/DOWN to select snake color\nPress LEFT/RIGHT to adjust speed\nPress ENTER to start", font, 20);
+    Text instructions("Press UP/DOWN to select snake color\nPress LEFT/RIGHT to adjust speed\nPress ENTER to start\nPress 1-4 for the number of players\nPress A during the game to switch autopilot (BFS, cycle, MCTS, off)", font, 20);
     instructions.setFillColor(Color::White);
     instructions.setPosition(gridWidth * tileSize / 2 - instructions.getGlobalBounds().width / 2, 200);
 
@@ -118,6 +75,7 @@ void displayStartScreen(RenderWindow &window, Color &snakeColor, int &speedLevel
     int selectedColor = 0;
 
     speedLevel = 5; //Default speed level
+    players = 1;
     
     while (window.isOpen()) {
         
@@ -139,6 +97,9 @@ void displayStartScreen(RenderWindow &window, Color &snakeColor, int &speedLevel
                 if (event.key.code == Keyboard::Right) {
                     speedLevel = min(10, speedLevel + 1); //Increase speed level, maximum 10
                 }
+                if (event.key.code >= Keyboard::Num1 && event.key.code <= Keyboard::Num4) {
+                    players = event.key.code - Keyboard::Num1 + 1;
+                }
                 if (event.key.code == Keyboard::Enter) {
                     snakeColor = colors[selectedColor];
                     return; //Start the game
@@ -174,6 +135,12 @@ void displayStartScreen(RenderWindow &window, Color &snakeColor, int &speedLevel
         speedText.setPosition(gridWidth * tileSize / 2 - speedText.getGlobalBounds().width / 2, 500);
         window.draw(speedText);
 
+        //Show number of players
+        Text playersText("Players: " + to_string(players), font, 25);
+        playersText.setFillColor(Color::White);
+        playersText.setPosition(gridWidth * tileSize / 2 - playersText.getGlobalBounds().width / 2, 540);
+        window.draw(playersText);
+
         //Show everything
         window.display();
     }
@@ -220,42 +187,413 @@ int loadHighScore() {
     return highScore;
 }
 
+/**
+ Plays a game with two to four snakes on one board, each steered by its own keys:
+ arrows, WASD, IJKL and the number pad (8, 5, 4, 6)
+ @param window The SFML RenderWindow for the game
+ @param players The number of players
+ @param snakeColor The color chosen for the first player
+ @param moveDelayMs Milliseconds between moves
+ @return The highest score any player reached
+ */
+int playLocalMultiplayer(RenderWindow &window, int players, Color snakeColor, int moveDelayMs) {
+    MultiGame game(gridWidth, gridHeight, players, players, static_cast<uint64_t>(time(0)));
+    uint8_t directions[maxMultiSnakes];
+    uint8_t events[maxMultiSnakes];
+    for (int i = 0; i < players; ++i) {
+        directions[i] = game.snake(i).direction;
+    }
+
+    //Keys for up, down, left and right of each player
+    const Keyboard::Key keys[4][4] = {{Keyboard::Up, Keyboard::Down, Keyboard::Left, Keyboard::Right},
+                                      {Keyboard::W, Keyboard::S, Keyboard::A, Keyboard::D},
+                                      {Keyboard::I, Keyboard::K, Keyboard::J, Keyboard::L},
+                                      {Keyboard::Numpad8, Keyboard::Numpad5, Keyboard::Numpad4, Keyboard::Numpad6}};
+    const Color colors[4] = {snakeColor, Color::Blue, Color::Magenta, Color::Yellow};
+
+    Texture fruitTexture;
+    fruitTexture.loadFromFile("fruit.png");
+    Sprite fruitSprite;
+    fruitSprite.setTexture(fruitTexture);
+    fruitSprite.setScale(float(tileSize) / fruitSprite.getLocalBounds().width, float(tileSize) / fruitSprite.getLocalBounds().height); //Scales image down
+
+    Font font;
+    if (!font.loadFromFile("Roboto-Regular.ttf")) {
+        cout << "Error loading font!" << endl;
+    }
+
+    Clock clock;
+    //The game goes on while more than one snake is alive
+    while (window.isOpen() && game.aliveCount() > 1) {
+        Event event;
+        while (window.pollEvent(event)) {
+            if (event.type == Event::Closed)
+                window.close();
+
+            if (event.type == Event::KeyPressed) {
+                for (int player = 0; player < players; ++player) {
+                    for (int direction = 0; direction < 4; ++direction) {
+                        if (event.key.code == keys[player][direction] && game.snake(player).direction != oppositeDirection(direction)) {
+                            directions[player] = (uint8_t) direction;
+                        }
+                    }
+                }
+            }
+        }
+
+        //Move every snake at once
+        if (clock.getElapsedTime().asMilliseconds() >= moveDelayMs) {
+            game.step(directions, events);
+            clock.restart();
+        }
+
+        //Draw the checkerboard pattern
+        window.clear();
+        for (int y = 0; y < gridHeight; ++y) {
+            for (int x = 0; x < gridWidth; ++x) {
+                RectangleShape tile(Vector2f(tileSize, tileSize));
+                tile.setFillColor(((x + y) % 2 == 0) ? Color(100, 200, 100) : Color(50, 150, 50));
+                tile.setPosition(x * tileSize, y * tileSize);
+                window.draw(tile);
+            }
+        }
+
+        //Draw the snakes, heads in white
+        for (int player = 0; player < players; ++player) {
+            const MultiSnake &snake = game.snake(player);
+            for (int i = 0; i < snake.length; ++i) {
+                int cell = snake.cellAt(i);
+                RectangleShape snakeSegment(Vector2f(tileSize, tileSize));
+                snakeSegment.setFillColor((i == snake.length - 1) ? Color::White : colors[player]);
+                snakeSegment.setPosition(cellX(cell) * tileSize, cellY(cell) * tileSize);
+                window.draw(snakeSegment);
+            }
+        }
+
+        //Draw the fruits
+        for (int cell : game.fruitCells()) {
+            fruitSprite.setPosition(cellX(cell) * tileSize, cellY(cell) * tileSize);
+            window.draw(fruitSprite);
+        }
+
+        //Show every player's score
+        for (int player = 0; player < players; ++player) {
+            Text scoreText("Player " + to_string(player + 1) + ": " + to_string(game.snake(player).score), font, 20);
+            scoreText.setFillColor(game.snake(player).alive ? Color::White : Color(150, 150, 150));
+            scoreText.setPosition(10, 10 + player * 30);
+            window.draw(scoreText);
+        }
+        window.display();
+    }
+
+    int bestScore = 0;
+    for (int player = 0; player < players; ++player) {
+        bestScore = max(bestScore, (int) game.snake(player).score);
+        if (game.snake(player).alive) {
+            cout << "Player " << player + 1 << " wins!" << endl;
+        }
+    }
+    cout << "Game Over!" << endl;
+    window.close();
+    return bestScore;
+}
+
+/**
+ Draws a room of a snake_server: the board, every snake with its head in white, and
+ the fruits
+ @param window The SFML RenderWindow for the game
+ @param game The room
+ @param tile Size of a tile in pixels
+ @param fruitSprite The fruit sprite, scaled to a tile
+ @param player The snake drawn in snakeColor, -1 for none
+ @param snakeColor Its color; the others are blue
+ */
+void drawNetworkRoom(RenderWindow &window, const MultiGame &game, float tile, Sprite &fruitSprite, int player, Color snakeColor) {
+    int width = game.width();
+    int height = game.height();
+
+    //Draw the checkerboard pattern
+    window.clear();
+    RectangleShape square(Vector2f(tile, tile));
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            square.setFillColor(((x + y) % 2 == 0) ? Color(100, 200, 100) : Color(50, 150, 50));
+            square.setPosition(x * tile, y * tile);
+            window.draw(square);
+        }
+    }
+
+    //Draw the snakes, heads in white
+    for (int i = 0; i < game.snakeCount(); ++i) {
+        const MultiSnake &snake = game.snake(i);
+        for (int j = 0; j < snake.length; ++j) {
+            int cell = snake.cellAt(j);
+            square.setFillColor((j == snake.length - 1) ? Color::White : (i == player ? snakeColor : Color::Blue));
+            square.setPosition(cell % width * tile, cell / width * tile);
+            window.draw(square);
+        }
+    }
+
+    for (int cell : game.fruitCells()) {
+        fruitSprite.setPosition(cell % width * tile, cell / width * tile);
+        window.draw(fruitSprite);
+    }
+}
+
+/**
+ Plays on a snake_server: the server runs the game, this predicts the player's own snake
+ ahead of it so turns show at once, and rolls back when the server disagrees
+ @param window The SFML RenderWindow for the game
+ @param address The server address
+ @param port The server port
+ @param roomNumber The room to join on the server
+ @param snakeColor The color of the player's own snake; the others are blue
+ @return The player's highest score, or 0 if the server could not be reached
+ */
+int playNetworkGame(RenderWindow &window, const IpAddress &address, unsigned short port, uint32_t roomNumber, Color snakeColor) {
+    GameClient client;
+    string error;
+    if (!client.connect(address, port, roomNumber, 5000, error)) {
+        cout << "Could not join the server: " << error << endl;
+        window.close();
+        return 0;
+    }
+    int width = client.boardWidth();
+    int height = client.boardHeight();
+    int player = client.playerId();
+    PredictedRoom room(width, height, client.tickMs(), player);
+
+    //The room can be any size, so the tiles shrink to fit the window
+    float tile = min(float(gridWidth * tileSize) / width, float(gridHeight * tileSize) / height);
+    Texture fruitTexture;
+    fruitTexture.loadFromFile("fruit.png");
+    Sprite fruitSprite;
+    fruitSprite.setTexture(fruitTexture);
+    fruitSprite.setScale(tile / fruitSprite.getLocalBounds().width, tile / fruitSprite.getLocalBounds().height);
+
+    Font font;
+    if (!font.loadFromFile("Roboto-Regular.ttf")) {
+        cout << "Error loading font!" << endl;
+    }
 
-int main() {
+    const Keyboard::Key keys[4] = {Keyboard::Up, Keyboard::Down, Keyboard::Left, Keyboard::Right};
+    int bestScore = 0;
+    uint32_t drawnTick = 0;
+    while (window.isOpen() && client.connected()) {
+        Event event;
+        while (window.pollEvent(event)) {
+            if (event.type == Event::Closed)
+                window.close();
+
+            //Turn the predicted snake now and tell the server which tick the turn is for
+            if (event.type == Event::KeyPressed && room.started()) {
+                for (int key = 0; key < 4; ++key) {
+                    if (event.key.code == keys[key] && room.game().snake(player).direction != oppositeDirection(key)) {
+                        client.setDirection(key, room.setDirection(key));
+                    }
+                }
+            }
+        }
+
+        if (client.poll()) {
+            room.authoritative(client.state(), client.stateTime());
+        }
+        room.advance(client.now(), client.roundTripMs());
+
+        //Draw only when the predicted room moved on
+        const MultiGame &game = room.game();
+        if (!room.started() || game.tick() == drawnTick) {
+            sleep(milliseconds(1));
+            continue;
+        }
+        drawnTick = game.tick();
+
+        drawNetworkRoom(window, game, tile, fruitSprite, player, snakeColor);
+
+        const MultiSnake &own = game.snake(player);
+        bestScore = max(bestScore, (int) own.score);
+        Text scoreText("Score: " + to_string(own.score) + (own.alive ? "" : "  (respawning)"), font, 20);
+        scoreText.setFillColor(Color::White);
+        scoreText.setPosition(10, 10);
+        window.draw(scoreText);
+        window.display();
+    }
+
+    if (!client.connected() && window.isOpen()) {
+        cout << "Lost the connection to the server" << endl;
+    }
+    client.disconnect();
+    PredictionStats stats = room.stats();
+    cout << "Predicted " << stats.predicted << " ticks, " << stats.rollbacks << " rollbacks re-stepping " << stats.resimulated
+         << " ticks, " << (stats.rollbacks ? stats.resimulateUs / stats.rollbacks : 0.0) << " us mean, " << stats.maxResimulateUs << " us max" << endl;
+    cout << "Game Over!" << endl;
+    window.close();
+    return bestScore;
+}
+
+/**
+ Watches a room of a snake_server through its spectator relay until the window is closed
+ @param window The SFML RenderWindow for the game
+ @param address The server address
+ @param port The relay's port
+ @param roomNumber The room to watch
+ */
+void watchNetworkGame(RenderWindow &window, const IpAddress &address, unsigned short port, uint32_t roomNumber) {
+    SpectatorClient spectator;
+    string error;
+    if (!spectator.connect(address, port, roomNumber, 5000, error)) {
+        cout << "Could not watch the room: " << error << endl;
+        window.close();
+        return;
+    }
+    Texture fruitTexture;
+    fruitTexture.loadFromFile("fruit.png");
+    Sprite fruitSprite;
+    fruitSprite.setTexture(fruitTexture);
+    Font font;
+    if (!font.loadFromFile("Roboto-Regular.ttf")) {
+        cout << "Error loading font!" << endl;
+    }
+
+    vector<int> cells;
+    while (window.isOpen() && spectator.connected()) {
+        Event event;
+        while (window.pollEvent(event)) {
+            if (event.type == Event::Closed)
+                window.close();
+        }
+        if (!spectator.poll()) {
+            sleep(milliseconds(1));
+            continue;
+        }
+
+        //Rebuild the room from the state; spectators draw exactly what the server has
+        const RoomSnapshot &state = spectator.state();
+        MultiGame game(state.width, state.height, maxMultiSnakes, 0, 0);
+        game.clearBoard(state.tick);
+        int bestScore = 0;
+        for (const SnapshotSnake &snake : state.snakes) {
+            snapshotCells(snake, state.width, cells);
+            game.placeSnake(snake.player, cells, snake.direction, snake.score);
+            bestScore = max(bestScore, (int) snake.score);
+        }
+        for (uint16_t fruit : state.fruits) {
+            game.placeFruit(fruit);
+        }
+        float tile = min(float(gridWidth * tileSize) / state.width, float(gridHeight * tileSize) / state.height);
+        fruitSprite.setScale(tile / fruitSprite.getLocalBounds().width, tile / fruitSprite.getLocalBounds().height);
+        drawNetworkRoom(window, game, tile, fruitSprite, -1, Color::Blue);
+
+        Text status("Room " + to_string(roomNumber) + "  players " + to_string(state.snakes.size()) + "  best " + to_string(bestScore), font, 20);
+        status.setFillColor(Color::White);
+        status.setPosition(10, 10);
+        window.draw(status);
+        window.display();
+    }
+    if (!spectator.connected() && window.isOpen()) {
+        cout << "Lost the connection to the relay" << endl;
+    }
+    window.close();
+}
+
+int main(int argc, char *argv[]) {
     bool playAgain = true;
     int highScore = loadHighScore(); //Loads high score file into local variable
+
+    //A bot library given as `--bot FILE` and a bot process connected to `--channel NAME`
+    //join the autopilots; `--connect HOST[:PORT]` plays on a snake_server instead, in
+    //the room given by `--room N`, and `--watch HOST[:PORT]` watches that room
+    static PluginBot pluginBot;
+    static BotChannel botChannel;
+    bool channelOpen = false;
+    string serverHost;
+    unsigned short serverPort = defaultServerPort;
+    uint32_t serverRoom = 0;
+    string watchHost;
+    unsigned short watchPort = defaultSpectatorPort;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string error;
+        if (string(argv[i]) == "--bot" && !pluginBot.load(argv[i + 1], error)) {
+            cout << "Could not load bot: " << error << endl;
+        }
+        if (string(argv[i]) == "--channel") {
+            channelOpen = botChannel.create(argv[i + 1], error);
+            if (!channelOpen) {
+                cout << "Could not create bot channel: " << error << endl;
+            }
+        }
+        if (string(argv[i]) == "--connect") {
+            serverHost = argv[i + 1];
+            size_t colon = serverHost.rfind(':');
+            if (colon != string::npos) {
+                serverPort = (unsigned short) atoi(serverHost.c_str() + colon + 1);
+                serverHost.erase(colon);
+            }
+        }
+        if (string(argv[i]) == "--watch") {
+            watchHost = argv[i + 1];
+            size_t colon = watchHost.rfind(':');
+            if (colon != string::npos) {
+                watchPort = (unsigned short) atoi(watchHost.c_str() + colon + 1);
+                watchHost.erase(colon);
+            }
+        }
+        if (string(argv[i]) == "--room") {
+            serverRoom = (uint32_t) atoi(argv[i + 1]);
+        }
+    }
+
+    //Spectators skip the menus
+    if (!watchHost.empty()) {
+        RenderWindow window(VideoMode(gridWidth * tileSize, gridHeight * tileSize), "Snake Game");
+        watchNetworkGame(window, IpAddress(watchHost), watchPort, serverRoom);
+        return 0;
+    }
     
     while (playAgain)
     {
-        int score = 0;
-        int fruit_counter = 0;
-        int numForSpecialFruit = 10; //Eat 10 regular fruits for a special fruit to show up
-
         //Create a window
         RenderWindow window(VideoMode(gridWidth * tileSize, gridHeight * tileSize), "Snake Game");
 
-        //Seed random number generator
-        srand(static_cast<unsigned int>(time(0)));
-
-        
         Color snakeColor = Color::Black; //Default to black body color
         int speedLevel = 5; //Default to medium speed
 
         //Show start screen
-        displayStartScreen(window, snakeColor, speedLevel);
+        int players = 1;
+        displayStartScreen(window, snakeColor, speedLevel, players);
+
+        //Online, the chosen color is all that applies; the server sets the speed
+        if (!serverHost.empty()) {
+            int bestScore = playNetworkGame(window, IpAddress(serverHost), serverPort, serverRoom, snakeColor);
+            if (bestScore > highScore) {
+                highScore = bestScore;
+                saveHighScore(highScore);
+            }
+            playAgain = playAgainPrompt();
+            continue;
+        }
 
-        //Create snake (using a vector for the snake body)
-        vector<Segment> snakeBody;
-        snakeBody.push_back({gridWidth / 2, gridHeight / 2});  //Initial position of the snake's head
+        //Two to four players share one board with their own keys
+        if (players > 1) {
+            int bestScore = playLocalMultiplayer(window, players, snakeColor, speedDelayMs(speedLevel));
+            if (bestScore > highScore) {
+                highScore = bestScore;
+                saveHighScore(highScore);
+            }
+            playAgain = playAgainPrompt();
+            continue;
+        }
+
+        //Create the game (snake, fruit and score all live in the game state)
+        GameState game;
+        newGame(game, static_cast<uint64_t>(time(0))); //Seed fruit placement with the time
+        Segment snakeBody[gridCells];
 
         //Create fruit
         Texture fruitTexture;
         fruitTexture.loadFromFile("fruit.png");
         Sprite fruitSprite;
         fruitSprite.setTexture(fruitTexture);
-        int fruitX, fruitY;
-        placeFruit(fruitX, fruitY, snakeBody, fruitSprite);
-        fruitSprite.setPosition(fruitX * tileSize, fruitY * tileSize);
         fruitSprite.setScale(float(tileSize) / fruitSprite.getLocalBounds().width, float(tileSize) / fruitSprite.getLocalBounds().height); //Scales image down
 
         //Create special fruit
@@ -263,25 +601,30 @@ int main() {
         specialFruitTexture.loadFromFile("special_fruit.png");
         Sprite specialFruitSprite;
         specialFruitSprite.setTexture(specialFruitTexture);
-        int special_fruit_x = -1;  //Initially no special fruit
-        int special_fruit_y = -1;  //Initially no special fruit
-        specialFruitSprite.setPosition(special_fruit_x * tileSize, special_fruit_y * tileSize);
         specialFruitSprite.setScale(float(tileSize) / specialFruitSprite.getLocalBounds().width, float(tileSize) / specialFruitSprite.getLocalBounds().height); //Scale image down
         
 
         //Direction variable
         int snakeDirection = Right; //Snake starts moving to the right initially
-        bool ateFruit = false; //If snake ate the fruit
-        bool ateSpecialFruit = false; //If snake ate the special fruit
+
+        //Autopilot plays by itself in attract mode. The A key switches between off, the BFS
+        //autopilot, the Hamiltonian cycle, which is slower but never traps itself, and the
+        //Monte Carlo tree search bot, which searches on every core between moves, and the
+        //bot library or bot process given on the command line
+        static Autopilot autopilot; //Static so its search buffers are set up once, not on the stack
+        static ThreadPool searchThreads;
+        static MctsBot mctsBot(searchThreads);
+        int autopilotMode = 0; //0 off, 1 BFS autopilot, 2 Hamiltonian cycle, 3 MCTS, 4 bot library, 5 bot process
+        long mctsPlayouts = 0;
+        double mctsSeconds = 0;
+        long mctsNodes = 0;
+        long mctsMoves = 0;
 
         //SFML clock to calculate time for automatic movement
         Clock clock;
         Time elapsedTime;
-        
-        Clock specialFruitClock;
-        Time specialFruitTime;
 
-        float moveDelay = 0.46f - ((speedLevel - 1) * 0.04f); //Maps speed level 1-10 to delay
+        int moveDelayMs = speedDelayMs(speedLevel); //Time between moves, and the time the game state advances per move
         
         //Load the munching sound of the apple
         SoundBuffer startSoundBufferFruitMunch;
@@ -311,90 +654,81 @@ int main() {
 
                 if (event.type == Event::KeyPressed) {  //Checks if a key is pressed
                     //Change snake direction based on key press, cannot go in opposite direction
-                    if (event.key.code == Keyboard::Up && snakeDirection != Down) {
+                    if (event.key.code == Keyboard::Up && game.direction != Down) {
                         snakeDirection = Up;
                     }
-                    if (event.key.code == Keyboard::Down && snakeDirection != Up) {
+                    if (event.key.code == Keyboard::Down && game.direction != Up) {
                         snakeDirection = Down;
                     }
-                    if (event.key.code == Keyboard::Left && snakeDirection != Right) {
+                    if (event.key.code == Keyboard::Left && game.direction != Right) {
                         snakeDirection = Left;
                     }
-                    if (event.key.code == Keyboard::Right && snakeDirection != Left) {
+                    if (event.key.code == Keyboard::Right && game.direction != Left) {
                         snakeDirection = Right;
                     }
+                    if (event.key.code == Keyboard::A) {
+                        //Skip the external bots that were not given
+                        do {
+                            autopilotMode = (autopilotMode + 1) % 6;
+                        } while ((autopilotMode == 4 && !pluginBot.loaded()) || (autopilotMode == 5 && !channelOpen));
+                    }
                 }
             }
 
             //Move the snake
             elapsedTime = clock.getElapsedTime();
-            if (elapsedTime.asSeconds() >= moveDelay) {
-                //Determine new head position based on direction
-                Segment newHead = snakeBody[0];
-                if (snakeDirection == Up) {
-                    newHead.y -= 1;
-                } else if (snakeDirection == Down) {
-                    newHead.y += 1;
-                } else if (snakeDirection == Left) {
-                    newHead.x -= 1;
-                } else if (snakeDirection == Right) {
-                    newHead.x += 1;
+            if (elapsedTime.asMilliseconds() >= moveDelayMs) {
+                //Autopilot steers instead of the arrow keys
+                if (autopilotMode == 1) {
+                    snakeDirection = autopilot.decide(game);
+                } else if (autopilotMode == 2) {
+                    snakeDirection = hamiltonianDecide(game);
+                } else if (autopilotMode == 3) {
+                    //Search for part of the move delay so the snake keeps its pace
+                    clock.restart();
+                    snakeDirection = mctsBot.decide(game, moveDelayMs * 2 / 5, moveDelayMs);
+                    MctsStats stats = mctsBot.lastStats();
+                    mctsPlayouts += stats.playouts;
+                    mctsSeconds += stats.seconds;
+                    mctsNodes += stats.treeNodes;
+                    mctsMoves++;
+                } else if (autopilotMode == 4) {
+                    snakeDirection = pluginBot.decide(game);
+                } else if (autopilotMode == 5) {
+                    //The bot process gets the same share of the move delay as the search
+                    clock.restart();
+                    snakeDirection = botChannel.decide(game, moveDelayMs * 400);
                 }
+                int events = stepGame(game, snakeDirection, moveDelayMs);
 
-                if (fruit_counter >= numForSpecialFruit && special_fruit_x == -1 && special_fruit_y == -1) {
-                    placeSpecialFruit(special_fruit_x, special_fruit_y, snakeBody, specialFruitSprite, ateSpecialFruit); //Place special fruit
-                }
-                if (fruit_counter >= numForSpecialFruit && specialFruitClock.getElapsedTime().asSeconds() >= 3.f) { //Moves the special fruit around every 3 seconds
-                    placeSpecialFruit(special_fruit_x, special_fruit_y, snakeBody, specialFruitSprite, ateSpecialFruit);
-                    specialFruitClock.restart(); //Restart clock
-                }
-                
-                
-                //Check if the snake eats the fruit
-                if (newHead.x == fruitX && newHead.y == fruitY) {
-                    ateFruit = true; //Snake will grow
-                    placeFruit(fruitX, fruitY, snakeBody, fruitSprite); //Place new fruit
-                    score++;
-                    fruit_counter++;
+                if (events & StepAteFruit) {
                     startFruitMunch.stop();
                     startFruitMunch.play();
                 }
-                
-                //Check if the snake eats the special fruit
-                if (newHead.x == special_fruit_x && newHead.y == special_fruit_y) {
-                    ateSpecialFruit = true; //Special fruit will disappear
-                    score+=5; //Give extra points
-                    fruit_counter=0;
-                    placeSpecialFruit(special_fruit_x, special_fruit_y, snakeBody, specialFruitSprite, ateSpecialFruit);
+                if (events & StepAteSpecialFruit) {
                     startSpecialFruitMunch.stop();
                     startSpecialFruitMunch.play();
                 }
 
-                snakeBody.insert(snakeBody.begin(), newHead);
-
-                if (ateFruit == false && ateSpecialFruit == false) {
-                    snakeBody.pop_back(); //Remove the tail if no fruit eaten
-                } else {
-                    ateFruit = false;
-                    ateSpecialFruit = false;
-                }
-
-                //Check if the snake collides with itself (game over)
-                for (size_t i = 1; i < snakeBody.size(); ++i) {
-                    if (snakeBody[i].x == newHead.x && snakeBody[i].y == newHead.y) {
-                        cout << "Game Over!" << endl;
-                        window.close();
-                    }
-                }
-
-                //Check if the snake hits the wall (game over)
-                if (newHead.x < 0 || newHead.x >= gridWidth || newHead.y < 0 || newHead.y >= gridHeight) {
+                //Game over when the snake hits the wall or itself, or fills the board
+                if (game.gameOver != 0) {
                     cout << "Game Over!" << endl;
+                    if (mctsMoves > 0) {
+                        cout << "MCTS: " << lround(mctsPlayouts / mctsSeconds) << " playouts/s on " << searchThreads.size()
+                             << " threads, " << mctsNodes / mctsMoves << " tree nodes per move" << endl;
+                    }
+                    BotChannelStats channelStats = botChannel.stats();
+                    if (channelStats.decisions > 0) {
+                        cout << "Bot process: " << channelStats.totalUs / channelStats.decisions << " us mean round trip, "
+                             << channelStats.missed << " moves missed" << endl;
+                    }
                     window.close();
                 }
 
-                //Reset clock after moving the snake
-                clock.restart();
+                //Reset clock after moving the snake, unless the search already did at the start of the move
+                if (autopilotMode != 3 && autopilotMode != 5) {
+                    clock.restart();
+                }
             }
             
             
@@ -418,7 +752,8 @@ int main() {
 
             
             //Draw the snake
-            for (size_t i = 0; i < snakeBody.size(); ++i) {
+            int snakeLength = copyBody(game, snakeBody);
+            for (int i = 0; i < snakeLength; ++i) {
                 RectangleShape snakeSegment(Vector2f(tileSize, tileSize));
                 if (i == 0) {
                     snakeSegment.setFillColor(Color::White); //Make the head white
@@ -431,6 +766,8 @@ int main() {
 
 
             //Draw the fruits
+            fruitSprite.setPosition(game.fruitX * tileSize, game.fruitY * tileSize);
+            specialFruitSprite.setPosition(game.specialFruitX * tileSize, game.specialFruitY * tileSize);
             window.draw(fruitSprite);
             window.draw(specialFruitSprite);
 
@@ -442,7 +779,7 @@ int main() {
             }
 
             //Positions and prints current score
-            Text scoreText("Score: " + to_string(score), font, 20);
+            Text scoreText("Score: " + to_string(game.score), font, 20);
             scoreText.setFillColor(Color::White);
             scoreText.setPosition(10, 10);
             window.draw(scoreText);
@@ -453,12 +790,25 @@ int main() {
             highScoreText.setPosition(10, 40);
             window.draw(highScoreText);
 
+            //Warn when the head is shut in a space too small for the snake and cannot follow its tail out
+            uint32_t freeRows[gridHeight];
+            uint32_t reachedRows[gridHeight];
+            freeBoard(game, freeRows, true);
+            int room = reachableCount(freeRows, game.headCell, reachedRows) - 1;
+            bool tailReached = (reachedRows[cellY(game.tailCell)] >> cellX(game.tailCell)) & 1u;
+            if (game.gameOver == 0 && game.length > 2 && !tailReached && room < game.length) {
+                Text trappedText("Trapped!", font, 20);
+                trappedText.setFillColor(Color::Red);
+                trappedText.setPosition(10, 70);
+                window.draw(trappedText);
+            }
+
             window.display();
         }
 
-        if (score > highScore)
+        if (game.score > highScore)
         {
-            highScore = score;
+            highScore = game.score;
             saveHighScore(highScore); //Saves a new high score if player beats old one
         }
         
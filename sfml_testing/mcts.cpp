@@ -0,0 +1,251 @@
+//Monte Carlo tree search bot, see mcts.hpp.
+
+#include "mcts.hpp"
+
+#include "bitboard.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+using namespace std;
+
+const float explorationWeight = 0.5f; //How much UCT favours less-visited moves
+const float discountPerMove = 0.9f; //Points scored later count for less
+const float deathPenalty = 3.0f; //Value lost by dying straight away
+const int rolloutMoves = 20; //Moves played past the tree in each playout
+const int maxTreeDepth = 64; //Deepest path kept for backing up values
+
+/**
+ Returns the steady-clock time in nanoseconds
+ @return Nanoseconds since an arbitrary start
+ */
+static int64_t nowNs() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ Checks whether a move is legal and does not end the game straight away
+ @param state The game state
+ @param direction The direction to check
+ @return True if the head can move there
+ */
+static bool safeMove(const GameState &state, int direction) {
+    if (direction == oppositeDirection(state.direction)) {
+        return false;
+    }
+    int x = cellX(state.headCell) + moveDX[direction];
+    int y = cellY(state.headCell) + moveDY[direction];
+    if (x < 0 || x >= gridWidth || y < 0 || y >= gridHeight) {
+        return false;
+    }
+    bool grow = (x == state.fruitX && y == state.fruitY) || (x == state.specialFruitX && y == state.specialFruitY);
+    return !isOccupied(state, x, y) || (!grow && cellAt(x, y) == state.tailCell);
+}
+
+/**
+ Picks a playout move: usually a safe move toward the fruit, otherwise a random safe move
+ @param state The game state
+ @param rng The random number generator
+ @return The direction to move in
+ */
+static int rolloutMove(const GameState &state, uint64_t &rng) {
+    int safe[4];
+    int safeCount = 0;
+    int toward = -1;
+    int headX = cellX(state.headCell);
+    int headY = cellY(state.headCell);
+    int targetX = (state.specialFruitX >= 0) ? state.specialFruitX : state.fruitX;
+    int targetY = (state.specialFruitX >= 0) ? state.specialFruitY : state.fruitY;
+    int bestDistance = abs(headX - targetX) + abs(headY - targetY);
+    for (int direction = 0; direction < 4; ++direction) {
+        if (!safeMove(state, direction)) {
+            continue;
+        }
+        safe[safeCount++] = direction;
+        int distance = abs(headX + moveDX[direction] - targetX) + abs(headY + moveDY[direction] - targetY);
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            toward = direction;
+        }
+    }
+    if (safeCount == 0) {
+        return state.direction; //Trapped, any move ends the game
+    }
+    uint64_t random = nextRandom(rng);
+    if (toward >= 0 && (random & 7) != 0) {
+        return toward;
+    }
+    return safe[(random >> 8) % safeCount];
+}
+
+/**
+ Checks whether a move shuts the head in a space smaller than the snake that the tail cannot be followed out of
+ @param state The game state
+ @param direction A safe move
+ @return True if the move leads into a trap
+ */
+static bool leadsIntoTrap(const GameState &state, int direction) {
+    GameState next = state;
+    int x = cellX(state.headCell) + moveDX[direction];
+    int y = cellY(state.headCell) + moveDY[direction];
+    bool grow = (x == state.fruitX && y == state.fruitY) || (x == state.specialFruitX && y == state.specialFruitY);
+    moveSnake(next, direction, grow);
+    uint32_t freeRows[gridHeight];
+    uint32_t reached[gridHeight];
+    freeBoard(next, freeRows, true);
+    int room = reachableCount(freeRows, next.headCell, reached) - 1;
+    bool tailReached = (reached[cellY(next.tailCell)] >> cellX(next.tailCell)) & 1u;
+    return !tailReached && room < next.length;
+}
+
+MctsBot::MctsBot(ThreadPool &pool, int arenaNodes, uint64_t seed) : pool(pool), arena(arenaNodes), arenaUsed(1), seed(seed) {
+    decisionNumber = 0;
+    stats = {0, 0, 0.0, pool.size()};
+}
+
+MctsStats MctsBot::lastStats() const {
+    return stats;
+}
+
+uint32_t MctsBot::allocateNodes(int count) {
+    uint32_t first = arenaUsed.fetch_add((uint32_t) count, memory_order_relaxed);
+    if (first + count > arena.size()) {
+        return 0; //Full: the tree stops growing but playouts carry on
+    }
+    return first;
+}
+
+long MctsBot::searchTree(uint32_t root, const GameState &state, int moveMs, int64_t deadlineNs, uint64_t &rng) {
+    uint32_t path[maxTreeDepth + 1];
+    long playouts = 0;
+    while ((playouts & 15) != 0 || nowNs() < deadlineNs) {
+        //Play on a copy with its own fruit placements
+        GameState sim = state;
+        sim.rng = nextRandom(rng);
+        float value = 0.0f;
+        float discount = 1.0f;
+        int depth = 0;
+        path[depth++] = root;
+        uint32_t node = root;
+
+        while (sim.gameOver == 0) {
+            MctsNode &current = arena[node];
+            if (current.firstChild == 0) {
+                //Expand a leaf the first time it is reached again, or straight away at the root
+                if (current.visits == 0 && node != root) {
+                    break;
+                }
+                //Only moves that do not end the game straight away become children.
+                //Moves into a space too small for the snake are marked so they are only tried as a last resort.
+                int moves[4];
+                bool trapped[4];
+                int moveCount = 0;
+                for (int direction = 0; direction < 4; ++direction) {
+                    if (safeMove(sim, direction)) {
+                        trapped[moveCount] = leadsIntoTrap(sim, direction);
+                        moves[moveCount++] = direction;
+                    }
+                }
+                if (moveCount == 0) {
+                    break; //Every move loses, the playout will find out
+                }
+                uint32_t first = allocateNodes(moveCount);
+                if (first == 0) {
+                    break;
+                }
+                for (int i = 0; i < moveCount; ++i) {
+                    arena[first + i] = {0, 0, 0.0f, 0, (uint8_t) moves[i], (uint8_t) trapped[i]};
+                }
+                current.childCount = (uint8_t) moveCount;
+                current.firstChild = first;
+            }
+
+            //Pick the child with the best upper confidence bound, trying unvisited moves first
+            uint32_t best = current.firstChild;
+            float bestScore = -1.0f;
+            float logVisits = logf((float) current.visits + 1.0f);
+            for (uint32_t child = current.firstChild; child < current.firstChild + current.childCount; ++child) {
+                const MctsNode &option = arena[child];
+                float score = (option.visits == 0) ? 1e9f - (float) (nextRandom(rng) & 1023) :
+                    option.totalValue / option.visits + explorationWeight * sqrtf(logVisits / option.visits);
+                if (option.trapped) {
+                    score -= 2e9f;
+                }
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = child;
+                }
+            }
+
+            int scoreBefore = sim.score;
+            stepGame(sim, arena[best].move, moveMs);
+            value += (sim.score - scoreBefore) * discount;
+            discount *= discountPerMove;
+            node = best;
+            if (depth <= maxTreeDepth) {
+                path[depth++] = node;
+            }
+        }
+
+        //Finish the playout with the cheap rollout policy
+        for (int i = 0; i < rolloutMoves && sim.gameOver == 0; ++i) {
+            int scoreBefore = sim.score;
+            stepGame(sim, rolloutMove(sim, rng), moveMs);
+            value += (sim.score - scoreBefore) * discount;
+            discount *= discountPerMove;
+        }
+
+        //Discounted points, less a penalty for dying that shrinks the later it happens
+        bool died = (sim.gameOver & (StepHitWall | StepHitSelf)) != 0;
+        float result = value - (died ? deathPenalty * discount : 0.0f);
+        for (int i = 0; i < depth; ++i) {
+            arena[path[i]].visits++;
+            arena[path[i]].totalValue += result;
+        }
+        playouts++;
+    }
+    return playouts;
+}
+
+int MctsBot::decide(const GameState &state, int budgetMs, int moveMs) {
+    int64_t start = nowNs();
+    int64_t deadline = start + (int64_t) budgetMs * 1000000;
+    int trees = pool.size();
+    arenaUsed.store(1, memory_order_relaxed);
+    decisionNumber++;
+
+    vector<uint32_t> roots(trees);
+    vector<long> playouts(trees);
+    for (int i = 0; i < trees; ++i) {
+        roots[i] = allocateNodes(1);
+        arena[roots[i]] = {0, 0, 0.0f, 0, (uint8_t) state.direction, 0};
+    }
+    pool.parallelFor(trees, [&](int tree, int) {
+        uint64_t rng = seed ^ (decisionNumber * 0x9E3779B97F4A7C15ull) ^ ((uint64_t) tree << 32);
+        playouts[tree] = searchTree(roots[tree], state, moveMs, deadline, rng);
+    });
+
+    //Add up the visits to each first move over all the trees
+    long visits[4] = {0, 0, 0, 0};
+    for (int i = 0; i < trees; ++i) {
+        const MctsNode &root = arena[roots[i]];
+        for (uint32_t child = root.firstChild; child < root.firstChild + root.childCount; ++child) {
+            visits[arena[child].move] += arena[child].visits + (arena[child].trapped ? 0 : 1);
+        }
+    }
+    int bestDirection = state.direction;
+    for (int direction = 0; direction < 4; ++direction) {
+        if (visits[direction] > visits[bestDirection]) {
+            bestDirection = direction;
+        }
+    }
+
+    stats.playouts = 0;
+    for (long count : playouts) {
+        stats.playouts += count;
+    }
+    stats.treeNodes = min((long) arenaUsed.load(), (long) arena.size()) - 1;
+    stats.seconds = (nowNs() - start) / 1e9;
+    stats.threads = trees;
+    return bestDirection;
+}
@@ -0,0 +1,90 @@
+//Monte Carlo tree search bot. Every thread of a ThreadPool grows its own search
+//tree from the current state (root parallelism) for a fixed time budget, and the
+//move with the most visits summed over all trees is played. Nodes for all trees
+//come from one shared arena that threads claim blocks from with an atomic add.
+//
+//Fruit placement and the special fruit moving every 3 seconds are random, so each
+//iteration plays on a copy of the state with a freshly seeded generator. Tree nodes
+//stand for move sequences rather than exact states ("open loop" search), which
+//averages the value of each move over where the fruits may appear.
+
+#ifndef MCTS_HPP
+#define MCTS_HPP
+
+#include "game_state.hpp"
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <vector>
+
+//Search numbers from the last decision
+struct MctsStats {
+    long playouts; //Iterations run by all threads together
+    long treeNodes; //Nodes allocated in the shared arena
+    double seconds; //Time spent searching
+    int threads; //Number of trees searched in parallel
+};
+
+//One node of a search tree. Its children sit next to each other in the arena.
+struct MctsNode {
+    uint32_t firstChild; //Arena index of the first child, 0 if not expanded yet
+    uint32_t visits;
+    float totalValue; //Sum of the playout values that passed through this node
+    uint8_t childCount;
+    uint8_t move; //Direction played to reach this node
+    uint8_t trapped; //1 if the move shuts the head in a space too small for the snake
+};
+
+class MctsBot {
+public:
+    /**
+     Creates the bot and allocates its node arena
+     @param pool The threads to search with, one tree per thread
+     @param arenaNodes Number of nodes the shared arena holds
+     @param seed Seed for the random fruit placements the search samples
+     */
+    MctsBot(ThreadPool &pool, int arenaNodes = 1 << 20, uint64_t seed = 1);
+
+    /**
+     Chooses the direction for the next move
+     @param state The current game state
+     @param budgetMs How long to search for
+     @param moveMs Game time per move, used to move the special fruit in playouts
+     @return The direction constant to pass to stepGame
+     */
+    int decide(const GameState &state, int budgetMs, int moveMs);
+
+    /**
+     Returns the numbers from the last decision
+     @return Playouts, tree size, time and thread count
+     */
+    MctsStats lastStats() const;
+
+private:
+    /**
+     Claims consecutive nodes from the shared arena without locking
+     @param count Number of nodes needed
+     @return The index of the first node, or 0 if the arena is full
+     */
+    uint32_t allocateNodes(int count);
+
+    /**
+     Grows one tree until the deadline
+     @param root The arena index of this tree's root
+     @param state The state at the root
+     @param moveMs Game time per move
+     @param deadlineNs Steady-clock time to stop at, in nanoseconds
+     @param rng This thread's random number generator
+     @return The number of playouts run
+     */
+    long searchTree(uint32_t root, const GameState &state, int moveMs, int64_t deadlineNs, uint64_t &rng);
+
+    ThreadPool &pool;
+    std::vector<MctsNode> arena;
+    std::atomic<uint32_t> arenaUsed; //Index of the next free node; node 0 is never handed out
+    uint64_t seed;
+    uint64_t decisionNumber;
+    MctsStats stats;
+};
+
+#endif
@@ -0,0 +1,70 @@
+//Lock-free queue with any number of producers and one consumer (Vyukov's intrusive
+//MPSC queue). A push is one atomic exchange and never waits for other producers or the
+//consumer. Nodes are owned by the caller: a node pushed belongs to the queue until
+//pop() hands it back. The node type needs a `std::atomic<Node *> next` member.
+
+#ifndef MPSC_QUEUE_HPP
+#define MPSC_QUEUE_HPP
+
+#include <atomic>
+
+template <class Node>
+class MpscQueue {
+public:
+    MpscQueue() : head(&stub), tail(&stub) {
+        stub.next.store(nullptr, std::memory_order_relaxed);
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    /**
+     Adds a node at the back; safe from any thread
+     @param node The node
+     */
+    void push(Node *node) {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node *previous = head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    /**
+     Takes the node at the front; only the consumer thread may call this
+     @return The node, or null if the queue is empty or a push is half done
+     */
+    Node *pop() {
+        Node *first = tail;
+        Node *next = first->next.load(std::memory_order_acquire);
+        if (first == &stub) {
+            //Skip the stub, which only keeps the list from ever being empty
+            if (!next) {
+                return nullptr;
+            }
+            tail = next;
+            first = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next) {
+            tail = next;
+            return first;
+        }
+        if (first != head.load(std::memory_order_acquire)) {
+            return nullptr; //A producer has taken the head but not linked it yet
+        }
+        //`first` is the last node: put the stub behind it so it can be handed out
+        push(&stub);
+        next = first->next.load(std::memory_order_acquire);
+        if (next) {
+            tail = next;
+            return first;
+        }
+        return nullptr;
+    }
+
+private:
+    std::atomic<Node *> head; //Last node pushed
+    Node *tail; //Next node to pop, only touched by the consumer
+    Node stub;
+};
+
+#endif
@@ -0,0 +1,327 @@
+//Rules for several snakes on one board, see multi_game.hpp.
+
+#include "multi_game.hpp"
+
+#include <algorithm>
+#include <cassert>
+using namespace std;
+
+const int initialRing = 16; //Body ring size of a new snake, doubled as it grows
+
+MultiGame::MultiGame(int width, int height, int snakeTotal, int fruitTotal, uint64_t seed) {
+    boardWidth = width;
+    boardHeight = height;
+    rng = seed;
+    tickCount = 0;
+    emptyCells = width * height;
+    alive = 0;
+    respawnFruit = true;
+    owner.assign((size_t) width * height, 0);
+    claims.assign((size_t) width * height, 0);
+    snakeTotal = max(1, min(snakeTotal, maxMultiSnakes));
+    snakes.resize(snakeTotal);
+    targets.assign(snakeTotal, -1);
+    growing.assign(snakeTotal, 0);
+
+    //Pairs of snakes face each other across the board, one pair per row band
+    int pairs = (snakeTotal + 1) / 2;
+    for (int i = 0; i < snakeTotal; ++i) {
+        MultiSnake &snake = snakes[i];
+        snake.body.assign(initialRing, 0);
+        snake.tailIndex = 0;
+        snake.length = 0;
+        snake.alive = 0;
+        snake.score = 0;
+        int x = (i % 2 == 0) ? width / 4 : width - 1 - width / 4;
+        int y = (i / 2 + 1) * height / (pairs + 1);
+        int cell = y * width + x;
+        if (owner[cell] != 0) {
+            spawnSnake(i); //Too many snakes for the layout
+            continue;
+        }
+        snake.direction = (i % 2 == 0) ? Right : Left;
+        pushHead(snake, cell);
+        emptyCells--;
+        snake.alive = 1;
+        alive++;
+    }
+
+    for (int i = 0; i < fruitTotal; ++i) {
+        int cell = pickEmptyCell();
+        if (cell >= 0) {
+            owner[cell] = fruitOwner;
+            emptyCells--;
+            fruits.push_back((uint16_t) cell);
+        }
+    }
+#ifdef DEBUG
+    assert(emptyCells == countEmptyCells()); //The running count must match the board
+#endif
+}
+
+int MultiGame::step(const uint8_t directions[], uint8_t events[]) {
+    int count = (int) snakes.size();
+    tickCount++;
+
+    //Where every head goes, and whether it eats
+    for (int i = 0; i < count; ++i) {
+        MultiSnake &snake = snakes[i];
+        events[i] = 0;
+        targets[i] = -1;
+        growing[i] = 0;
+        if (!snake.alive) {
+            continue;
+        }
+        int direction = directions[i];
+        if (direction > Right || direction == oppositeDirection(snake.direction)) {
+            direction = snake.direction; //Cannot go in the opposite direction
+        }
+        snake.direction = (uint8_t) direction;
+        int x = snake.headCell() % boardWidth + moveDX[direction];
+        int y = snake.headCell() / boardWidth + moveDY[direction];
+        if (x < 0 || x >= boardWidth || y < 0 || y >= boardHeight) {
+            events[i] = StepHitWall;
+            continue;
+        }
+        targets[i] = y * boardWidth + x;
+        growing[i] = (owner[targets[i]] == fruitOwner);
+    }
+
+    //Head-to-head: the first head to claim a cell marks it, any later one collides with it.
+    //Only the claimed cells are cleared again, so this stays O(K).
+    for (int i = 0; i < count; ++i) {
+        if (targets[i] < 0) {
+            continue;
+        }
+        uint8_t &claim = claims[targets[i]];
+        if (claim == 0) {
+            claim = (uint8_t) (i + 1);
+        } else {
+            events[i] |= StepHeadOn;
+            events[claim - 1] |= StepHeadOn;
+        }
+    }
+    for (int i = 0; i < count; ++i) {
+        if (targets[i] >= 0) {
+            claims[targets[i]] = 0;
+        }
+    }
+
+    //Swaps and bodies, looked up in the owner grid as it was before the move
+    for (int i = 0; i < count; ++i) {
+        int target = targets[i];
+        if (target < 0 || owner[target] == 0 || owner[target] == fruitOwner) {
+            continue;
+        }
+        int other = owner[target] - 1;
+        const MultiSnake &otherSnake = snakes[other];
+        if (other != i && target == otherSnake.headCell() && targets[other] == snakes[i].headCell()) {
+            events[i] |= StepHeadOn;
+            events[other] |= StepHeadOn;
+        } else if (target != otherSnake.tailCell() || growing[other]) {
+            events[i] |= (other == i) ? StepHitSelf : StepHitSnake; //Only a tail that moves away is safe
+        }
+    }
+
+    //Take the dead off the board, then move the rest: tails first, so a head can
+    //follow into a tail cell left this tick, then heads
+    const int deadly = StepHitWall | StepHitSelf | StepHitSnake | StepHeadOn;
+    for (int i = 0; i < count; ++i) {
+        if (snakes[i].alive && (events[i] & deadly)) {
+            removeSnake(i);
+        }
+    }
+    for (int i = 0; i < count; ++i) {
+        MultiSnake &snake = snakes[i];
+        if (snake.alive && !growing[i]) {
+            owner[snake.tailCell()] = 0;
+            snake.tailIndex = (snake.tailIndex + 1) & (uint32_t) (snake.body.size() - 1);
+            snake.length--;
+            emptyCells++;
+        }
+    }
+    int eaten = 0;
+    for (int i = 0; i < count; ++i) {
+        MultiSnake &snake = snakes[i];
+        if (!snake.alive) {
+            continue;
+        }
+        if (growing[i]) {
+            fruits.erase(find(fruits.begin(), fruits.end(), (uint16_t) targets[i]));
+            snake.score++;
+            events[i] |= StepAteFruit;
+            eaten++;
+        } else {
+            emptyCells--;
+        }
+        pushHead(snake, targets[i]);
+    }
+
+    //New fruit for each one eaten, placed in snake order
+    for (int i = 0; respawnFruit && i < eaten; ++i) {
+        int cell = pickEmptyCell();
+        if (cell >= 0) {
+            owner[cell] = fruitOwner;
+            emptyCells--;
+            fruits.push_back((uint16_t) cell);
+        }
+    }
+#ifdef DEBUG
+    assert(emptyCells == countEmptyCells()); //The running count must match the board
+#endif
+    return alive;
+}
+
+void MultiGame::removeSnake(int index) {
+    MultiSnake &snake = snakes[index];
+    for (int i = 0; i < snake.length; ++i) {
+        owner[snake.cellAt(i)] = 0;
+    }
+    emptyCells += snake.length;
+    snake.length = 0;
+    if (snake.alive) {
+        snake.alive = 0;
+        alive--;
+    }
+}
+
+bool MultiGame::spawnSnake(int index) {
+    removeSnake(index);
+    int cell = pickEmptyCell();
+    if (cell < 0) {
+        return false;
+    }
+    MultiSnake &snake = snakes[index];
+    snake.tailIndex = 0;
+    snake.score = 0;
+    snake.direction = (cell % boardWidth < boardWidth / 2) ? Right : Left; //Toward the far side
+    pushHead(snake, cell);
+    emptyCells--;
+    snake.alive = 1;
+    alive++;
+    return true;
+}
+
+void MultiGame::clearBoard(uint32_t tick) {
+    for (int i = 0; i < (int) snakes.size(); ++i) {
+        removeSnake(i);
+        snakes[i].score = 0;
+    }
+    for (uint16_t fruit : fruits) {
+        owner[fruit] = 0;
+    }
+    emptyCells += (int) fruits.size();
+    fruits.clear();
+    tickCount = tick;
+}
+
+void MultiGame::placeSnake(int index, const vector<int> &cells, int direction, int score) {
+    MultiSnake &snake = snakes[index];
+    removeSnake(index);
+    snake.tailIndex = 0;
+    snake.direction = (uint8_t) direction;
+    snake.score = score;
+    if (cells.empty()) {
+        return;
+    }
+    for (int cell : cells) {
+        pushHead(snake, cell);
+    }
+    emptyCells -= (int) cells.size();
+    snake.alive = 1;
+    alive++;
+}
+
+void MultiGame::placeFruit(int cell) {
+    owner[cell] = fruitOwner;
+    emptyCells--;
+    fruits.push_back((uint16_t) cell);
+}
+
+void MultiGame::setFruitRespawn(bool respawn) {
+    respawnFruit = respawn;
+}
+
+int MultiGame::pickEmptyCell() {
+    if (emptyCells <= 0) {
+        return -1;
+    }
+    //Choose the n-th empty cell so each placement uses exactly one random number
+    int n = (int) (((nextRandom(rng) >> 32) * (uint64_t) emptyCells) >> 32);
+    for (int cell = 0; cell < (int) owner.size(); ++cell) {
+        if (owner[cell] == 0 && n-- == 0) {
+            return cell;
+        }
+    }
+    return -1;
+}
+
+int MultiGame::countEmptyCells() const {
+    return (int) count(owner.begin(), owner.end(), 0);
+}
+
+void MultiGame::pushHead(MultiSnake &snake, int cell) {
+    if (snake.length == snake.body.size()) {
+        //Lay the ring out again from the tail at twice the size
+        vector<uint16_t> grown(snake.body.size() * 2);
+        for (int i = 0; i < snake.length; ++i) {
+            grown[i] = (uint16_t) snake.cellAt(i);
+        }
+        snake.body.swap(grown);
+        snake.tailIndex = 0;
+    }
+    snake.body[(snake.tailIndex + snake.length) & (snake.body.size() - 1)] = (uint16_t) cell;
+    snake.length++;
+    owner[cell] = (uint8_t) (&snake - snakes.data() + 1);
+}
+
+int MultiGame::width() const {
+    return boardWidth;
+}
+
+int MultiGame::height() const {
+    return boardHeight;
+}
+
+int MultiGame::snakeCount() const {
+    return (int) snakes.size();
+}
+
+int MultiGame::aliveCount() const {
+    return alive;
+}
+
+uint32_t MultiGame::tick() const {
+    return tickCount;
+}
+
+const MultiSnake &MultiGame::snake(int index) const {
+    return snakes[index];
+}
+
+const vector<uint16_t> &MultiGame::fruitCells() const {
+    return fruits;
+}
+
+uint64_t MultiGame::stateHash() const {
+    //FNV-1a over the numbers that make up the state
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    auto mix = [&hash](uint64_t value) {
+        hash = (hash ^ value) * 0x100000001B3ULL;
+    };
+    mix(tickCount);
+    mix(rng);
+    for (const MultiSnake &snake : snakes) {
+        mix(snake.alive);
+        mix(snake.direction);
+        mix((uint32_t) snake.score);
+        mix(snake.length);
+        for (int i = 0; i < snake.length; ++i) {
+            mix(snake.cellAt(i));
+        }
+    }
+    for (uint16_t fruit : fruits) {
+        mix(fruit);
+    }
+    return hash;
+}
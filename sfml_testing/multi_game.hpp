@@ -0,0 +1,186 @@
+//Rules for several snakes on one board. The board is an owner grid with one byte per
+//cell: 0 for empty, the snake's id (its number + 1) for a body cell, or fruitOwner.
+//Every question a move asks ("is this cell free, and whose is it?") is one lookup,
+//so a tick costs O(K) for K snakes however long they are; only a snake that dies
+//pays for clearing its body.
+//
+//All snakes move at once. Conflicts within a tick are resolved the same way every time:
+//  - heads entering the same cell all die (head-to-head)
+//  - two snakes moving into each other's head cell both die (swap)
+//  - a head entering any body cell dies (head-to-body), except a tail that moves away
+//    this tick because its snake does not grow
+//Snakes that die are taken off the board at the end of the tick.
+
+#ifndef MULTI_GAME_HPP
+#define MULTI_GAME_HPP
+
+#include "game_state.hpp"
+
+#include <vector>
+
+const int maxMultiSnakes = 64;
+const uint8_t fruitOwner = 255; //Owner grid value of a fruit cell
+
+//Extra flags stepped snakes can get, next to StepAteFruit, StepHitWall and StepHitSelf
+const int StepHitSnake = 64; //Ran into another snake's body
+const int StepHeadOn = 128; //Met another snake's head, in the same cell or by swapping cells
+
+//One snake: a ring of body cells from the tail to the head
+struct MultiSnake {
+    std::vector<uint16_t> body; //Ring buffer of cell indices, its size a power of two
+    uint32_t tailIndex; //Position of the tail in `body`
+    uint16_t length; //0 when the snake is not on the board
+    uint8_t direction; //Direction of the last move
+    uint8_t alive;
+    int32_t score;
+
+    /**
+     Returns the cell of the head
+     @return The cell index
+     */
+    int headCell() const {
+        return body[(tailIndex + length - 1) & (body.size() - 1)];
+    }
+
+    /**
+     Returns the cell of the tail
+     @return The cell index
+     */
+    int tailCell() const {
+        return body[tailIndex];
+    }
+
+    /**
+     Returns one of the body cells
+     @param index The segment number, 0 being the tail
+     @return The cell index
+     */
+    int cellAt(int index) const {
+        return body[(tailIndex + index) & (body.size() - 1)];
+    }
+};
+
+class MultiGame {
+public:
+    /**
+     Starts a game with every snake one segment long, spread over the board
+     @param width Number of tiles in width
+     @param height Number of tiles in height
+     @param snakes Number of snakes, 1 to maxMultiSnakes
+     @param fruits Number of fruits kept on the board
+     @param seed The seed for fruit placement
+     */
+    MultiGame(int width, int height, int snakes, int fruits, uint64_t seed);
+
+    /**
+     Moves every living snake one tile and resolves the collisions
+     @param directions One direction constant per snake; reverse moves are ignored
+     @param events Receives the Step flags of every snake, 0 for a plain move or a dead snake
+     @return Number of snakes still alive
+     */
+    int step(const uint8_t directions[], uint8_t events[]);
+
+    /**
+     Takes a snake off the board (a player leaving)
+     @param snake The snake number
+     */
+    void removeSnake(int snake);
+
+    /**
+     Puts a dead snake back on a random free cell with one segment and no score
+     @param snake The snake number
+     @return False if the board has no free cell
+     */
+    bool spawnSnake(int snake);
+
+    /**
+     Empties the board, to be filled with placeSnake and placeFruit; used by clients
+     taking over a state the server sent
+     @param tick The tick the state belongs to
+     */
+    void clearBoard(uint32_t tick);
+
+    /**
+     Puts a snake on cells that must be empty
+     @param snake The snake number
+     @param cells Its cells from the tail to the head
+     @param direction Direction of its last move
+     @param score Its score
+     */
+    void placeSnake(int snake, const std::vector<int> &cells, int direction, int score);
+
+    /**
+     Puts a fruit on an empty cell
+     @param cell The cell index
+     */
+    void placeFruit(int cell);
+
+    /**
+     Sets whether eaten fruit is replaced. Clients predicting a server's room turn this
+     off: only the server knows where new fruit goes, and a guess would put fruit where
+     there is none for the predicted snakes to eat.
+     @param respawn False to leave eaten fruit unreplaced
+     */
+    void setFruitRespawn(bool respawn);
+
+    /**
+     Hashes the snakes, scores, fruit and fruit generator, to compare runs
+     @return The hash
+     */
+    uint64_t stateHash() const;
+
+    /**
+     Returns who holds a cell
+     @param cell The cell index
+     @return 0 for empty, snake number + 1, or fruitOwner
+     */
+    int ownerAt(int cell) const {
+        return owner[cell];
+    }
+
+    int width() const;
+    int height() const;
+    int snakeCount() const;
+    int aliveCount() const;
+    uint32_t tick() const;
+    const MultiSnake &snake(int index) const;
+    const std::vector<uint16_t> &fruitCells() const;
+
+private:
+    /**
+     Returns a random empty cell, drawing one random number
+     @return The cell index, or -1 if there is none
+     */
+    int pickEmptyCell();
+
+    /**
+     Counts the empty cells from scratch, to check emptyCells against
+     @return The number of cells holding neither a snake nor a fruit
+     */
+    int countEmptyCells() const;
+
+    /**
+     Adds a cell in front of a snake's head, growing the ring if it is full
+     @param snake The snake
+     @param cell The new head cell
+     */
+    void pushHead(MultiSnake &snake, int cell);
+
+    int boardWidth;
+    int boardHeight;
+    uint64_t rng;
+    uint32_t tickCount;
+    int emptyCells; //Cells holding neither a snake nor a fruit
+    int alive;
+    bool respawnFruit; //False in client copies, where eaten fruit stays gone
+    std::vector<uint8_t> owner; //One owner byte per cell
+    std::vector<uint8_t> claims; //Snake id heading for each cell this tick, all 0 between ticks
+    std::vector<MultiSnake> snakes;
+    std::vector<uint16_t> fruits;
+
+    //Per-step scratch, one entry per snake
+    std::vector<int> targets; //Cell each head moves into, -1 off the board
+    std::vector<uint8_t> growing;
+};
+
+#endif
@@ -0,0 +1,429 @@
+//Network messages, see net_protocol.hpp.
+
+#include "net_protocol.hpp"
+
+using namespace std;
+
+/**
+ Returns the direction of a step between two neighbouring cells
+ @param from The first cell
+ @param to The next cell
+ @param width The board width
+ @return The direction constant
+ */
+static int stepDirection(int from, int to, int width) {
+    if (to == from - width) {
+        return Up;
+    }
+    if (to == from + width) {
+        return Down;
+    }
+    return (to == from - 1) ? Left : Right;
+}
+
+/**
+ Returns one of a snake's 2-bit moves
+ @param moves The packed moves, four per byte
+ @param index The move number, 0 leaving the tail
+ @return The direction constant
+ */
+static int moveAt(const vector<uint8_t> &moves, uint32_t index) {
+    return (moves[index >> 2] >> ((index & 3) * 2)) & 3;
+}
+
+/**
+ Sets one of a snake's 2-bit moves, which must still be 0
+ @param moves The packed moves, four per byte
+ @param index The move number
+ @param direction The direction constant
+ */
+static void setMoveAt(vector<uint8_t> &moves, uint32_t index, int direction) {
+    moves[index >> 2] |= (uint8_t) (direction << ((index & 3) * 2));
+}
+
+/**
+ Returns the number of bits needed to write a number
+ @param value The largest value to write
+ @return The bit count, 0 for 0
+ */
+static int bitLength(uint32_t value) {
+    int bits = 0;
+    while (value >> bits) {
+        bits++;
+    }
+    return bits;
+}
+
+//Packs fields of any bit width, lowest bit first
+struct BitWriter {
+    vector<uint8_t> bytes;
+    int used = 8; //Bits used in the last byte
+
+    void write(uint32_t value, int bits) {
+        for (int i = 0; i < bits; ++i) {
+            if (used == 8) {
+                bytes.push_back(0);
+                used = 0;
+            }
+            bytes.back() |= (uint8_t) (((value >> i) & 1) << used);
+            used++;
+        }
+    }
+
+    //Exponential-Golomb code: small counts take few bits (0 takes one)
+    void writeCount(uint32_t value) {
+        uint64_t coded = (uint64_t) value + 1;
+        int length = 0;
+        while (coded >> (length + 1)) {
+            length++;
+        }
+        write(0, length);
+        for (int i = length; i >= 0; --i) {
+            write((uint32_t) (coded >> i) & 1, 1);
+        }
+    }
+};
+
+//Reads what BitWriter wrote; reading past the end sets `failed` and returns zeros
+struct BitReader {
+    const uint8_t *data;
+    size_t size;
+    size_t position = 0; //In bits
+    bool failed = false;
+
+    BitReader(const uint8_t *data, size_t size) : data(data), size(size) {}
+
+    uint32_t read(int bits) {
+        uint32_t value = 0;
+        for (int i = 0; i < bits; ++i) {
+            if (position >= size * 8) {
+                failed = true;
+                return 0;
+            }
+            value |= (uint32_t) ((data[position >> 3] >> (position & 7)) & 1) << i;
+            position++;
+        }
+        return value;
+    }
+
+    uint32_t readCount() {
+        int length = 0;
+        while (!failed && read(1) == 0) {
+            if (++length > 32) {
+                failed = true;
+            }
+        }
+        if (failed) {
+            return 0;
+        }
+        uint64_t coded = 1;
+        for (int i = 0; i < length; ++i) {
+            coded = (coded << 1) | read(1);
+        }
+        return (uint32_t) (coded - 1);
+    }
+};
+
+void captureSnapshot(const MultiGame &game, const uint8_t joined[], const uint32_t inputSequences[], const uint16_t lives[], RoomSnapshot &snapshot) {
+    snapshot.tick = game.tick();
+    snapshot.width = (uint16_t) game.width();
+    snapshot.height = (uint16_t) game.height();
+    snapshot.fruits = game.fruitCells();
+    snapshot.snakes.clear();
+    for (int player = 0; player < game.snakeCount(); ++player) {
+        if (!joined[player]) {
+            continue;
+        }
+        const MultiSnake &snake = game.snake(player);
+        SnapshotSnake entry;
+        entry.player = (uint8_t) player;
+        entry.life = lives[player];
+        entry.alive = snake.alive;
+        entry.direction = snake.direction;
+        entry.score = snake.score;
+        entry.inputSequence = inputSequences[player];
+        entry.length = snake.length;
+        entry.tailCell = (snake.length > 0) ? (uint16_t) snake.tailCell() : 0;
+        entry.moves.assign((max(snake.length - 1, 0) + 3) / 4, 0);
+        for (int i = 0; i + 1 < snake.length; ++i) {
+            setMoveAt(entry.moves, i, stepDirection(snake.cellAt(i), snake.cellAt(i + 1), game.width()));
+        }
+        snapshot.snakes.push_back(move(entry));
+    }
+}
+
+void writeSnapshot(sf::Packet &packet, const RoomSnapshot &snapshot, const RoomSnapshot *baseline) {
+    static const RoomSnapshot emptyRoom;
+    const RoomSnapshot &base = baseline ? *baseline : emptyRoom;
+    uint32_t ticks = snapshot.tick - base.tick; //Ticks every surviving snake moved since the baseline
+    int cellBits = bitLength((uint32_t) snapshot.width * snapshot.height - 1);
+    packet << MessageState << snapshot.tick << (baseline ? base.tick : snapshot.tick) << snapshot.width << snapshot.height;
+    BitWriter bits;
+
+    //Which slots are in the room, only when that changed
+    const SnapshotSnake *previous[roomPlayers] = {};
+    uint64_t baseMask = 0, mask = 0;
+    for (const SnapshotSnake &snake : base.snakes) {
+        previous[snake.player] = &snake;
+        baseMask |= 1ULL << snake.player;
+    }
+    for (const SnapshotSnake &snake : snapshot.snakes) {
+        mask |= 1ULL << snake.player;
+    }
+    bits.write(mask == baseMask, 1);
+    if (mask != baseMask) {
+        bits.write((uint32_t) mask, 32);
+        bits.write((uint32_t) (mask >> 32), 32);
+    }
+
+    //Fruits: the baseline's list with some taken out, then the new ones at the end
+    vector<uint32_t> removed;
+    size_t kept = 0;
+    for (size_t i = 0; i < base.fruits.size(); ++i) {
+        if (kept < snapshot.fruits.size() && snapshot.fruits[kept] == base.fruits[i]) {
+            kept++;
+        } else {
+            removed.push_back((uint32_t) i);
+        }
+    }
+    int indexBits = bitLength((uint32_t) max((int) base.fruits.size() - 1, 0));
+    bits.writeCount((uint32_t) removed.size());
+    for (uint32_t index : removed) {
+        bits.write(index, indexBits);
+    }
+    bits.writeCount((uint32_t) (snapshot.fruits.size() - kept));
+    for (size_t i = kept; i < snapshot.fruits.size(); ++i) {
+        bits.write(snapshot.fruits[i], cellBits);
+    }
+
+    for (const SnapshotSnake &snake : snapshot.snakes) {
+        //A snake in the same life that kept moving is sent as its new head moves and the
+        //tail trim; anything else is sent whole
+        const SnapshotSnake *old = previous[snake.player];
+        uint32_t trim = 0;
+        bool moved = old && old->life == snake.life && old->alive == snake.alive;
+        if (moved && snake.alive) {
+            trim = old->length + ticks - snake.length;
+            moved = old->length > 0 && trim <= ticks && trim <= old->length;
+        }
+        bits.write(moved, 1);
+        if (moved) {
+            if (snake.alive) {
+                bits.write(trim == ticks, 1); //No fruit eaten, the usual case
+                if (trim != ticks) {
+                    bits.writeCount(trim);
+                }
+                //When the whole old body is gone, the first new move leaves the old head
+                int first = snake.length - 1 - (int) ticks;
+                if (first < 0) {
+                    vector<int> oldCells;
+                    snapshotCells(*old, snapshot.width, oldCells);
+                    bits.write(stepDirection(oldCells.back(), snake.tailCell, snapshot.width), 2);
+                    first = 0;
+                }
+                for (int i = first; i + 1 < snake.length; ++i) {
+                    bits.write(moveAt(snake.moves, i), 2);
+                }
+            }
+            uint32_t inputs = snake.inputSequence - old->inputSequence;
+            bits.write(inputs == 0, 1);
+            if (inputs != 0) {
+                bits.writeCount(inputs - 1);
+            }
+        } else {
+            bits.writeCount(snake.life);
+            bits.write(snake.alive, 1);
+            bits.write(snake.direction, 2);
+            bits.writeCount((uint32_t) snake.score);
+            bits.write(snake.inputSequence, 32);
+            bits.writeCount(snake.length);
+            if (snake.length > 0) {
+                bits.write(snake.tailCell, cellBits);
+            }
+            for (int i = 0; i + 1 < snake.length; ++i) {
+                bits.write(moveAt(snake.moves, i), 2);
+            }
+        }
+    }
+    packet.append(bits.bytes.data(), bits.bytes.size());
+}
+
+/**
+ Checks that a snake's body stays on the board when walked from its tail
+ @param snake The snake
+ @param width Number of tiles in width
+ @param height Number of tiles in height
+ @return False if the tail or any move leaves the board
+ */
+static bool bodyOnBoard(const SnapshotSnake &snake, int width, int height) {
+    if (snake.length == 0) {
+        return true;
+    }
+    if (snake.tailCell >= width * height) {
+        return false;
+    }
+    int x = snake.tailCell % width;
+    int y = snake.tailCell / width;
+    for (int i = 0; i + 1 < snake.length; ++i) {
+        int direction = moveAt(snake.moves, i);
+        x += moveDX[direction];
+        y += moveDY[direction];
+        if (x < 0 || x >= width || y < 0 || y >= height) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool readSnapshot(sf::Packet &packet, const RoomSnapshot history[], RoomSnapshot &snapshot) {
+    static const RoomSnapshot emptyRoom;
+    uint32_t baseTick = 0;
+    packet >> snapshot.tick >> baseTick >> snapshot.width >> snapshot.height;
+    int cells = snapshot.width * snapshot.height;
+    if (!packet || cells == 0 || cells > 65536) {
+        return false;
+    }
+    const RoomSnapshot *baseline = &emptyRoom;
+    if (baseTick != snapshot.tick) {
+        baseline = &history[baseTick & (snapshotHistory - 1)];
+        if (baseline->tick != baseTick || baseline->width != snapshot.width || baseline->height != snapshot.height) {
+            return false; //Baseline already overwritten or never received
+        }
+    }
+    const RoomSnapshot &base = *baseline;
+    uint32_t ticks = snapshot.tick - base.tick;
+    int cellBits = bitLength((uint32_t) cells - 1);
+    BitReader bits(static_cast<const uint8_t *>(packet.getData()) + packet.getReadPosition(), packet.getDataSize() - packet.getReadPosition());
+
+    const SnapshotSnake *previous[roomPlayers] = {};
+    uint64_t mask = 0;
+    for (const SnapshotSnake &snake : base.snakes) {
+        previous[snake.player] = &snake;
+        mask |= 1ULL << snake.player;
+    }
+    if (!bits.read(1)) {
+        mask = bits.read(32);
+        mask |= (uint64_t) bits.read(32) << 32;
+    }
+
+    vector<uint8_t> gone(base.fruits.size(), 0);
+    int indexBits = bitLength((uint32_t) max((int) base.fruits.size() - 1, 0));
+    for (uint32_t count = bits.readCount(); count > 0 && !bits.failed; --count) {
+        uint32_t index = bits.read(indexBits);
+        if (index >= gone.size()) {
+            return false;
+        }
+        gone[index] = 1;
+    }
+    snapshot.fruits.clear();
+    for (size_t i = 0; i < base.fruits.size(); ++i) {
+        if (!gone[i]) {
+            snapshot.fruits.push_back(base.fruits[i]);
+        }
+    }
+    for (uint32_t count = bits.readCount(); count > 0 && !bits.failed; --count) {
+        uint32_t cell = bits.read(cellBits);
+        if (cell >= (uint32_t) cells) {
+            return false;
+        }
+        snapshot.fruits.push_back((uint16_t) cell);
+    }
+
+    snapshot.snakes.clear();
+    for (int player = 0; player < roomPlayers && !bits.failed; ++player) {
+        if (!(mask >> player & 1)) {
+            continue;
+        }
+        SnapshotSnake snake;
+        snake.player = (uint8_t) player;
+        const SnapshotSnake *old = previous[player];
+        if (bits.read(1)) {
+            if (!old) {
+                return false;
+            }
+            snake.life = old->life;
+            snake.alive = old->alive;
+            snake.direction = old->direction;
+            snake.score = old->score;
+            snake.length = old->length;
+            snake.tailCell = old->tailCell;
+            snake.moves = old->moves;
+            if (snake.alive) {
+                uint32_t trim = bits.read(1) ? ticks : bits.readCount();
+                //Checked before the path is allocated, so a bad tick cannot ask for gigabytes
+                if (old->length == 0 || ticks == 0 || ticks > (uint32_t) cells || trim > ticks || trim > old->length ||
+                    old->length - trim + ticks > (uint32_t) cells) {
+                    return false;
+                }
+                //The old moves and then the new ones lead from the old tail to the new head;
+                //the new body is all of it past the trimmed cells
+                uint32_t oldMoves = old->length - 1;
+                vector<uint8_t> path(oldMoves + ticks);
+                for (uint32_t i = 0; i < oldMoves; ++i) {
+                    path[i] = (uint8_t) moveAt(old->moves, i);
+                }
+                for (uint32_t i = oldMoves; i < path.size(); ++i) {
+                    path[i] = (uint8_t) bits.read(2);
+                }
+                int x = old->tailCell % snapshot.width;
+                int y = old->tailCell / snapshot.width;
+                for (uint32_t i = 0; i < trim; ++i) {
+                    x += moveDX[path[i]];
+                    y += moveDY[path[i]];
+                }
+                if (x < 0 || x >= snapshot.width || y < 0 || y >= snapshot.height) {
+                    return false;
+                }
+                snake.tailCell = (uint16_t) (y * snapshot.width + x);
+                snake.length = (uint16_t) (old->length - trim + ticks);
+                snake.score += (int32_t) (ticks - trim);
+                snake.direction = path.back();
+                snake.moves.assign((snake.length - 1 + 3) / 4, 0);
+                for (uint32_t i = trim; i < path.size(); ++i) {
+                    setMoveAt(snake.moves, i - trim, path[i]);
+                }
+            }
+            snake.inputSequence = old->inputSequence;
+            if (!bits.read(1)) {
+                snake.inputSequence += bits.readCount() + 1;
+            }
+        } else {
+            snake.life = (uint16_t) bits.readCount();
+            snake.alive = (uint8_t) bits.read(1);
+            snake.direction = (uint8_t) bits.read(2);
+            snake.score = (int32_t) bits.readCount();
+            snake.inputSequence = bits.read(32);
+            uint32_t length = bits.readCount();
+            if (length > (uint32_t) cells) {
+                return false;
+            }
+            snake.length = (uint16_t) length;
+            snake.tailCell = (length > 0) ? (uint16_t) bits.read(cellBits) : 0;
+            snake.moves.assign((max((int) length - 1, 0) + 3) / 4, 0);
+            for (uint32_t i = 0; i + 1 < length; ++i) {
+                setMoveAt(snake.moves, i, bits.read(2));
+            }
+        }
+        if (!bodyOnBoard(snake, snapshot.width, snapshot.height)) {
+            return false; //Players index their boards with these cells
+        }
+        snapshot.snakes.push_back(move(snake));
+    }
+    return !bits.failed;
+}
+
+void snapshotCells(const SnapshotSnake &snake, int width, vector<int> &cells) {
+    cells.clear();
+    if (snake.length == 0) {
+        return;
+    }
+    int x = snake.tailCell % width;
+    int y = snake.tailCell / width;
+    cells.push_back(snake.tailCell);
+    for (int i = 0; i + 1 < snake.length; ++i) {
+        int direction = moveAt(snake.moves, i);
+        x += moveDX[direction];
+        y += moveDY[direction];
+        cells.push_back(y * width + x);
+    }
+}
@@ -0,0 +1,107 @@
+//Messages between snake_server and its clients. Every message is one UDP datagram
+//built with sf::Packet (so numbers are in network byte order) and starts with a
+//message type byte. Clients send their direction with a sequence number; the server
+//keeps the newest one per player and broadcasts the room after every tick.
+//Nothing is resent: a lost input is covered by the next one, a lost state by the
+//next tick.
+//
+//States are deltas. Every input also acknowledges the newest state the client has,
+//and the server encodes the room against that tick: a snake that kept moving costs
+//its new head moves at 2 bits each, the tail trim and a few flag bits; its score and
+//direction follow from those. Fruits are sent as removals and additions. A client
+//with no acknowledged state still in the server's history gets a keyframe, which is
+//the same encoding against an empty room.
+//
+//An input names the tick it is meant for. A client predicting its own snake sends its
+//turns ahead of time, and the server holds them until that tick so both sides step the
+//same inputs; an input arriving too late is used on the next tick.
+//
+//Spectators connect over TCP instead (see spectator_relay.hpp) and get the same state
+//messages, sf::Packet framed, each against the state before it.
+#ifndef NET_PROTOCOL_HPP
+#define NET_PROTOCOL_HPP
+
+#include "multi_game.hpp"
+
+#include <SFML/Network/Packet.hpp>
+#include <vector>
+
+const unsigned short defaultServerPort = 47474;
+const unsigned short defaultSpectatorPort = 47475; //TCP
+const uint32_t protocolVersion = 4;
+const int roomPlayers = maxMultiSnakes; //Player slots per room
+const int defaultTickMs = 150; //Time per server tick, about the single-player speed
+const int clientTimeoutMs = 5000; //A player the server has not heard from for this long is dropped
+const int respawnTicks = 10; //Ticks a dead snake waits before coming back
+const int snapshotHistory = 32; //Past states both sides keep as delta baselines, a power of two
+const int pendingInputs = 8; //Inputs for future ticks the server holds per player
+
+//Message types, the first byte of every datagram
+const uint8_t MessageJoin = 1; //Client: protocol version, room number
+const uint8_t MessageInput = 2; //Client: player, input sequence, direction, newest state tick (0 for none), tick the input is for (0 for the next)
+const uint8_t MessageLeave = 3; //Client: player
+const uint8_t MessageWelcome = 4; //Server: player, board width and height, tick length
+const uint8_t MessageRoomFull = 5; //Server: no free player slot
+const uint8_t MessageState = 6; //Server: tick, baseline tick (the same for a keyframe), board size, bit stream
+const uint8_t MessagePing = 7; //Client: its clock in milliseconds
+const uint8_t MessagePong = 8; //Server: the ping's clock value, returned
+const uint8_t MessageWatch = 9; //Spectator, over TCP: protocol version, room number; answered with MessageState packets, each against the one before
+
+//One player's snake as clients see it
+struct SnapshotSnake {
+    uint8_t player; //Player slot, which is also the snake number in the server's MultiGame
+    uint16_t life; //Counts the snake's spawns, so a delta never joins two different lives
+    uint8_t alive;
+    uint8_t direction;
+    int32_t score;
+    uint32_t inputSequence; //Newest input of this player the server has used
+    uint16_t tailCell;
+    uint16_t length; //0 while waiting to respawn
+    std::vector<uint8_t> moves; //2-bit moves from the tail to the head, four per byte
+};
+
+//The whole room after one tick
+struct RoomSnapshot {
+    uint32_t tick = 0;
+    uint16_t width = 0;
+    uint16_t height = 0;
+    std::vector<uint16_t> fruits;
+    std::vector<SnapshotSnake> snakes; //Joined players only, in slot order
+};
+
+/**
+ Copies the room into a snapshot
+ @param game The server's game
+ @param joined One flag per player slot, nonzero if a player holds it
+ @param inputSequences Newest input sequence used for each player slot
+ @param lives Spawn count of each player slot
+ @param snapshot The snapshot to fill in
+ */
+void captureSnapshot(const MultiGame &game, const uint8_t joined[], const uint32_t inputSequences[], const uint16_t lives[], RoomSnapshot &snapshot);
+
+/**
+ Writes a state message
+ @param packet The packet to append to
+ @param snapshot The room
+ @param baseline An earlier state of the same room the client has, or null for a keyframe
+ */
+void writeSnapshot(sf::Packet &packet, const RoomSnapshot &snapshot, const RoomSnapshot *baseline);
+
+/**
+ Reads a state message after its type byte
+ @param packet The received packet
+ @param history The states received before, each at its tick modulo snapshotHistory
+ @param snapshot The snapshot to fill in
+ @return False if the message is malformed or its baseline is no longer in the history
+ */
+bool readSnapshot(sf::Packet &packet, const RoomSnapshot history[], RoomSnapshot &snapshot);
+
+/**
+ Lists a snake's cells
+ @param snake The snake
+ @param width The board width
+ @param cells Receives the cells from the tail to the head
+ */
+void snapshotCells(const SnapshotSnake &snake, int width, std::vector<int> &cells);
+
+#endif
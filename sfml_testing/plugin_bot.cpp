@@ -0,0 +1,85 @@
+//Bot libraries loaded at run time, see plugin_bot.hpp.
+
+#include "plugin_bot.hpp"
+
+#include <dlfcn.h>
+using namespace std;
+
+//GameView is handed out as a cast of GameState, so the two must match field for field
+static_assert(sizeof(GameView) == sizeof(GameState), "GameView must match GameState");
+static_assert(SNAKE_BOARD_WIDTH == gridWidth && SNAKE_BOARD_HEIGHT == gridHeight, "GameView is for another board size");
+static_assert(offsetof(GameView, rng) == offsetof(GameState, rng), "GameView::rng moved");
+static_assert(offsetof(GameView, hash) == offsetof(GameState, hash), "GameView::hash moved");
+static_assert(offsetof(GameView, tick) == offsetof(GameState, tick), "GameView::tick moved");
+static_assert(offsetof(GameView, score) == offsetof(GameState, score), "GameView::score moved");
+static_assert(offsetof(GameView, headCell) == offsetof(GameState, headCell), "GameView::headCell moved");
+static_assert(offsetof(GameView, tailCell) == offsetof(GameState, tailCell), "GameView::tailCell moved");
+static_assert(offsetof(GameView, length) == offsetof(GameState, length), "GameView::length moved");
+static_assert(offsetof(GameView, ringStart) == offsetof(GameState, ringStart), "GameView::ringStart moved");
+static_assert(offsetof(GameView, specialFruitMs) == offsetof(GameState, specialFruitMs), "GameView::specialFruitMs moved");
+static_assert(offsetof(GameView, fruitX) == offsetof(GameState, fruitX), "GameView::fruitX moved");
+static_assert(offsetof(GameView, fruitY) == offsetof(GameState, fruitY), "GameView::fruitY moved");
+static_assert(offsetof(GameView, specialFruitX) == offsetof(GameState, specialFruitX), "GameView::specialFruitX moved");
+static_assert(offsetof(GameView, specialFruitY) == offsetof(GameState, specialFruitY), "GameView::specialFruitY moved");
+static_assert(offsetof(GameView, fruitCounter) == offsetof(GameState, fruitCounter), "GameView::fruitCounter moved");
+static_assert(offsetof(GameView, direction) == offsetof(GameState, direction), "GameView::direction moved");
+static_assert(offsetof(GameView, gameOver) == offsetof(GameState, gameOver), "GameView::gameOver moved");
+static_assert(offsetof(GameView, occupied) == offsetof(GameState, occupied), "GameView::occupied moved");
+static_assert(offsetof(GameView, moves) == offsetof(GameState, moves), "GameView::moves moved");
+
+PluginBot::PluginBot() {
+    library = nullptr;
+    decideFunction = nullptr;
+    freeFunction = nullptr;
+}
+
+PluginBot::~PluginBot() {
+    unload();
+}
+
+bool PluginBot::load(const string &path, string &error) {
+    unload();
+    //A path without a slash would be searched for in the library path instead of the current directory
+    string file = (path.find('/') == string::npos) ? "./" + path : path;
+    void *handle = dlopen(file.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        error = dlerror();
+        return false;
+    }
+    SnakeBotInitFunction initFunction = (SnakeBotInitFunction) dlsym(handle, "snake_bot_init");
+    SnakeBotDecideFunction decide = (SnakeBotDecideFunction) dlsym(handle, "snake_bot_decide");
+    SnakeBotFreeFunction release = (SnakeBotFreeFunction) dlsym(handle, "snake_bot_free");
+    if (!initFunction || !decide || !release) {
+        error = path + " does not export snake_bot_init, snake_bot_decide and snake_bot_free";
+        dlclose(handle);
+        return false;
+    }
+    if (initFunction(SNAKE_BOT_ABI_VERSION, gridWidth, gridHeight) != SNAKE_BOT_OK) {
+        error = path + " refused to start (ABI version " + to_string(SNAKE_BOT_ABI_VERSION) + ")";
+        dlclose(handle);
+        return false;
+    }
+    library = handle;
+    decideFunction = decide;
+    freeFunction = release;
+    return true;
+}
+
+void PluginBot::unload() {
+    if (library) {
+        freeFunction();
+        dlclose(library);
+    }
+    library = nullptr;
+    decideFunction = nullptr;
+    freeFunction = nullptr;
+}
+
+bool PluginBot::loaded() const {
+    return library != nullptr;
+}
+
+int PluginBot::decide(const GameState &state) const {
+    int direction = decideFunction(reinterpret_cast<const GameView *>(&state));
+    return (direction >= Up && direction <= Right) ? direction : state.direction;
+}
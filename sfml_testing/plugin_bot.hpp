@@ -0,0 +1,53 @@
+//Loads a bot built against snake_bot.h from a shared library with dlopen and asks
+//it for moves. The game state is handed over as a GameView pointer without copying.
+
+#ifndef PLUGIN_BOT_HPP
+#define PLUGIN_BOT_HPP
+
+#include "game_state.hpp"
+#include "snake_bot.h"
+
+#include <string>
+
+//One loaded bot library
+class PluginBot {
+public:
+    PluginBot();
+    ~PluginBot();
+
+    PluginBot(const PluginBot &) = delete;
+    PluginBot &operator=(const PluginBot &) = delete;
+
+    /**
+     Loads a bot library and calls its snake_bot_init, unloading any bot loaded before
+     @param path The .so (or .dylib) file
+     @param error Receives the reason when loading fails
+     @return False if the library could not be loaded or refused to start
+     */
+    bool load(const std::string &path, std::string &error);
+
+    /**
+     Calls snake_bot_free and unloads the library, if one is loaded
+     */
+    void unload();
+
+    /**
+     Checks whether a bot is loaded
+     @return True once load has succeeded
+     */
+    bool loaded() const;
+
+    /**
+     Asks the bot for the next move
+     @param state The current game state, viewed by the bot in place
+     @return The direction constant to pass to stepGame; the current direction if the bot answers nonsense
+     */
+    int decide(const GameState &state) const;
+
+private:
+    void *library; //dlopen handle
+    SnakeBotDecideFunction decideFunction;
+    SnakeBotFreeFunction freeFunction;
+};
+
+#endif
@@ -0,0 +1,240 @@
+//Int8 policy network, see policy_net.hpp.
+
+#include "policy_net.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+using namespace std;
+
+const char netMagic[8] = {'S', 'N', 'K', 'N', 'E', 'T', '0', '1'};
+const int maxLayerSize = 1 << 16; //Larger layers are taken as a corrupt file
+const int activationMax = 127; //Hidden outputs stay in int8 range so u8 x s8 pairs cannot overflow 16 bits
+
+typedef int32_t (*DotKernel)(const uint8_t *activations, const int8_t *weights, int length);
+
+/**
+ Dot product of activations and one weight row in plain C++
+ @param activations Inputs, 0 to 127
+ @param weights The weight row
+ @param length Number of elements, a multiple of 32
+ @return The sum of products
+ */
+static int32_t dotScalar(const uint8_t *activations, const int8_t *weights, int length) {
+    int32_t sum = 0;
+    for (int i = 0; i < length; ++i) {
+        sum += activations[i] * weights[i];
+    }
+    return sum;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/**
+ Dot product with AVX2: maddubs multiplies unsigned activations by signed weights into
+ 16-bit pair sums, and madd against ones widens those to 32 bits
+ */
+__attribute__((target("avx2"))) static int32_t dotAvx2(const uint8_t *activations, const int8_t *weights, int length) {
+    __m256i sum = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi16(1);
+    for (int i = 0; i < length; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (activations + i));
+        __m256i w = _mm256_loadu_si256((const __m256i *) (weights + i));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(a, w), ones));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(half);
+}
+#endif
+
+#if defined(__aarch64__)
+/**
+ Dot product with NEON. Activations are at most 127, so they can be read as int8. With the
+ dot-product extension sdot does four multiply-adds per lane, otherwise the products are
+ summed in 16 bits (at most 2 * 127 * 128) and widened with a pairwise add.
+ */
+static int32_t dotNeon(const uint8_t *activations, const int8_t *weights, int length) {
+    int32x4_t sum = vdupq_n_s32(0);
+    for (int i = 0; i < length; i += 16) {
+        int8x16_t a = vreinterpretq_s8_u8(vld1q_u8(activations + i));
+        int8x16_t w = vld1q_s8(weights + i);
+#if defined(__ARM_FEATURE_DOTPROD)
+        sum = vdotq_s32(sum, a, w);
+#else
+        int16x8_t products = vmull_s8(vget_low_s8(a), vget_low_s8(w));
+        products = vmlal_s8(products, vget_high_s8(a), vget_high_s8(w));
+        sum = vpadalq_s16(sum, products);
+#endif
+    }
+    return vaddvq_s32(sum);
+}
+#endif
+
+/**
+ Picks the fastest kernel this CPU supports
+ @return The kernel
+ */
+static DotKernel pickKernel() {
+#if defined(__aarch64__)
+    return dotNeon;
+#elif defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2")) {
+        return dotAvx2;
+    }
+#endif
+    return dotScalar;
+}
+
+static const DotKernel dot = pickKernel();
+
+const char *PolicyNet::kernelName() {
+#if defined(__aarch64__) && defined(__ARM_FEATURE_DOTPROD)
+    return "neon dotprod";
+#elif defined(__aarch64__)
+    return "neon";
+#else
+    return (dot == dotScalar) ? "scalar" : "avx2";
+#endif
+}
+
+/**
+ Rounds a row length up to the kernels' block size
+ @param inputs Number of inputs
+ @return The padded length
+ */
+static int paddedLength(int inputs) {
+    return (inputs + 31) / 32 * 32;
+}
+
+bool PolicyNet::setLayers(const vector<NetLayer> &newLayers) {
+    if (newLayers.empty() || newLayers.front().inputs != obsBytes || newLayers.back().outputs != 4) {
+        return false;
+    }
+    for (size_t i = 0; i < newLayers.size(); ++i) {
+        const NetLayer &layer = newLayers[i];
+        if (layer.outputs <= 0 || layer.stride != paddedLength(layer.inputs) || layer.shift < 0 || layer.shift > 31 ||
+            (int) layer.bias.size() != layer.outputs || layer.weights.size() != (size_t) layer.outputs * layer.stride ||
+            (i > 0 && layer.inputs != newLayers[i - 1].outputs)) {
+            return false;
+        }
+    }
+    layers = newLayers;
+    return true;
+}
+
+bool PolicyNet::loadFromFile(const string &path) {
+    ifstream inFile(path, ios::binary);
+    char magic[8];
+    uint32_t layerCount = 0;
+    if (!inFile.read(magic, 8) || memcmp(magic, netMagic, 8) != 0 || !inFile.read((char *) &layerCount, 4) || layerCount == 0 || layerCount > 16) {
+        return false;
+    }
+    vector<NetLayer> loaded(layerCount);
+    for (NetLayer &layer : loaded) {
+        uint32_t header[3];
+        if (!inFile.read((char *) header, sizeof(header)) || header[0] == 0 || header[0] > (uint32_t) maxLayerSize ||
+            header[1] == 0 || header[1] > (uint32_t) maxLayerSize) {
+            return false;
+        }
+        layer.inputs = (int) header[0];
+        layer.outputs = (int) header[1];
+        layer.shift = (int) header[2];
+        layer.stride = paddedLength(layer.inputs);
+        layer.bias.resize(layer.outputs);
+        layer.weights.assign((size_t) layer.outputs * layer.stride, 0);
+        if (!inFile.read((char *) layer.bias.data(), layer.outputs * sizeof(int32_t))) {
+            return false;
+        }
+        for (int row = 0; row < layer.outputs; ++row) {
+            if (!inFile.read((char *) &layer.weights[(size_t) row * layer.stride], layer.inputs)) {
+                return false;
+            }
+        }
+    }
+    return setLayers(loaded);
+}
+
+bool PolicyNet::saveToFile(const string &path) const {
+    ofstream outFile(path, ios::binary);
+    uint32_t layerCount = (uint32_t) layers.size();
+    outFile.write(netMagic, 8);
+    outFile.write((const char *) &layerCount, 4);
+    for (const NetLayer &layer : layers) {
+        uint32_t header[3] = {(uint32_t) layer.inputs, (uint32_t) layer.outputs, (uint32_t) layer.shift};
+        outFile.write((const char *) header, sizeof(header));
+        outFile.write((const char *) layer.bias.data(), layer.outputs * sizeof(int32_t));
+        for (int row = 0; row < layer.outputs; ++row) {
+            outFile.write((const char *) &layer.weights[(size_t) row * layer.stride], layer.inputs);
+        }
+    }
+    return (bool) outFile;
+}
+
+void PolicyNet::evaluateBatch(const uint8_t planes[], int count, int32_t logits[]) {
+    if (layers.empty() || count <= 0) {
+        return;
+    }
+    //Copy the boards into padded rows so every kernel call reads whole blocks
+    int stride = layers[0].stride;
+    activations[0].resize((size_t) count * stride);
+    for (int board = 0; board < count; ++board) {
+        memcpy(&activations[0][(size_t) board * stride], planes + (size_t) board * obsBytes, obsBytes);
+        memset(&activations[0][(size_t) board * stride + obsBytes], 0, stride - obsBytes);
+    }
+
+    for (size_t i = 0; i < layers.size(); ++i) {
+        const NetLayer &layer = layers[i];
+        bool last = (i + 1 == layers.size());
+        const vector<uint8_t> &input = activations[i & 1];
+        vector<uint8_t> &output = activations[(i + 1) & 1];
+        int outStride = last ? 0 : layers[i + 1].stride;
+        if (!last) {
+            output.assign((size_t) count * outStride, 0);
+        }
+        //One weight row at a time for all boards, so the row stays in cache
+        for (int row = 0; row < layer.outputs; ++row) {
+            const int8_t *weights = &layer.weights[(size_t) row * layer.stride];
+            for (int board = 0; board < count; ++board) {
+                int32_t sum = dot(&input[(size_t) board * layer.stride], weights, layer.stride) + layer.bias[row];
+                if (last) {
+                    logits[board * 4 + row] = sum;
+                } else {
+                    output[(size_t) board * outStride + row] = (uint8_t) min(max(sum >> layer.shift, 0), activationMax);
+                }
+            }
+        }
+    }
+}
+
+void PolicyNet::decideBatch(const uint8_t planes[], const int32_t directions[], int count, uint8_t actions[]) {
+    vector<int32_t> logits((size_t) count * 4);
+    evaluateBatch(planes, count, logits.data());
+    for (int board = 0; board < count; ++board) {
+        int best = directions[board];
+        int32_t bestScore = INT32_MIN;
+        for (int direction = 0; direction < 4; ++direction) {
+            if (direction != oppositeDirection(directions[board]) && logits[board * 4 + direction] > bestScore) {
+                bestScore = logits[board * 4 + direction];
+                best = direction;
+            }
+        }
+        actions[board] = (uint8_t) best;
+    }
+}
+
+int PolicyNet::decide(const GameState &state) {
+    uint8_t planes[obsBytes];
+    writeStatePlanes(state, planes);
+    int32_t direction = state.direction;
+    uint8_t action = (uint8_t) direction;
+    decideBatch(planes, &direction, 1, &action);
+    return action;
+}
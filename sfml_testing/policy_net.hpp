@@ -0,0 +1,96 @@
+//Small learned policy that picks the snake's move from the board planes written
+//by BatchEnv::writePlanes (body, head, fruit, special fruit). It is a multilayer
+//perceptron with int8 weights and int32 biases, trained elsewhere and loaded from
+//a file, and runs on integer dot-product kernels: AVX2 on x86 (picked at run time),
+//NEON on ARM and plain C++ everywhere else. No floating point is used.
+//
+//Weights file, little-endian:
+//  "SNKNET01"                          8-byte magic
+//  uint32 layerCount
+//  per layer:
+//    uint32 inputs, uint32 outputs, uint32 shift
+//    int32 bias[outputs]
+//    int8 weights[outputs][inputs]     row-major
+//The first layer takes obsBytes inputs and the last gives 4 outputs, one per
+//direction constant. Hidden layers compute relu((W x + b) >> shift) clamped to
+//0-127, so they can feed the next layer as int8 without overflowing the kernels.
+
+#ifndef POLICY_NET_HPP
+#define POLICY_NET_HPP
+
+#include "game_state.hpp"
+#include "batch_env.hpp"
+
+#include <string>
+#include <vector>
+
+//One fully connected layer
+struct NetLayer {
+    int inputs;
+    int outputs;
+    int stride; //Row length in `weights`, inputs rounded up to a multiple of 32 and zero-padded
+    int shift; //Right shift that brings the accumulators back to activation range
+    std::vector<int32_t> bias;
+    std::vector<int8_t> weights;
+};
+
+class PolicyNet {
+public:
+    /**
+     Loads the layers from a weights file
+     @param path The file to read
+     @return False if the file is missing or not a valid policy for this board
+     */
+    bool loadFromFile(const std::string &path);
+
+    /**
+     Writes the layers in the same format
+     @param path The file to write
+     @return False if the file could not be written
+     */
+    bool saveToFile(const std::string &path) const;
+
+    /**
+     Replaces the layers, for training tools and tests
+     @param newLayers Layers in order, each with `stride` set and padded weights
+     @return False if the layer sizes do not chain from obsBytes inputs to 4 outputs
+     */
+    bool setLayers(const std::vector<NetLayer> &newLayers);
+
+    /**
+     Scores the four directions for a batch of boards. Weight rows are reused across the
+     boards, so larger batches spend less time per board loading weights.
+     @param planes count observation blocks of obsBytes bytes each
+     @param count Number of boards
+     @param logits Receives 4 scores per board, indexed by direction constant
+     */
+    void evaluateBatch(const uint8_t planes[], int count, int32_t logits[]);
+
+    /**
+     Chooses the direction for the next move
+     @param state The current game state
+     @return The highest-scoring direction that is not a reverse move
+     */
+    int decide(const GameState &state);
+
+    /**
+     Chooses the direction for every board in a batch
+     @param planes count observation blocks of obsBytes bytes each
+     @param directions The last move of each board, whose reverse is never picked
+     @param count Number of boards
+     @param actions Receives one direction constant per board
+     */
+    void decideBatch(const uint8_t planes[], const int32_t directions[], int count, uint8_t actions[]);
+
+    /**
+     Returns the name of the dot-product kernel in use
+     @return "avx2", "neon dotprod", "neon" or "scalar"
+     */
+    static const char *kernelName();
+
+private:
+    std::vector<NetLayer> layers;
+    std::vector<uint8_t> activations[2]; //Scratch for the layer inputs and outputs, reused between calls
+};
+
+#endif
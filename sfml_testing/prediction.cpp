@@ -0,0 +1,155 @@
+//Predicted room with rollback, see prediction.hpp.
+
+#include "prediction.hpp"
+
+#include <algorithm>
+#include <chrono>
+using namespace std;
+
+PredictedRoom::PredictedRoom(int width, int height, int tickMs, int player)
+    : tickMs(max(1, tickMs)), player(player), current(width, height, maxMultiSnakes, 0, 0) {
+    ringSize = (rollbackWindowMs + this->tickMs - 1) / this->tickMs + 2;
+    current.setFruitRespawn(false); //New fruit shows up in the server's states
+    current.clearBoard(0);
+    ring.assign(ringSize, current);
+    ownDirections.assign(ringSize, Right);
+    nextDirection = Right;
+    nextDirectionTick = 0;
+    ownLife = 0;
+    haveState = false;
+    serverTick = 0;
+    totals = PredictionStats{0, 0, 0, 0, 0.0, 0.0};
+}
+
+void PredictedRoom::authoritative(const RoomSnapshot &room, sf::Time arrival) {
+    if (haveState && (int32_t) (room.tick - serverTick) <= 0) {
+        return;
+    }
+    serverTick = room.tick;
+    serverArrival = arrival;
+
+    //A new life faces its spawn direction until the player's first turn after the
+    //respawn, as on the server, which drops the turns meant for the last life
+    uint32_t predictedTick = current.tick();
+    for (const SnapshotSnake &snake : room.snakes) {
+        if (snake.player == player && snake.life != ownLife) {
+            ownLife = snake.life;
+            bool turnedSince = (int32_t) (nextDirectionTick - room.tick) > 0;
+            for (uint32_t tick = room.tick + 1; (int32_t) (tick - predictedTick) <= 0; ++tick) {
+                if (!turnedSince || (int32_t) (tick - nextDirectionTick) < 0) {
+                    ownDirections[tick % ringSize] = snake.direction;
+                }
+            }
+            if (!turnedSince) {
+                nextDirection = snake.direction;
+            }
+        }
+    }
+
+    if (!haveState || (int32_t) (room.tick - predictedTick) > 0 || predictedTick - room.tick >= (uint32_t) ringSize) {
+        //Nothing predicted for this tick: start over from it
+        load(room);
+        haveState = true;
+        return;
+    }
+    if (matches(ring[room.tick % ringSize], room)) {
+        totals.confirmed++;
+        return;
+    }
+
+    //Go back to the server's state and step the later ticks again
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    load(room);
+    for (uint32_t tick = room.tick + 1; (int32_t) (tick - predictedTick) <= 0; ++tick) {
+        stepPredicted(ownDirections[tick % ringSize]);
+        totals.resimulated++;
+    }
+    double us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    totals.rollbacks++;
+    totals.resimulateUs += us;
+    totals.maxResimulateUs = max(totals.maxResimulateUs, us);
+}
+
+void PredictedRoom::advance(sf::Time now, float roundTripMs) {
+    if (!haveState) {
+        return;
+    }
+    //The server steps tick serverTick + n about n ticks after it sent serverTick, half a
+    //round trip before it arrived here. An input sent now arrives half a round trip from
+    //now, so the first tick it can make is the one after `due`.
+    float ahead = ((now - serverArrival).asMicroseconds() / 1000.0f + roundTripMs) / tickMs;
+    uint32_t due = serverTick + (uint32_t) min(max(ahead, 0.0f), float(ringSize - 1));
+    while ((int32_t) (due - current.tick()) > 0) {
+        stepPredicted(nextDirection);
+        totals.predicted++;
+    }
+}
+
+uint32_t PredictedRoom::setDirection(int direction) {
+    nextDirection = (uint8_t) direction;
+    nextDirectionTick = current.tick() + 1;
+    return nextDirectionTick;
+}
+
+bool PredictedRoom::started() const {
+    return haveState;
+}
+
+const MultiGame &PredictedRoom::game() const {
+    return current;
+}
+
+PredictionStats PredictedRoom::stats() const {
+    return totals;
+}
+
+void PredictedRoom::load(const RoomSnapshot &room) {
+    current.clearBoard(room.tick);
+    for (const SnapshotSnake &snake : room.snakes) {
+        snapshotCells(snake, room.width, cells);
+        current.placeSnake(snake.player, cells, snake.direction, snake.score);
+    }
+    for (uint16_t fruit : room.fruits) {
+        current.placeFruit(fruit);
+    }
+    ring[room.tick % ringSize] = current;
+}
+
+bool PredictedRoom::matches(const MultiGame &predicted, const RoomSnapshot &room) {
+    if (predicted.tick() != room.tick) {
+        return false;
+    }
+    int present = 0;
+    for (const SnapshotSnake &snake : room.snakes) {
+        const MultiSnake &guess = predicted.snake(snake.player);
+        if (guess.alive != snake.alive || guess.length != snake.length || guess.score != snake.score) {
+            return false;
+        }
+        snapshotCells(snake, room.width, cells);
+        for (int i = 0; i < guess.length; ++i) {
+            if (guess.cellAt(i) != cells[i]) {
+                return false;
+            }
+        }
+        present += snake.alive;
+    }
+    //Snakes only come back on the board through the server, so this finds any extra
+    if (present != predicted.aliveCount()) {
+        return false;
+    }
+    fruitsA = predicted.fruitCells();
+    fruitsB = room.fruits;
+    sort(fruitsA.begin(), fruitsA.end());
+    sort(fruitsB.begin(), fruitsB.end());
+    return fruitsA == fruitsB;
+}
+
+void PredictedRoom::stepPredicted(uint8_t ownDirection) {
+    for (int i = 0; i < maxMultiSnakes; ++i) {
+        directions[i] = current.snake(i).direction;
+    }
+    directions[player] = ownDirection;
+    current.step(directions, events);
+    ring[current.tick() % ringSize] = current;
+    ownDirections[current.tick() % ringSize] = ownDirection;
+}
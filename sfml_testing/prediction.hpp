@@ -0,0 +1,116 @@
+//Client-side prediction for network play. The client runs its own copy of the room a
+//few ticks ahead of the newest state from the server, far enough that its own turns
+//reach the server before the tick they are meant for, so the player's snake turns the
+//moment the key is pressed. Other snakes are assumed to keep going straight.
+//
+//Every predicted tick is kept in a ring. When the server's state for a tick arrives it
+//is compared with the prediction for that tick; if they differ (another player turned,
+//a fruit appeared, someone respawned) the room goes back to the server's state and the
+//ticks since are stepped again with the player's recorded turns. The ring covers
+//rollbackWindowMs of latency; with a longer round trip the client stops predicting
+//further ahead, and its turns reach the server a little late.
+
+#ifndef PREDICTION_HPP
+#define PREDICTION_HPP
+
+#include "multi_game.hpp"
+#include "net_protocol.hpp"
+
+#include <SFML/System/Time.hpp>
+
+#include <vector>
+
+const int rollbackWindowMs = 250; //Latency the predicted ticks must cover
+
+//Counters of a predicted room
+struct PredictionStats {
+    long predicted; //Ticks stepped ahead of the server
+    long confirmed; //Server states that matched the prediction
+    long rollbacks; //Server states that did not
+    long resimulated; //Ticks stepped again after rollbacks
+    double resimulateUs; //Summed time of the rollbacks
+    double maxResimulateUs;
+};
+
+class PredictedRoom {
+public:
+    /**
+     Sets up an empty room
+     @param width Number of tiles in width
+     @param height Number of tiles in height
+     @param tickMs Milliseconds per server tick
+     @param player The local player's slot
+     */
+    PredictedRoom(int width, int height, int tickMs, int player);
+
+    /**
+     Takes in a state from the server, rolling back if the tick was predicted differently
+     @param room The state
+     @param arrival When it arrived, on the clock given to advance()
+     */
+    void authoritative(const RoomSnapshot &room, sf::Time arrival);
+
+    /**
+     Steps the predicted ticks that are due
+     @param now The current time
+     @param roundTripMs The round trip to the server
+     */
+    void advance(sf::Time now, float roundTripMs);
+
+    /**
+     Sets the local player's direction from the next predicted tick on
+     @param direction The direction constant
+     @return The tick the direction is for, to send to the server
+     */
+    uint32_t setDirection(int direction);
+
+    /**
+     Checks whether a state from the server has come in yet
+     @return False until then; game() is empty before it
+     */
+    bool started() const;
+
+    const MultiGame &game() const;
+    PredictionStats stats() const;
+
+private:
+    /**
+     Replaces the current room with a state from the server
+     @param room The state
+     */
+    void load(const RoomSnapshot &room);
+
+    /**
+     Compares a predicted tick with the server's state for it
+     @param predicted The prediction
+     @param room The server's state
+     @return True if every snake and fruit is where it was predicted
+     */
+    bool matches(const MultiGame &predicted, const RoomSnapshot &room);
+
+    /**
+     Steps the current room one tick and saves it in the ring
+     @param ownDirection The local player's direction for the tick
+     */
+    void stepPredicted(uint8_t ownDirection);
+
+    int tickMs;
+    int player;
+    int ringSize; //Predicted ticks kept, enough for rollbackWindowMs
+    MultiGame current;
+    std::vector<MultiGame> ring; //Room after each tick, at its tick modulo ringSize
+    std::vector<uint8_t> ownDirections; //Local direction stepped into each tick, the same way
+    uint8_t directions[maxMultiSnakes];
+    uint8_t events[maxMultiSnakes];
+    uint8_t nextDirection;
+    uint32_t nextDirectionTick; //Tick of the last turn
+    uint16_t ownLife;
+    bool haveState;
+    uint32_t serverTick; //Newest tick from the server
+    sf::Time serverArrival;
+    std::vector<int> cells;
+    std::vector<uint16_t> fruitsA, fruitsB;
+    PredictionStats totals;
+};
+
+#endif
@@ -0,0 +1,207 @@
+//Benchmark of the arena mode: thousands of bot snakes on one large board, respawned
+//as they die. Prints the time per tick and per phase, and a hash of the final state,
+//which must not depend on the number of threads. --scaling runs the same arena with
+//1, 2, 4... threads up to --threads and prints the speed-up of each. With --viewers N,
+//the first N snakes also get a snapshot of a --view x --view square around their head
+//every tick, as a server would send its players.
+//
+//Usage: snake_arena [--snakes N] [--size N] [--fruits N] [--length N] [--ticks N]
+//                   [--threads N] [--seed S] [--viewers N] [--view N] [--scaling]
+
+#include "arena.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+//Settings for a run
+struct ArenaOptions {
+    int snakes = 5000;
+    int size = 2048; //Width and height of the board
+    int fruits = 20000;
+    int length = 8; //Length of a spawned snake
+    int ticks = 500;
+    int threads = 0; //0 uses one per core
+    uint64_t seed = 1;
+    int viewers = 0; //Snakes that get a snapshot each tick
+    int view = 64; //Width and height of a viewer's view
+    bool scaling = false;
+};
+
+//What one run measured
+struct ArenaRun {
+    double meanUs; //Mean time per tick, steering and respawns included
+    double p99Us;
+    ArenaTimings phases; //Mean time per phase of the step
+    double steerUs; //Mean time the bots took to choose
+    double viewUs; //Mean time per snapshot, listing what is in view included
+    double viewBytes; //Mean snapshot size
+    double viewSegments; //Mean segments in a snapshot
+    long deaths;
+    long fruitEaten;
+    int chunks;
+    uint64_t hash;
+};
+
+/**
+ Runs an arena for a number of ticks
+ @param options The settings
+ @param threads Number of threads, counting this one
+ @return The measurements
+ */
+static ArenaRun runArena(const ArenaOptions &options, int threads) {
+    unique_ptr<ThreadPool> pool(threads > 1 ? new ThreadPool(threads) : nullptr);
+    Arena arena(options.size, options.size, options.snakes, options.fruits, options.length, options.seed);
+    vector<uint8_t> directions(arena.snakeCount()), events(arena.snakeCount());
+    vector<double> tickUs;
+    ArenaRun run = {};
+    //Each thread lists views and encodes snapshots into its own buffers
+    int viewers = min(options.viewers, arena.snakeCount());
+    vector<VisibleSet> visibles(max(1, threads));
+    vector<vector<uint8_t>> snapshots(max(1, threads));
+    vector<long> viewBytes(max(1, threads)), viewSegments(max(1, threads));
+    auto snapshot = [&](int viewer, int thread) {
+        arena.visibleIn(arena.viewAround(viewer, options.view, options.view), visibles[thread]);
+        arena.encodeView(visibles[thread], snapshots[thread]);
+        viewBytes[thread] += (long) snapshots[thread].size();
+        viewSegments[thread] += (long) visibles[thread].segments.size();
+    };
+    for (int t = 0; t < options.ticks; ++t) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        arena.steerBots(directions.data(), pool.get());
+        chrono::steady_clock::time_point steered = chrono::steady_clock::now();
+        arena.step(directions.data(), events.data(), pool.get());
+        //Respawns draw random numbers, so they go in snake order
+        for (int i = 0; i < arena.snakeCount(); ++i) {
+            if (events[i] & (StepHitWall | StepHitSelf | StepHitSnake | StepHeadOn)) {
+                run.deaths++;
+                arena.spawnSnake(i);
+            }
+            run.fruitEaten += (events[i] & StepAteFruit) != 0;
+        }
+        chrono::steady_clock::time_point stepped = chrono::steady_clock::now();
+        if (pool) {
+            pool->parallelFor(viewers, snapshot);
+        } else {
+            for (int i = 0; i < viewers; ++i) {
+                snapshot(i, 0);
+            }
+        }
+        chrono::steady_clock::time_point end = chrono::steady_clock::now();
+        tickUs.push_back(chrono::duration<double, micro>(end - start).count());
+        run.steerUs += chrono::duration<double, micro>(steered - start).count();
+        run.viewUs += chrono::duration<double, micro>(end - stepped).count() * threads / max(1, viewers);
+        const ArenaTimings &phases = arena.timings();
+        run.phases.propose += phases.propose;
+        run.phases.check += phases.check;
+        run.phases.grid += phases.grid;
+        run.phases.move += phases.move;
+        run.phases.fruit += phases.fruit;
+    }
+    int ticks = max(1, options.ticks);
+    for (double us : tickUs) {
+        run.meanUs += us / ticks;
+    }
+    sort(tickUs.begin(), tickUs.end());
+    run.p99Us = tickUs.empty() ? 0 : tickUs[min(tickUs.size() - 1, tickUs.size() * 99 / 100)];
+    run.steerUs /= ticks;
+    run.viewUs /= ticks;
+    long snapshotCount = max(1L, (long) viewers * ticks);
+    for (int i = 0; i < (int) viewBytes.size(); ++i) {
+        run.viewBytes += double(viewBytes[i]) / snapshotCount;
+        run.viewSegments += double(viewSegments[i]) / snapshotCount;
+    }
+    run.phases.propose /= ticks;
+    run.phases.check /= ticks;
+    run.phases.grid /= ticks;
+    run.phases.move /= ticks;
+    run.phases.fruit /= ticks;
+    run.chunks = arena.chunkCount();
+    run.hash = arena.stateHash();
+    return run;
+}
+
+int main(int argc, char *argv[]) {
+    ArenaOptions options;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--snakes" && hasValue) {
+            options.snakes = atoi(argv[++i]);
+        } else if (arg == "--size" && hasValue) {
+            options.size = atoi(argv[++i]);
+        } else if (arg == "--fruits" && hasValue) {
+            options.fruits = atoi(argv[++i]);
+        } else if (arg == "--length" && hasValue) {
+            options.length = atoi(argv[++i]);
+        } else if (arg == "--ticks" && hasValue) {
+            options.ticks = atoi(argv[++i]);
+        } else if (arg == "--threads" && hasValue) {
+            options.threads = atoi(argv[++i]);
+        } else if (arg == "--seed" && hasValue) {
+            options.seed = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--viewers" && hasValue) {
+            options.viewers = atoi(argv[++i]);
+        } else if (arg == "--view" && hasValue) {
+            options.view = atoi(argv[++i]);
+        } else if (arg == "--scaling") {
+            options.scaling = true;
+        } else {
+            fprintf(stderr, "Usage: snake_arena [--snakes N] [--size N] [--fruits N] [--length N] [--ticks N]\n"
+                            "                   [--threads N] [--seed S] [--viewers N] [--view N] [--scaling]\n");
+            return 1;
+        }
+    }
+    if (options.snakes < 1 || options.snakes > maxArenaSnakes || options.size < 16 || options.size > 65535 ||
+        options.fruits < 0 || options.fruits > maxArenaFruits || options.length < 1 || options.ticks < 1 || options.viewers < 0 || options.view < 1) {
+        fprintf(stderr, "Need 1 to %d snakes, a board of 16 to 65535, up to %d fruits, a length and a tick\n",
+                maxArenaSnakes, maxArenaFruits);
+        return 1;
+    }
+    int threads = options.threads > 0 ? options.threads : max(1, (int) thread::hardware_concurrency());
+
+    vector<int> counts;
+    if (options.scaling) {
+        for (int count = 1; count < threads; count *= 2) {
+            counts.push_back(count);
+        }
+    }
+    counts.push_back(threads);
+
+    printf("%d snakes on %dx%d, %d fruits, %d ticks\n", options.snakes, options.size, options.size, options.fruits,
+           options.ticks);
+    double baseUs = 0;
+    uint64_t baseHash = 0;
+    bool same = true;
+    for (int count : counts) {
+        ArenaRun run = runArena(options, count);
+        if (baseUs == 0) {
+            baseUs = run.meanUs;
+            baseHash = run.hash;
+        }
+        same &= run.hash == baseHash;
+        printf("%2d threads: %.0f us/tick (p99 %.0f us, %.2fx)  steer %.0f  propose %.0f  check %.0f  grid %.0f  move %.0f  fruit %.0f\n",
+               count, run.meanUs, run.p99Us, baseUs / run.meanUs, run.steerUs, run.phases.propose, run.phases.check,
+               run.phases.grid, run.phases.move, run.phases.fruit);
+        if (options.viewers > 0) {
+            printf("            snapshots: %.2f us each, %.0f bytes, %.1f segments in view\n", run.viewUs, run.viewBytes,
+                   run.viewSegments);
+        }
+        printf("            %ld deaths, %ld fruit eaten, %d chunks, state hash %016" PRIx64 "\n", run.deaths,
+               run.fruitEaten, run.chunks, run.hash);
+        fflush(stdout);
+    }
+    if (!same) {
+        printf("The state hash differs between thread counts\n");
+        return 1;
+    }
+    return 0;
+}
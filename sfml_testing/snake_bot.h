@@ -0,0 +1,129 @@
+//Plain C interface for bots built as shared libraries and loaded at run time by the
+//game and by snake_sim, so a bot can be changed and rebuilt without rebuilding them.
+//A bot library exports three functions:
+//
+//  int  snake_bot_init(int abiVersion, int boardWidth, int boardHeight);
+//  int  snake_bot_decide(const GameView *view);
+//  void snake_bot_free(void);
+//
+//snake_bot_init is called once after loading and returns SNAKE_BOT_OK to accept the
+//ABI version and board, snake_bot_free once before unloading. snake_bot_decide is
+//called before every move and returns one of the SNAKE_ACTION values. snake_sim calls
+//it from several threads at once (one game per thread), so a bot that keeps state
+//between calls must keep it per thread or lock it.
+//
+//The view is the engine's own game state, not a copy: the body is the tail cell plus
+//a ring of 2-bit moves from the tail to the head, and the occupancy rows answer
+//"is the snake here?". It is only valid during the call and must not be written to.
+//
+//Build a bot with, for example: cc -O2 -shared -fPIC my_bot.c -o my_bot.so
+
+#ifndef SNAKE_BOT_H
+#define SNAKE_BOT_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32)
+#define SNAKE_BOT_API __declspec(dllexport)
+#else
+#define SNAKE_BOT_API __attribute__((visibility("default")))
+#endif
+
+//Bumped whenever GameView or the functions change
+#define SNAKE_BOT_ABI_VERSION 1
+
+#define SNAKE_BOARD_WIDTH 20
+#define SNAKE_BOARD_HEIGHT 15
+#define SNAKE_BOARD_CELLS (SNAKE_BOARD_WIDTH * SNAKE_BOARD_HEIGHT)
+
+//Return codes of snake_bot_init
+#define SNAKE_BOT_OK 0
+#define SNAKE_BOT_UNSUPPORTED -1
+
+//Actions, the same as the game's direction constants
+#ifndef SNAKE_ACTION_UP
+#define SNAKE_ACTION_UP 0
+#define SNAKE_ACTION_DOWN 1
+#define SNAKE_ACTION_LEFT 2
+#define SNAKE_ACTION_RIGHT 3
+#endif
+
+//Read-only view of one game, laid out exactly like the engine's GameState
+typedef struct GameView {
+    uint64_t rng; //Fruit placement generator state
+    uint64_t hash; //Zobrist hash of the position
+    uint32_t tick; //Number of moves made so far
+    int32_t score;
+    uint16_t headCell; //Cell index (y * SNAKE_BOARD_WIDTH + x) of the head
+    uint16_t tailCell; //Cell index of the last segment
+    uint16_t length; //Number of segments
+    uint16_t ringStart; //Position of the oldest move in `moves`
+    uint16_t specialFruitMs; //Time since the special fruit last moved
+    int8_t fruitX;
+    int8_t fruitY;
+    int8_t specialFruitX; //-1 when there is no special fruit
+    int8_t specialFruitY;
+    uint8_t fruitCounter; //Fruits eaten since the last special fruit
+    uint8_t direction; //Direction of the last move; the opposite direction is ignored
+    uint8_t gameOver; //Always 0 when a bot is asked to decide
+    uint32_t occupied[SNAKE_BOARD_HEIGHT]; //Bit x of row y is set when the snake covers (x, y)
+    uint8_t moves[(SNAKE_BOARD_CELLS + 3) / 4]; //Ring of 2-bit moves, four per byte
+} GameView;
+
+/**
+ Checks whether the snake covers a position on the board
+ @param view The game
+ @param x The x-coordinate on the board
+ @param y The y-coordinate on the board
+ @return Nonzero if a snake segment is on that position
+ */
+static inline int snake_view_occupied(const GameView *view, int x, int y) {
+    return (int) ((view->occupied[y] >> x) & 1u);
+}
+
+/**
+ Returns one of the moves that make up the body
+ @param view The game
+ @param index The move number, 0 being the move just in front of the tail
+ @return The SNAKE_ACTION of that move
+ */
+static inline int snake_view_move_at(const GameView *view, int index) {
+    int slot = (view->ringStart + index) % SNAKE_BOARD_CELLS;
+    return (view->moves[slot >> 2] >> ((slot & 3) * 2)) & 3;
+}
+
+/**
+ Sets the bot up after the library is loaded
+ @param abiVersion SNAKE_BOT_ABI_VERSION of the program loading the bot
+ @param boardWidth Number of tiles in width
+ @param boardHeight Number of tiles in height
+ @return SNAKE_BOT_OK, or SNAKE_BOT_UNSUPPORTED to refuse the version or board
+ */
+SNAKE_BOT_API int snake_bot_init(int abiVersion, int boardWidth, int boardHeight);
+
+/**
+ Chooses the direction for the next move
+ @param view The current game, valid until the call returns
+ @return One of the SNAKE_ACTION values; anything else keeps the current direction
+ */
+SNAKE_BOT_API int snake_bot_decide(const GameView *view);
+
+/**
+ Releases everything the bot holds before the library is unloaded
+ */
+SNAKE_BOT_API void snake_bot_free(void);
+
+//Types of the exported functions, for looking them up with dlsym
+typedef int (*SnakeBotInitFunction)(int abiVersion, int boardWidth, int boardHeight);
+typedef int (*SnakeBotDecideFunction)(const GameView *view);
+typedef void (*SnakeBotFreeFunction)(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,101 @@
+//Bot process for the shared-memory channel (bot_channel.h). Connects to a channel
+//created by the game or by snake_sim and answers every board with one of the built-in
+//bots or a bot library, until the game closes the channel. Also a reference for
+//writing channel bots in other languages.
+//
+//Usage: snake_channel_bot [--spin-us N] [--bot FILE.so] NAME [bfs|cycle|heuristic]
+//--spin-us is how long to poll for the next board before sleeping (default 1000, or 0
+//on a single core, where polling only takes the CPU away from the game): polling keeps
+//the round trip short, sleeping keeps the bot off the CPU between moves.
+
+#include "game_state.hpp"
+#include "autopilot.hpp"
+#include "bot_channel.h"
+#include "hamiltonian.hpp"
+#include "heuristic_bot.hpp"
+#include "plugin_bot.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+using namespace std;
+
+int main(int argc, char *argv[]) {
+    int spinUs = (thread::hardware_concurrency() > 1) ? 1000 : 0;
+    string botPath;
+    string name;
+    string policy = "bfs";
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--spin-us" && hasValue) {
+            spinUs = atoi(argv[++i]);
+        } else if (arg == "--bot" && hasValue) {
+            botPath = argv[++i];
+        } else if (name.empty() && arg[0] != '-') {
+            name = arg;
+        } else if (arg == "bfs" || arg == "cycle" || arg == "heuristic") {
+            policy = arg;
+        } else {
+            name.clear();
+            break;
+        }
+    }
+    if (name.empty()) {
+        fprintf(stderr, "Usage: snake_channel_bot [--spin-us N] [--bot FILE.so] NAME [bfs|cycle|heuristic]\n");
+        return 1;
+    }
+
+    static Autopilot autopilot;
+    PluginBot plugin;
+    string error;
+    if (!botPath.empty() && !plugin.load(botPath, error)) {
+        fprintf(stderr, "Could not load bot: %s\n", error.c_str());
+        return 1;
+    }
+
+    //The game may not have created the channel yet
+    SnakeChannel *channel = nullptr;
+    for (int attempt = 0; attempt < 100 && !channel; ++attempt) {
+        channel = snake_channel_open(name.c_str());
+        if (!channel) {
+            this_thread::sleep_for(chrono::milliseconds(100));
+        }
+    }
+    if (!channel) {
+        fprintf(stderr, "No channel named %s\n", name.c_str());
+        return 1;
+    }
+
+    GameState state;
+    uint32_t sequence = 0;
+    long answered = 0;
+    while (true) {
+        int result = snake_channel_wait(channel, sequence, spinUs, 1000, reinterpret_cast<GameView *>(&state), &sequence);
+        if (result == SNAKE_CHANNEL_CLOSED) {
+            break;
+        }
+        if (result == SNAKE_CHANNEL_TIMEOUT) {
+            continue;
+        }
+        auto start = chrono::steady_clock::now();
+        int direction;
+        if (plugin.loaded()) {
+            direction = plugin.decide(state);
+        } else if (policy == "cycle") {
+            direction = hamiltonianDecide(state);
+        } else if (policy == "heuristic") {
+            direction = heuristicDecide(state, HeuristicWeights());
+        } else {
+            direction = autopilot.decide(state);
+        }
+        long decideNs = (long) chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        snake_channel_reply(channel, sequence, direction, (uint32_t) min(decideNs, (long) UINT32_MAX));
+        answered++;
+    }
+    snake_channel_close(channel);
+    printf("Answered %ld boards\n", answered);
+    return 0;
+}
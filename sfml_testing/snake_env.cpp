@@ -0,0 +1,133 @@
+//C interface to BatchEnv, see snake_env.h.
+
+#include "snake_env.h"
+#include "batch_env.hpp"
+
+#include <cstring>
+#include <memory>
+#include <new>
+using namespace std;
+
+struct SnakeEnv {
+    BatchEnv games;
+    unique_ptr<ThreadPool> pool; //Null when stepping on the calling thread only
+    int moveMs;
+    uint64_t seed;
+    int32_t reward; //Scratch for snake_env_step
+    uint8_t done;
+
+    SnakeEnv(int numEnvs, int moveMs, uint64_t seed) : games(numEnvs, seed), moveMs(moveMs), seed(seed), reward(0), done(0) {
+    }
+};
+
+/**
+ Writes every game's observation
+ @param env The environment
+ @param observations numEnvs observation blocks
+ @param format SNAKE_OBS_UINT8 or SNAKE_OBS_BITS
+ */
+static void writeObservations(SnakeEnv *env, void *observations, int format) {
+    int count = env->games.size();
+    auto write = [&](int game, int) {
+        if (format == SNAKE_OBS_BITS) {
+            env->games.writeBitPlanes(game, (uint32_t *) observations + (size_t) game * obsBitWords);
+        } else {
+            env->games.writePlanes(game, (uint8_t *) observations + (size_t) game * obsBytes);
+        }
+    };
+    if (env->pool && count >= 1024) {
+        env->pool->parallelFor(count, write);
+    } else {
+        for (int game = 0; game < count; ++game) {
+            write(game, 0);
+        }
+    }
+}
+
+/**
+ Checks an observation format number
+ @param format The format passed in
+ @return True if it is one of the SNAKE_OBS values
+ */
+static bool validFormat(int format) {
+    return format == SNAKE_OBS_UINT8 || format == SNAKE_OBS_BITS;
+}
+
+SnakeEnv *snake_env_create(int numEnvs, int moveMs, int threads, uint64_t seed) {
+    if (numEnvs <= 0 || moveMs < 0 || threads < 0) {
+        return nullptr;
+    }
+    try {
+        unique_ptr<SnakeEnv> env = make_unique<SnakeEnv>(numEnvs, moveMs, seed);
+        if (threads != 1) {
+            env->pool = make_unique<ThreadPool>(threads);
+        }
+        return env.release();
+    } catch (...) {
+        return nullptr; //Out of memory or no threads; nothing may escape through the C interface
+    }
+}
+
+void snake_env_close(SnakeEnv *env) {
+    delete env;
+}
+
+int snake_env_observation_bytes(int format) {
+    if (!validFormat(format)) {
+        return SNAKE_ENV_BAD_ARGUMENT;
+    }
+    return (format == SNAKE_OBS_BITS) ? obsBitWords * (int) sizeof(uint32_t) : obsBytes;
+}
+
+int snake_env_num_envs(const SnakeEnv *env) {
+    return env ? env->games.size() : 0;
+}
+
+int snake_env_seed(SnakeEnv *env, uint64_t seed) {
+    if (!env) {
+        return SNAKE_ENV_BAD_ARGUMENT;
+    }
+    env->seed = seed;
+    return SNAKE_ENV_OK;
+}
+
+int snake_env_reset(SnakeEnv *env, void *observations, int format) {
+    if (!env || !validFormat(format)) {
+        return SNAKE_ENV_BAD_ARGUMENT;
+    }
+    env->games.reset(env->seed);
+    if (observations) {
+        writeObservations(env, observations, format);
+    }
+    return SNAKE_ENV_OK;
+}
+
+int snake_env_step(SnakeEnv *env, int action, void *observation, int format, int32_t *reward, uint8_t *done) {
+    if (!env || env->games.size() != 1 || action < 0 || action > 3) {
+        return SNAKE_ENV_BAD_ARGUMENT;
+    }
+    uint8_t actions[1] = {(uint8_t) action};
+    return snake_env_step_batch(env, actions, observation, format, reward ? reward : &env->reward, done ? done : &env->done);
+}
+
+int snake_env_step_batch(SnakeEnv *env, const uint8_t *actions, void *observations, int format, int32_t *rewards, uint8_t *dones) {
+    if (!env || !actions || !validFormat(format)) {
+        return SNAKE_ENV_BAD_ARGUMENT;
+    }
+    if (env->pool) {
+        env->games.step(actions, env->moveMs, *env->pool);
+    } else {
+        env->games.step(actions, env->moveMs);
+    }
+    int count = env->games.size();
+    if (rewards) {
+        memcpy(rewards, env->games.rewards(), count * sizeof(int32_t));
+    }
+    if (dones) {
+        memcpy(dones, env->games.dones(), count * sizeof(uint8_t));
+    }
+    if (observations) {
+        writeObservations(env, observations, format);
+    }
+    return SNAKE_ENV_OK;
+}
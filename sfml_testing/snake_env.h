@@ -0,0 +1,121 @@
+//Plain C interface to batches of headless snake games, built as libsnakeenv for
+//training code in other languages (for example Python through ctypes or cffi).
+//It follows the Gym vector-environment pattern: reset, then step with one action
+//per game. Games that end are restarted inside the step, so the observation
+//returned with done != 0 is the first one of the next episode.
+//
+//Observations are written straight into buffers owned by the caller, one block
+//per game, in one of two formats:
+//  SNAKE_OBS_UINT8: 4 planes of 20 x 15 bytes (0 or 1), row by row
+//  SNAKE_OBS_BITS:  4 planes of 15 little-endian uint32 rows, bit x is column x
+//The planes are body, head, fruit and special fruit.
+//
+//Functions return SNAKE_ENV_OK or a negative error code and never throw.
+
+#ifndef SNAKE_ENV_H
+#define SNAKE_ENV_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32)
+#define SNAKE_ENV_API __declspec(dllexport)
+#else
+#define SNAKE_ENV_API __attribute__((visibility("default")))
+#endif
+
+//Observation formats
+#define SNAKE_OBS_UINT8 0
+#define SNAKE_OBS_BITS 1
+
+//Return codes
+#define SNAKE_ENV_OK 0
+#define SNAKE_ENV_BAD_ARGUMENT -1
+
+//Actions
+#define SNAKE_ACTION_UP 0
+#define SNAKE_ACTION_DOWN 1
+#define SNAKE_ACTION_LEFT 2
+#define SNAKE_ACTION_RIGHT 3
+
+typedef struct SnakeEnv SnakeEnv;
+
+/**
+ Creates a batch of games
+ @param numEnvs Number of games stepped together
+ @param moveMs Game time per step, which moves the special fruit every 3000 ms
+ @param threads Threads to step with, 0 for one per core
+ @param seed Seed the per-game seeds are drawn from
+ @return The environment, or NULL if the arguments are bad or memory ran out
+ */
+SNAKE_ENV_API SnakeEnv *snake_env_create(int numEnvs, int moveMs, int threads, uint64_t seed);
+
+/**
+ Frees an environment
+ @param env The environment, or NULL
+ */
+SNAKE_ENV_API void snake_env_close(SnakeEnv *env);
+
+/**
+ Returns the number of bytes one game's observation takes
+ @param format SNAKE_OBS_UINT8 or SNAKE_OBS_BITS
+ @return The size in bytes, or SNAKE_ENV_BAD_ARGUMENT
+ */
+SNAKE_ENV_API int snake_env_observation_bytes(int format);
+
+/**
+ Returns the number of games in an environment
+ @param env The environment
+ @return The game count
+ */
+SNAKE_ENV_API int snake_env_num_envs(const SnakeEnv *env);
+
+/**
+ Sets the seed used by the next reset
+ @param env The environment
+ @param seed Seed the per-game seeds are drawn from
+ @return SNAKE_ENV_OK or an error code
+ */
+SNAKE_ENV_API int snake_env_seed(SnakeEnv *env, uint64_t seed);
+
+/**
+ Starts every game again and writes the first observations
+ @param env The environment
+ @param observations numEnvs observation blocks, or NULL to skip them
+ @param format SNAKE_OBS_UINT8 or SNAKE_OBS_BITS
+ @return SNAKE_ENV_OK or an error code
+ */
+SNAKE_ENV_API int snake_env_reset(SnakeEnv *env, void *observations, int format);
+
+/**
+ Steps a single-game environment (created with numEnvs = 1)
+ @param env The environment
+ @param action One of the SNAKE_ACTION values
+ @param observation One observation block, or NULL
+ @param format SNAKE_OBS_UINT8 or SNAKE_OBS_BITS
+ @param reward Receives the points scored, or NULL
+ @param done Receives 0, or the reason the episode ended (4 wall, 8 self, 16 board full), or NULL
+ @return SNAKE_ENV_OK or an error code
+ */
+SNAKE_ENV_API int snake_env_step(SnakeEnv *env, int action, void *observation, int format, int32_t *reward, uint8_t *done);
+
+/**
+ Steps every game with one action each
+ @param env The environment
+ @param actions numEnvs SNAKE_ACTION values
+ @param observations numEnvs observation blocks, or NULL
+ @param format SNAKE_OBS_UINT8 or SNAKE_OBS_BITS
+ @param rewards numEnvs points scored, or NULL
+ @param dones numEnvs end reasons as in snake_env_step, or NULL
+ @return SNAKE_ENV_OK or an error code
+ */
+SNAKE_ENV_API int snake_env_step_batch(SnakeEnv *env, const uint8_t *actions, void *observations, int format, int32_t *rewards, uint8_t *dones);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
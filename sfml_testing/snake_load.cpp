@@ -0,0 +1,704 @@
+//Load generator for the room server. Simulates many players over loopback UDP, each
+//steered by a bot policy at a set input rate, optionally behind artificial latency and
+//loss, and measures what the server and its players see:
+//- server tick time and jitter (how late each tick starts), read from the server's own
+//  histograms when it runs in this process, which it does unless --server is given;
+//- the interval between states arriving at each player;
+//- state bandwidth per player and in total;
+//- input-to-ack latency, from sending an input to the first state showing the server
+//  used it.
+//Each entry of --players is a separate stage with a fresh server, by default 1000,
+//10000 and 50000 players.
+//
+//Simulated players use plain non-blocking sockets: an sf::UdpSocket carries a 64 KB
+//receive buffer, 3 GB at 50000 players. Each socket needs its own port, so players are
+//spread over 127.0.0.1, 127.0.0.2 and so on, 20000 to an address; on macOS the extra
+//addresses need `ifconfig lo0 alias 127.0.0.2` first. The open-file limit is raised to
+//its hard maximum.
+//
+//Usage: snake_load [--players N[,N...]] [--seconds N] [--room-size N] [--tick-ms MS]
+//                  [--policy random|fruit] [--inputs-per-second R] [--latency-ms MS]
+//                  [--jitter-ms MS] [--loss P] [--threads N] [--workers N]
+//                  [--join-rate N] [--server HOST[:PORT]] [--seed S]
+
+#include "game_server.hpp"
+
+#include <SFML/Network.hpp>
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <netinet/in.h>
+#include <queue>
+#include <string>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+using namespace std;
+
+const int playersPerAddress = 20000; //Ports used on each loopback address
+const int joinRetryMs = 500;
+const int warmUpMs = 1000; //Time between the last join and measuring, for first keyframes to pass
+const int sentInputs = 16; //Inputs per player whose send time is kept, a power of two
+const double histogramStepMs = 0.1; //Resolution of the latency histograms
+const int histogramBins = 100000; //Up to 10 s
+
+//Settings for a load run
+struct LoadOptions {
+    vector<int> players = {1000, 10000, 50000};
+    int seconds = 20; //Measured time per stage, after every player joined
+    int roomSize = roomPlayers;
+    int tickMs = defaultTickMs;
+    bool fruitPolicy = false; //Steer toward fruit instead of turning at random
+    double inputsPerSecond = 2; //Decisions per player per second
+    double latencyMs = 0; //One way, added in both directions
+    double jitterMs = 0; //Up to this much more, at random
+    double loss = 0; //Chance of dropping each datagram, in both directions
+    int threads = 0; //0 uses one per core
+    int workers = 0; //Server workers, 0 for one per core
+    int joinRate = 5000; //Joins sent per second
+    string serverHost; //Empty runs a server in this process
+    unsigned short serverPort = defaultServerPort;
+    uint64_t seed = 1;
+};
+
+//Latencies in fixed steps, merged across threads at the end of a stage
+class LatencyHistogram {
+public:
+    LatencyHistogram() : bins(histogramBins + 1, 0), count(0) {}
+
+    /**
+     Counts one sample
+     @param ms The sample in milliseconds
+     */
+    void add(double ms) {
+        bins[min((int) max(ms / histogramStepMs, 0.0), histogramBins)]++;
+        count++;
+    }
+
+    /**
+     Adds another histogram's samples to this one
+     @param other The histogram
+     */
+    void merge(const LatencyHistogram &other) {
+        for (int i = 0; i <= histogramBins; ++i) {
+            bins[i] += other.bins[i];
+        }
+        count += other.count;
+    }
+
+    /**
+     Reads a percentile
+     @param fraction The percentile, 0.5 for the median
+     @return The sample at it in milliseconds, 0 without samples
+     */
+    double percentile(double fraction) const {
+        long rank = max(1L, (long) ceil(fraction * count));
+        for (int i = 0; i <= histogramBins; ++i) {
+            rank -= bins[i];
+            if (rank <= 0) {
+                return (i + 1) * histogramStepMs;
+            }
+        }
+        return 0;
+    }
+
+private:
+    vector<long> bins;
+    long count;
+};
+
+//Counters of one load thread over the measured time
+struct LoadStats {
+    long states = 0;
+    long stateBytes = 0;
+    long inputs = 0; //Turns sent
+    long acked = 0; //Turns seen in a state
+    long undecodable = 0; //States whose baseline was gone
+    LatencyHistogram intervals; //Between states at one player
+    LatencyHistogram ackLatency;
+};
+
+//A datagram held back to simulate latency
+struct Delayed {
+    sf::Time due;
+    int client; //Index in the thread's clients
+    bool outgoing;
+    vector<uint8_t> bytes;
+};
+
+//Orders the delay queue earliest first
+struct DueLater {
+    bool operator()(const Delayed &a, const Delayed &b) const {
+        return a.due > b.due;
+    }
+};
+
+//One simulated player
+struct LoadClient {
+    int socket = -1;
+    int room = 0;
+    int player = -1; //-1 until welcomed
+    int32_t joinAtMs = 0; //First join, spread out by the join rate
+    sf::Time nextJoin;
+    sf::Time nextDecision;
+    sf::Time lastState;
+    sf::Time lastSent;
+    uint32_t newestTick = 0; //0 for none
+    uint32_t inputSequence = 0;
+    uint32_t ackedSequence = 0; //Newest input seen in a state
+    uint8_t direction = Right;
+    sf::Time sentAt[sentInputs]; //Send time of each input, at its sequence modulo sentInputs
+};
+
+//The states of one room as its players decoded them; every player of a room is on the
+//same thread, so one decode serves all of them
+struct RoomView {
+    RoomSnapshot history[snapshotHistory];
+    uint32_t occupancyTick = 0;
+    vector<uint8_t> occupied; //Cells with a snake at occupancyTick
+};
+
+//Everything one load thread owns
+struct LoadThread {
+    thread worker;
+    vector<LoadClient> clients;
+    vector<unique_ptr<RoomView>> rooms; //Indexed by room number / thread count
+    priority_queue<Delayed, vector<Delayed>, DueLater> delayed;
+    uint64_t rng = 0;
+    LoadStats stats;
+};
+
+//Shared by the load threads of a stage
+struct LoadRun {
+    const LoadOptions *options;
+    sockaddr_in server;
+    sf::Clock clock;
+    atomic<int> joined{0};
+    sf::Time measureStart; //Set before measuring is
+    atomic<bool> measuring{false};
+    atomic<bool> stopping{false};
+    int threadCount = 1;
+};
+
+/**
+ Draws a number in [0, 1)
+ @param rng The generator state
+ @return The number
+ */
+static double uniform(uint64_t &rng) {
+    return (nextRandom(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ Sends a datagram to the server now or, with latency set, once it is due
+ @param run The stage
+ @param thread The sending thread
+ @param index The client in the thread
+ @param packet The datagram
+ @param now The current time
+ */
+static void sendToServer(LoadRun &run, LoadThread &thread, int index, const sf::Packet &packet, sf::Time now) {
+    const LoadOptions &options = *run.options;
+    if (options.loss > 0 && uniform(thread.rng) < options.loss) {
+        return;
+    }
+    if (options.latencyMs > 0 || options.jitterMs > 0) {
+        const uint8_t *data = (const uint8_t *) packet.getData();
+        double delayMs = options.latencyMs + options.jitterMs * uniform(thread.rng);
+        thread.delayed.push(Delayed{now + sf::microseconds((sf::Int64) (delayMs * 1000)), index, true,
+                                    vector<uint8_t>(data, data + packet.getDataSize())});
+        return;
+    }
+    sendto(thread.clients[index].socket, packet.getData(), packet.getDataSize(), 0, (const sockaddr *) &run.server,
+           sizeof(run.server));
+}
+
+/**
+ Sends a client's current direction, which also acknowledges its newest state
+ @param run The stage
+ @param thread The client's thread
+ @param index The client in the thread
+ @param now The current time
+ */
+static void sendInput(LoadRun &run, LoadThread &thread, int index, sf::Time now) {
+    LoadClient &client = thread.clients[index];
+    sf::Packet input;
+    input << MessageInput << (uint8_t) client.player << client.inputSequence << client.direction << client.newestTick << (uint32_t) 0;
+    sendToServer(run, thread, index, input, now);
+    client.lastSent = now;
+}
+
+/**
+ Picks a fruit-seeking direction: toward the nearest fruit among the moves that do not
+ hit a wall or a snake right away
+ @param view The room
+ @param client The player
+ @return The direction constant
+ */
+static uint8_t fruitDirection(RoomView &view, const LoadClient &client) {
+    const RoomSnapshot &room = view.history[client.newestTick & (snapshotHistory - 1)];
+    static thread_local vector<int> cells;
+    if (view.occupancyTick != room.tick) {
+        view.occupied.assign(room.width * room.height, 0);
+        for (const SnapshotSnake &snake : room.snakes) {
+            snapshotCells(snake, room.width, cells);
+            for (int cell : cells) {
+                view.occupied[cell] = 1;
+            }
+        }
+        view.occupancyTick = room.tick;
+    }
+    const SnapshotSnake *own = nullptr;
+    for (const SnapshotSnake &snake : room.snakes) {
+        if (snake.player == client.player) {
+            own = &snake;
+        }
+    }
+    if (!own || !own->alive) {
+        return client.direction;
+    }
+    snapshotCells(*own, room.width, cells);
+    int headX = cells.back() % room.width, headY = cells.back() / room.width;
+    int best = client.direction, bestDistance = INT32_MAX;
+    for (int direction = Up; direction <= Right; ++direction) {
+        int x = headX + moveDX[direction], y = headY + moveDY[direction];
+        if (direction == oppositeDirection(own->direction) || x < 0 || y < 0 || x >= room.width || y >= room.height ||
+            view.occupied[y * room.width + x]) {
+            continue;
+        }
+        int distance = room.width + room.height;
+        for (uint16_t fruit : room.fruits) {
+            distance = min(distance, abs(fruit % room.width - x) + abs(fruit / room.width - y));
+        }
+        if (distance < bestDistance) {
+            best = direction;
+            bestDistance = distance;
+        }
+    }
+    return (uint8_t) best;
+}
+
+/**
+ Handles one datagram from the server
+ @param run The stage
+ @param thread The client's thread
+ @param index The client in the thread
+ @param packet The datagram
+ @param now When it arrived
+ */
+static void receive(LoadRun &run, LoadThread &thread, int index, sf::Packet &packet, sf::Time now) {
+    LoadClient &client = thread.clients[index];
+    bool measuring = run.measuring.load();
+    uint8_t type = 0;
+    packet >> type;
+    if (type == MessageWelcome && client.player < 0) {
+        uint8_t id = 0;
+        packet >> id;
+        client.player = id;
+        client.lastState = now;
+        client.nextDecision = now + sf::seconds(float(-log(1 - uniform(thread.rng)) / run.options->inputsPerSecond));
+        run.joined.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+    if (type != MessageState || client.player < 0 || packet.getDataSize() < 5) {
+        return;
+    }
+    const uint8_t *bytes = (const uint8_t *) packet.getData();
+    uint32_t tick = ((uint32_t) bytes[1] << 24) | ((uint32_t) bytes[2] << 16) | ((uint32_t) bytes[3] << 8) | bytes[4];
+    if (measuring) {
+        thread.stats.states++;
+        thread.stats.stateBytes += (long) packet.getDataSize();
+        thread.stats.intervals.add((now - client.lastState).asMicroseconds() / 1000.0);
+    }
+    client.lastState = now;
+    if (client.newestTick != 0 && (int32_t) (tick - client.newestTick) <= 0) {
+        return;
+    }
+
+    //Another player of the room may have decoded this tick already
+    RoomView &view = *thread.rooms[client.room / run.threadCount];
+    RoomSnapshot &slot = view.history[tick & (snapshotHistory - 1)];
+    if (slot.tick != tick || slot.width == 0) {
+        static thread_local RoomSnapshot incoming;
+        if (!readSnapshot(packet, view.history, incoming)) {
+            thread.stats.undecodable += measuring;
+            return; //Not acknowledged, so the server falls back to a keyframe
+        }
+        swap(slot, incoming);
+    }
+    client.newestTick = tick;
+
+    for (const SnapshotSnake &snake : slot.snakes) {
+        if (snake.player != client.player) {
+            continue;
+        }
+        //Every input up to the one the server used is acknowledged by this state
+        for (uint32_t sequence = client.ackedSequence + 1; (int32_t) (snake.inputSequence - sequence) >= 0; ++sequence) {
+            sf::Time sent = client.sentAt[sequence & (sentInputs - 1)];
+            if (measuring && client.inputSequence - sequence < (uint32_t) sentInputs && sent >= run.measureStart) {
+                thread.stats.acked++;
+                thread.stats.ackLatency.add((now - sent).asMicroseconds() / 1000.0);
+            }
+        }
+        if ((int32_t) (snake.inputSequence - client.ackedSequence) > 0) {
+            client.ackedSequence = snake.inputSequence;
+        }
+        if (snake.inputSequence == client.inputSequence) {
+            client.direction = snake.direction; //A new life faces its spawn direction
+        }
+    }
+    sendInput(run, thread, index, now);
+}
+
+/**
+ Runs one load thread's players until the stage stops
+ @param run The stage
+ @param thread The thread
+ */
+static void loadLoop(LoadRun &run, LoadThread &thread) {
+    const LoadOptions &options = *run.options;
+    const sf::Time tickLength = sf::milliseconds(options.tickMs);
+    sf::Packet packet;
+    uint8_t buffer[65536];
+    while (!run.stopping.load(memory_order_relaxed)) {
+        bool busy = false;
+        for (int i = 0; i < (int) thread.clients.size(); ++i) {
+            LoadClient &client = thread.clients[i];
+            sf::Time now = run.clock.getElapsedTime();
+            if (client.player < 0 && now.asMilliseconds() >= client.joinAtMs && now >= client.nextJoin) {
+                sf::Packet join;
+                join << MessageJoin << protocolVersion << (uint32_t) client.room;
+                sendToServer(run, thread, i, join, now);
+                client.nextJoin = now + sf::milliseconds(joinRetryMs);
+            }
+
+            ssize_t size;
+            while ((size = recv(client.socket, buffer, sizeof(buffer), 0)) > 0) {
+                busy = true;
+                now = run.clock.getElapsedTime();
+                if (options.loss > 0 && uniform(thread.rng) < options.loss) {
+                    continue;
+                }
+                if (options.latencyMs > 0 || options.jitterMs > 0) {
+                    double delayMs = options.latencyMs + options.jitterMs * uniform(thread.rng);
+                    thread.delayed.push(Delayed{now + sf::microseconds((sf::Int64) (delayMs * 1000)), i, false,
+                                                vector<uint8_t>(buffer, buffer + size)});
+                    continue;
+                }
+                packet.clear();
+                packet.append(buffer, (size_t) size);
+                receive(run, thread, i, packet, now);
+            }
+
+            if (client.player < 0) {
+                continue;
+            }
+            if (now >= client.nextDecision) {
+                //Decisions come as a Poisson process at the input rate
+                client.nextDecision = now + sf::seconds(float(-log(1 - uniform(thread.rng)) / options.inputsPerSecond));
+                uint8_t direction = client.direction;
+                if (options.fruitPolicy) {
+                    if (client.newestTick != 0) {
+                        direction = fruitDirection(*thread.rooms[client.room / run.threadCount], client);
+                    }
+                } else {
+                    direction = (uint8_t) ((client.direction & 2) ^ 2) | (nextRandom(thread.rng) & 1); //A quarter turn either way
+                }
+                if (direction != client.direction) {
+                    client.direction = direction;
+                    client.inputSequence++;
+                    client.sentAt[client.inputSequence & (sentInputs - 1)] = now;
+                    thread.stats.inputs += run.measuring.load();
+                    sendInput(run, thread, i, now);
+                }
+            }
+            if (now - client.lastSent >= tickLength) {
+                sendInput(run, thread, i, now); //Keeps the player from timing out without states
+            }
+        }
+
+        sf::Time now = run.clock.getElapsedTime();
+        while (!thread.delayed.empty() && thread.delayed.top().due <= now) {
+            const Delayed &message = thread.delayed.top();
+            if (message.outgoing) {
+                sendto(thread.clients[message.client].socket, message.bytes.data(), message.bytes.size(), 0,
+                       (const sockaddr *) &run.server, sizeof(run.server));
+            } else {
+                packet.clear();
+                packet.append(message.bytes.data(), message.bytes.size());
+                receive(run, thread, message.client, packet, message.due);
+            }
+            thread.delayed.pop();
+            busy = true;
+        }
+        if (!busy) {
+            sf::sleep(sf::milliseconds(1));
+        }
+    }
+
+    //Leaving right away frees the server's rooms for the next stage
+    for (LoadClient &client : thread.clients) {
+        if (client.player >= 0) {
+            sf::Packet leave;
+            leave << MessageLeave << (uint8_t) client.player;
+            sendto(client.socket, leave.getData(), leave.getDataSize(), 0, (const sockaddr *) &run.server, sizeof(run.server));
+        }
+        close(client.socket);
+    }
+}
+
+/**
+ Opens a non-blocking UDP socket on a loopback address
+ @param address The address in host byte order
+ @return The socket, or -1
+ */
+static int openClientSocket(uint32_t address) {
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    sockaddr_in local = {};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(address);
+    local.sin_port = 0;
+    if (::bind(fd, (const sockaddr *) &local, sizeof(local)) != 0) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+/**
+ Runs one stage: starts a server unless one was given, joins the players, measures
+ and prints the results
+ @param options The settings
+ @param players Number of simulated players
+ @return False if the sockets or the server could not be opened
+ */
+static bool runStage(const LoadOptions &options, int players) {
+    int rooms = (players + options.roomSize - 1) / options.roomSize;
+    unique_ptr<GameServer> server;
+    sf::IpAddress serverAddress = sf::IpAddress::LocalHost;
+    unsigned short serverPort = options.serverPort;
+    if (options.serverHost.empty()) {
+        server.reset(new GameServer(40, 30, options.tickMs, options.seed, rooms, options.workers));
+        string error;
+        if (!server->start(0, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return false;
+        }
+        serverPort = server->port();
+    } else {
+        serverAddress = sf::IpAddress(options.serverHost);
+    }
+
+    LoadRun run;
+    run.options = &options;
+    run.server = {};
+    run.server.sin_family = AF_INET;
+    run.server.sin_addr.s_addr = htonl(serverAddress.toInteger());
+    run.server.sin_port = htons(serverPort);
+    run.threadCount = max(1, min(options.threads > 0 ? options.threads : (int) thread::hardware_concurrency(), rooms));
+
+    //Whole rooms go to one thread, so the thread can share their decoded states
+    vector<unique_ptr<LoadThread>> threads;
+    for (int t = 0; t < run.threadCount; ++t) {
+        threads.emplace_back(new LoadThread());
+        threads.back()->rng = options.seed * 0x9E3779B97F4A7C15ULL + t + 1;
+        threads.back()->rooms.resize((rooms - t + run.threadCount - 1) / run.threadCount);
+        for (unique_ptr<RoomView> &view : threads.back()->rooms) {
+            view.reset(new RoomView());
+        }
+    }
+    for (int i = 0; i < players; ++i) {
+        int socket = openClientSocket(0x7F000001 + i / playersPerAddress);
+        if (socket < 0) {
+            fprintf(stderr, "Could not open socket %d of %d: %s\n", i + 1, players, strerror(errno));
+            for (unique_ptr<LoadThread> &thread : threads) {
+                for (LoadClient &client : thread->clients) {
+                    close(client.socket);
+                }
+            }
+            return false;
+        }
+        LoadClient client;
+        client.socket = socket;
+        client.room = i / options.roomSize;
+        client.joinAtMs = (int32_t) ((long) i * 1000 / options.joinRate);
+        threads[client.room % run.threadCount]->clients.push_back(client);
+    }
+
+    printf("%d players in %d rooms, %d load threads%s\n", players, rooms, run.threadCount,
+           server ? (", server in process with " + to_string(server->workerCount()) + " workers").c_str() : "");
+    fflush(stdout);
+    for (unique_ptr<LoadThread> &thread : threads) {
+        LoadThread *owned = thread.get();
+        thread->worker = std::thread([&run, owned] { loadLoop(run, *owned); });
+    }
+
+    //Measure once everyone is in, or once joining stops making progress
+    sf::Time joinDeadline = sf::milliseconds((int32_t) ((long) players * 1000 / options.joinRate) + 10000);
+    while (run.joined.load() < players && run.clock.getElapsedTime() < joinDeadline) {
+        sf::sleep(sf::milliseconds(50));
+    }
+    sf::Time joinTime = run.clock.getElapsedTime();
+    int joined = run.joined.load();
+    sf::sleep(sf::milliseconds(warmUpMs));
+    vector<WorkerStats> before;
+    for (int i = 0; server && i < server->workerCount(); ++i) {
+        before.push_back(server->workerStats(i));
+    }
+    run.measureStart = run.clock.getElapsedTime();
+    run.measuring = true;
+    sf::sleep(sf::seconds((float) options.seconds));
+    run.measuring = false;
+    vector<WorkerStats> after;
+    for (int i = 0; server && i < server->workerCount(); ++i) {
+        after.push_back(server->workerStats(i));
+    }
+    run.stopping = true;
+    for (unique_ptr<LoadThread> &thread : threads) {
+        thread->worker.join();
+    }
+    if (server) {
+        server->stop();
+    }
+
+    LoadStats total;
+    for (unique_ptr<LoadThread> &thread : threads) {
+        total.states += thread->stats.states;
+        total.stateBytes += thread->stats.stateBytes;
+        total.inputs += thread->stats.inputs;
+        total.acked += thread->stats.acked;
+        total.undecodable += thread->stats.undecodable;
+        total.intervals.merge(thread->stats.intervals);
+        total.ackLatency.merge(thread->stats.ackLatency);
+    }
+    printf("  joined         %d of %d in %.1f s\n", joined, players, joinTime.asSeconds());
+    if (server) {
+        long tickHistogram[tickHistogramBuckets] = {}, lateHistogram[tickHistogramBuckets] = {};
+        long ticks = 0, keyframes = 0, packetsOut = 0;
+        for (size_t i = 0; i < after.size(); ++i) {
+            ticks += after[i].ticks - before[i].ticks;
+            keyframes += after[i].keyframes - before[i].keyframes;
+            packetsOut += after[i].packetsOut - before[i].packetsOut;
+            for (int b = 0; b < tickHistogramBuckets; ++b) {
+                tickHistogram[b] += after[i].histogram[b] - before[i].histogram[b];
+                lateHistogram[b] += after[i].lateHistogram[b] - before[i].lateHistogram[b];
+            }
+        }
+        printf("  server tick    %ld room ticks, p50 %ld us, p99 %ld us, max %ld us\n", ticks,
+               GameServer::percentileUs(tickHistogram, 0.5), GameServer::percentileUs(tickHistogram, 0.99),
+               GameServer::percentileUs(tickHistogram, 1.0));
+        printf("  tick jitter    late by p50 %ld us, p99 %ld us, max %ld us\n", GameServer::percentileUs(lateHistogram, 0.5),
+               GameServer::percentileUs(lateHistogram, 0.99), GameServer::percentileUs(lateHistogram, 1.0));
+        printf("  keyframes      %ld of %ld states sent\n", keyframes, packetsOut);
+    }
+    printf("  state interval p50 %.1f ms, p99 %.1f ms, p99.9 %.1f ms (tick %d ms)\n", total.intervals.percentile(0.5),
+           total.intervals.percentile(0.99), total.intervals.percentile(0.999), options.tickMs);
+    double seconds = options.seconds;
+    printf("  bandwidth      %ld states, %.1f bytes/state, %.2f kbit/s per player, %.1f Mbit/s total\n", total.states,
+           total.states ? double(total.stateBytes) / total.states : 0.0, joined ? total.stateBytes * 8 / 1000.0 / seconds / joined : 0.0,
+           total.stateBytes * 8 / 1e6 / seconds);
+    printf("  input to ack   %ld inputs, %ld acked, p50 %.1f ms, p90 %.1f ms, p99 %.1f ms\n", total.inputs, total.acked,
+           total.ackLatency.percentile(0.5), total.ackLatency.percentile(0.9), total.ackLatency.percentile(0.99));
+    if (total.undecodable) {
+        printf("  undecodable    %ld states had no baseline\n", total.undecodable);
+    }
+    fflush(stdout);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    LoadOptions options;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--players" && hasValue) {
+            options.players.clear();
+            for (char *item = argv[++i]; *item;) {
+                options.players.push_back((int) strtol(item, &item, 10));
+                item += (*item == ',');
+            }
+        } else if (arg == "--seconds" && hasValue) {
+            options.seconds = atoi(argv[++i]);
+        } else if (arg == "--room-size" && hasValue) {
+            options.roomSize = atoi(argv[++i]);
+        } else if (arg == "--tick-ms" && hasValue) {
+            options.tickMs = atoi(argv[++i]);
+        } else if (arg == "--policy" && hasValue) {
+            string policy = argv[++i];
+            options.fruitPolicy = policy == "fruit";
+            if (policy != "fruit" && policy != "random") {
+                fprintf(stderr, "Unknown policy %s\n", policy.c_str());
+                return 1;
+            }
+        } else if (arg == "--inputs-per-second" && hasValue) {
+            options.inputsPerSecond = atof(argv[++i]);
+        } else if (arg == "--latency-ms" && hasValue) {
+            options.latencyMs = atof(argv[++i]);
+        } else if (arg == "--jitter-ms" && hasValue) {
+            options.jitterMs = atof(argv[++i]);
+        } else if (arg == "--loss" && hasValue) {
+            options.loss = atof(argv[++i]);
+        } else if (arg == "--threads" && hasValue) {
+            options.threads = atoi(argv[++i]);
+        } else if (arg == "--workers" && hasValue) {
+            options.workers = atoi(argv[++i]);
+        } else if (arg == "--join-rate" && hasValue) {
+            options.joinRate = atoi(argv[++i]);
+        } else if (arg == "--server" && hasValue) {
+            options.serverHost = argv[++i];
+            size_t colon = options.serverHost.rfind(':');
+            if (colon != string::npos) {
+                options.serverPort = (unsigned short) atoi(options.serverHost.c_str() + colon + 1);
+                options.serverHost.erase(colon);
+            }
+        } else if (arg == "--seed" && hasValue) {
+            options.seed = strtoull(argv[++i], nullptr, 10);
+        } else {
+            fprintf(stderr, "Usage: snake_load [--players N[,N...]] [--seconds N] [--room-size N] [--tick-ms MS]\n"
+                            "                  [--policy random|fruit] [--inputs-per-second R] [--latency-ms MS]\n"
+                            "                  [--jitter-ms MS] [--loss P] [--threads N] [--workers N]\n"
+                            "                  [--join-rate N] [--server HOST[:PORT]] [--seed S]\n");
+            return 1;
+        }
+    }
+    if (options.roomSize < 1 || options.roomSize > roomPlayers || options.tickMs < 1 || options.inputsPerSecond <= 0 ||
+        options.joinRate < 1 || options.seconds < 1) {
+        fprintf(stderr, "Rooms take 1 to %d players; the tick, input rate, join rate and time must be positive\n", roomPlayers);
+        return 1;
+    }
+
+    //One socket per player
+    rlimit files;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+        getrlimit(RLIMIT_NOFILE, &files);
+    }
+    for (int players : options.players) {
+        if (players < 1) {
+            continue;
+        }
+        if ((rlim_t) players + 64 > files.rlim_cur) {
+            printf("%d players: skipped, the open-file limit is %llu\n", players, (unsigned long long) files.rlim_cur);
+            continue;
+        }
+        if (!runStage(options, players)) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,169 @@
+//Headless room server. Players join with `sfml_testing --connect HOST[:PORT] --room N`;
+//up to 64 share each room's board. Rooms are spread over worker threads, one per core
+//unless --workers says otherwise. Spectators watch with `sfml_testing --watch
+//HOST[:PORT] --room N` on the TCP --spectator-port. Prints every worker's counters and
+//tick times every few seconds and a summary when stopped with Ctrl-C or after
+//--seconds seconds.
+//
+//Usage: snake_server [--port N] [--spectator-port N] [--tick-ms MS] [--width N]
+//                    [--height N] [--seed S] [--rooms N] [--workers N] [--seconds N]
+
+#include "game_server.hpp"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+const int reportMs = 5000; //Time between printed counters
+
+static volatile sig_atomic_t interrupted = 0;
+
+/**
+ Stops the server on Ctrl-C
+ @param signal The signal number
+ */
+static void stopServer(int /*signal*/) {
+    interrupted = 1;
+}
+
+/**
+ Subtracts two snapshots of a worker's counters
+ @param now The counters now
+ @param last The counters earlier
+ @return The counts in between; the room counts are the ones now
+ */
+static WorkerStats since(const WorkerStats &now, const WorkerStats &last) {
+    WorkerStats delta = now;
+    delta.ticks -= last.ticks;
+    delta.packetsIn -= last.packetsIn;
+    delta.packetsOut -= last.packetsOut;
+    delta.bytesOut -= last.bytesOut;
+    delta.keyframes -= last.keyframes;
+    for (int i = 0; i < tickHistogramBuckets; ++i) {
+        delta.histogram[i] -= last.histogram[i];
+        delta.lateHistogram[i] -= last.lateHistogram[i];
+    }
+    return delta;
+}
+
+/**
+ Prints every worker's counters since the last call
+ @param server The server
+ @param last The counters at the last call, updated
+ */
+static void printStats(const GameServer &server, vector<WorkerStats> &last) {
+    for (int i = 0; i < server.workerCount(); ++i) {
+        WorkerStats now = server.workerStats(i);
+        WorkerStats delta = since(now, last[i]);
+        if (delta.ticks > 0 || delta.packetsIn > 0) {
+            printf("worker %d  rooms %d/%d  players %d  ticks %ld  in %ld  out %ld  %.1f bytes/state  %ld keyframes  tick p50 %ld us, p99 %ld us, max %ld us  late p99 %ld us\n",
+                   i, now.activeRooms, now.rooms, now.players, delta.ticks, delta.packetsIn, delta.packetsOut,
+                   delta.packetsOut ? double(delta.bytesOut) / delta.packetsOut : 0.0, delta.keyframes,
+                   GameServer::percentileUs(delta.histogram, 0.5), GameServer::percentileUs(delta.histogram, 0.99),
+                   GameServer::percentileUs(delta.histogram, 1.0), GameServer::percentileUs(delta.lateHistogram, 0.99));
+        }
+        last[i] = now;
+    }
+    SpectatorStats spectators = server.spectatorStats();
+    if (spectators.viewers > 0) {
+        printf("spectators %d  frames %ld in, %ld sent, %ld skipped  %ld resyncs  %.1f MB sent\n", spectators.viewers,
+               spectators.framesIn, spectators.framesSent, spectators.framesSkipped, spectators.resyncs, spectators.bytesSent / 1e6);
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+    int port = defaultServerPort;
+    int spectatorPort = defaultSpectatorPort;
+    int tickMs = defaultTickMs;
+    int width = 40;
+    int height = 30;
+    uint64_t seed = (uint64_t) time(0);
+    int rooms = 1;
+    int workers = 0;
+    long seconds = 0;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--port" && hasValue) {
+            port = atoi(argv[++i]);
+        } else if (arg == "--spectator-port" && hasValue) {
+            spectatorPort = atoi(argv[++i]);
+        } else if (arg == "--tick-ms" && hasValue) {
+            tickMs = atoi(argv[++i]);
+        } else if (arg == "--width" && hasValue) {
+            width = atoi(argv[++i]);
+        } else if (arg == "--height" && hasValue) {
+            height = atoi(argv[++i]);
+        } else if (arg == "--seed" && hasValue) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--rooms" && hasValue) {
+            rooms = atoi(argv[++i]);
+        } else if (arg == "--workers" && hasValue) {
+            workers = atoi(argv[++i]);
+        } else if (arg == "--seconds" && hasValue) {
+            seconds = atol(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: snake_server [--port N] [--spectator-port N] [--tick-ms MS] [--width N]\n"
+                            "                    [--height N] [--seed S] [--rooms N] [--workers N] [--seconds N]\n");
+            return 1;
+        }
+    }
+    //Cells are sent as 16-bit numbers
+    if (width < 4 || height < 4 || width * height > 65535 || tickMs < 1 || rooms < 1) {
+        fprintf(stderr, "The board must be at least 4x4 and at most 65535 cells, a tick at least 1 ms, and there must be a room\n");
+        return 1;
+    }
+
+    GameServer server(width, height, tickMs, seed, rooms, workers);
+    string error;
+    if (!server.start((unsigned short) port, error) || !server.startSpectators((unsigned short) spectatorPort, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    printf("Serving %d rooms of %dx%d on UDP port %d, %d ms per tick, %d workers; spectators on TCP port %d\n", rooms, width,
+           height, server.port(), tickMs, server.workerCount(), server.spectatorPort());
+    fflush(stdout);
+
+    //The server runs on its own threads; this one only reports
+    vector<WorkerStats> last(server.workerCount());
+    for (int i = 0; i < server.workerCount(); ++i) {
+        last[i] = server.workerStats(i);
+    }
+    vector<WorkerStats> first = last;
+    chrono::steady_clock::time_point started = chrono::steady_clock::now();
+    chrono::steady_clock::time_point nextReport = started + chrono::milliseconds(reportMs);
+    while (!interrupted && (seconds == 0 || chrono::steady_clock::now() - started < chrono::seconds(seconds))) {
+        this_thread::sleep_for(chrono::milliseconds(100));
+        if (chrono::steady_clock::now() >= nextReport) {
+            printStats(server, last);
+            nextReport += chrono::milliseconds(reportMs);
+        }
+    }
+    server.stop();
+
+    long ticks = 0, packetsIn = 0, packetsOut = 0;
+    WorkerStats total = {};
+    for (int i = 0; i < server.workerCount(); ++i) {
+        WorkerStats delta = since(server.workerStats(i), first[i]);
+        ticks += delta.ticks;
+        packetsIn += delta.packetsIn;
+        packetsOut += delta.packetsOut;
+        for (int b = 0; b < tickHistogramBuckets; ++b) {
+            total.histogram[b] += delta.histogram[b];
+            total.lateHistogram[b] += delta.lateHistogram[b];
+        }
+    }
+    printf("%ld room ticks, %ld packets in, %ld out, tick p50 %ld us, p99 %ld us, late p99 %ld us\n", ticks, packetsIn,
+           packetsOut, GameServer::percentileUs(total.histogram, 0.5), GameServer::percentileUs(total.histogram, 0.99),
+           GameServer::percentileUs(total.lateHistogram, 0.99));
+    return 0;
+}
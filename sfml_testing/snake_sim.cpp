@@ -0,0 +1,712 @@
+//Headless tournament runner. Plays many games per bot policy on every core and
+//prints the score distribution, mean length, how the games ended and throughput.
+//Each game gets its own seed, so for the policies that decide from the state alone
+//(bfs, cycle, heuristic, net, random, multi and arena) the results are the same for any thread count.
+//mcts searches for a wall-clock time per move and the channel waits on another process,
+//so their results also depend on the machine's load and vary from run to run.
+//
+//Usage: snake_sim [--games N] [--threads N] [--seed S] [--move-ms MS] [--max-ticks N]
+//                 [--mcts-ms MS] [--weights FILE] [--heuristic-weights FILE] [--record PREFIX]
+//                 [--bot FILE.so] [--channel NAME] [--scaling] [--write-golden FILE]
+//                 [--check-golden FILE] [policy...]
+//Policies: bfs, cycle, heuristic, mcts, net, random, multi, arena (default: bfs cycle
+//random). multi plays a MultiGame of 8 snakes moving at random and arena a small Arena
+//of 64 snakes steered by its bots, both for a fixed number of ticks and putting dead
+//snakes back, and report the snakes' scores and lengths added up. The net
+//policy needs a weights file for PolicyNet; the heuristic policy uses its default
+//weights unless given a file written by snake_tune. Every --bot loads a bot library
+//built against snake_bot.h and adds it as a policy named after the file, which must not
+//be a built-in policy's name, "channel" or another bot's. --channel creates a
+//shared-memory channel (bot_channel.h) and adds the "channel" policy, played on one
+//thread by whichever snake_channel_bot connects, with move-ms as the deadline for every
+//answer. --record writes every step to trajectory chunk files named
+//PREFIX-<policy>-t<thread>-<chunk>.traj for offline training.
+//
+//--write-golden FILE saves a digest of every tick of every game, folded per game, with
+//a checkpoint of the running digest every 256 ticks, and --check-golden FILE replays the
+//same games and fails if any of them differs, naming the first 256 ticks that differ.
+//Run the check on each kind of machine: it passes only if the whole engine works out
+//every state exactly the same there. The file holds the seed, move time, tick limit and
+//game count, so the check needs nothing else. Only the policies that decide from the
+//state alone go in: bfs, cycle, heuristic (default weights), random, multi and arena.
+
+#include "game_state.hpp"
+#include "arena.hpp"
+#include "autopilot.hpp"
+#include "bot_channel.hpp"
+#include "hamiltonian.hpp"
+#include "heuristic_bot.hpp"
+#include "mcts.hpp"
+#include "multi_game.hpp"
+#include "plugin_bot.hpp"
+#include "policy_net.hpp"
+#include "thread_pool.hpp"
+#include "trajectory.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+const char *const builtinPolicies[] = {"arena", "bfs", "channel", "cycle", "heuristic", "mcts", "multi", "net", "random"}; //Names a --bot cannot take
+const char *const goldenPolicies[] = {"bfs", "cycle", "heuristic", "random", "multi", "arena"}; //Policies that play the same game every time
+const int goldenCheckpointTicks = 256; //Ticks between the checkpoints of a golden file
+const int multiTicks = 2000; //Length of a multi game, unless --max-ticks is lower
+const int arenaTicks = 1000; //Length of an arena game, unless --max-ticks is lower
+
+//How one game ended
+struct GameResult {
+    int score;
+    int length;
+    int ticks;
+    int endFlag; //The Step flag that ended the game
+    uint64_t digest; //Every tick's stateDigest, folded in order
+    vector<uint32_t> checkpoints; //Low half of the digest every goldenCheckpointTicks, for golden files
+};
+
+//Settings shared by all games
+struct SimOptions {
+    int games = 1000;
+    int threads = 0; //0 uses one per core
+    uint64_t seed = 1;
+    int moveMs = 300; //Game time per move, which moves the special fruit
+    int maxTicks = 20000; //Stops bots that circle forever without eating
+    int mctsMs = 1; //Search time per move for the MCTS bot
+    PolicyNet net; //Loaded from --weights for the net policy
+    HeuristicWeights heuristic; //Loaded from --heuristic-weights for the heuristic policy
+    map<string, unique_ptr<PluginBot>> plugins; //Loaded from --bot, by policy name
+    unique_ptr<BotChannel> channel; //Created by --channel
+    string recordPrefix; //Empty when not recording trajectories
+    bool scaling = false;
+    string goldenPath; //Golden file to write or check, empty for neither
+    bool checkGolden = false; //Check against goldenPath instead of writing it
+};
+
+//What a golden file expects of one game
+struct GoldenGame {
+    int ticks;
+    uint64_t digest;
+    vector<uint32_t> checkpoints;
+};
+
+//Everything one worker thread needs to play games without sharing with the others
+struct Worker {
+    Autopilot autopilot;
+    unique_ptr<ThreadPool> searchThreads; //Single-thread pool for the MCTS bot
+    unique_ptr<MctsBot> mcts;
+    PolicyNet net; //Own copy, since evaluation uses the net's scratch buffers
+    const PluginBot *plugin = nullptr; //Set when playing a bot library
+    TrajectoryWriter trajectory; //Only used with --record
+    bool recording = false;
+    bool recordFailed = false; //Set when a chunk could not be written
+    uint64_t rng; //Used by the random policy
+};
+
+/**
+ Picks a random move that does not end the game straight away, if there is one
+ @param state The game state
+ @param rng The random number generator
+ @return The direction to move in
+ */
+static int randomDecide(const GameState &state, uint64_t &rng) {
+    int safe[4];
+    int safeCount = 0;
+    for (int direction = 0; direction < 4; ++direction) {
+        int x = cellX(state.headCell) + moveDX[direction];
+        int y = cellY(state.headCell) + moveDY[direction];
+        if (direction == oppositeDirection(state.direction) || x < 0 || x >= gridWidth || y < 0 || y >= gridHeight) {
+            continue;
+        }
+        if (!isOccupied(state, x, y) || cellAt(x, y) == state.tailCell) {
+            safe[safeCount++] = direction;
+        }
+    }
+    return (safeCount == 0) ? state.direction : safe[nextRandom(rng) % safeCount];
+}
+
+/**
+ Folds one tick's state hash into a game's digest, adding a checkpoint when one is due
+ @param digest The game's digest so far
+ @param hash The state hash after the tick
+ @param ticks Ticks played, this one included
+ @param checkpoints Receives the checkpoints when writing or checking a golden file
+ @param options The run settings
+ */
+static void foldDigest(uint64_t &digest, uint64_t hash, int ticks, vector<uint32_t> &checkpoints, const SimOptions &options) {
+    digest = (digest ^ hash) * 0x100000001B3ull;
+    if (!options.goldenPath.empty() && ticks % goldenCheckpointTicks == 0) {
+        checkpoints.push_back((uint32_t) digest);
+    }
+}
+
+/**
+ Plays one game to the end with a policy
+ @param policy The policy name
+ @param worker The calling thread's bots and generator
+ @param seed The game's seed
+ @param options The run settings
+ @return How the game ended
+ */
+static GameResult playGame(const string &policy, Worker &worker, uint64_t seed, const SimOptions &options) {
+    GameState game;
+    newGame(game, seed);
+    worker.rng = seed ^ 0x5DEECE66Dull;
+    int ticks = 0;
+    uint64_t digest = stateDigest(game);
+    vector<uint32_t> checkpoints;
+    uint32_t observation[obsBitWords];
+    while (game.gameOver == 0 && ticks < options.maxTicks) {
+        if (worker.recording) {
+            writeStateBitPlanes(game, observation);
+        }
+        int direction;
+        if (policy == "bfs") {
+            direction = worker.autopilot.decide(game);
+        } else if (policy == "cycle") {
+            direction = hamiltonianDecide(game);
+        } else if (policy == "mcts") {
+            direction = worker.mcts->decide(game, options.mctsMs, options.moveMs);
+        } else if (policy == "net") {
+            direction = worker.net.decide(game);
+        } else if (policy == "heuristic") {
+            direction = heuristicDecide(game, options.heuristic);
+        } else if (worker.plugin) {
+            direction = worker.plugin->decide(game);
+        } else if (policy == "channel") {
+            direction = options.channel->decide(game, options.moveMs * 1000);
+        } else {
+            direction = randomDecide(game, worker.rng);
+        }
+        int scoreBefore = game.score;
+        stepGame(game, direction, options.moveMs);
+        ticks++;
+        foldDigest(digest, stateDigest(game), ticks, checkpoints, options);
+        if (worker.recording) {
+            bool truncated = (game.gameOver == 0 && ticks == options.maxTicks);
+            worker.recordFailed |= !worker.trajectory.append(observation, (uint8_t) direction, game.score - scoreBefore, truncated ? StepTimedOut : game.gameOver);
+        }
+    }
+    return {game.score, game.length, ticks, (game.gameOver != 0) ? game.gameOver : StepTimedOut, digest, move(checkpoints)};
+}
+
+/**
+ Plays a MultiGame of 8 snakes making random moves that do not run into a wall or a
+ snake, putting dead snakes back every tick, for a fixed number of ticks
+ @param seed The game's seed
+ @param options The run settings
+ @return The scores and lengths of all the snakes added up, and the digest
+ */
+static GameResult playMultiGame(uint64_t seed, const SimOptions &options) {
+    MultiGame game(32, 24, 8, 8, seed);
+    uint64_t rng = seed ^ 0x5DEECE66Dull;
+    int ticks = 0;
+    uint64_t digest = game.stateHash();
+    vector<uint32_t> checkpoints;
+    uint8_t directions[8];
+    uint8_t events[8];
+    while (ticks < min(options.maxTicks, multiTicks)) {
+        for (int i = 0; i < game.snakeCount(); ++i) {
+            const MultiSnake &snake = game.snake(i);
+            int safe[4];
+            int safeCount = 0;
+            for (int direction = 0; direction < 4 && snake.alive; ++direction) {
+                int x = snake.headCell() % game.width() + moveDX[direction];
+                int y = snake.headCell() / game.width() + moveDY[direction];
+                if (direction == oppositeDirection(snake.direction) || x < 0 || x >= game.width() || y < 0 || y >= game.height()) {
+                    continue;
+                }
+                int owner = game.ownerAt(y * game.width() + x);
+                if (owner == 0 || owner == fruitOwner) {
+                    safe[safeCount++] = direction;
+                }
+            }
+            directions[i] = (uint8_t) ((safeCount == 0) ? snake.direction : safe[nextRandom(rng) % safeCount]);
+        }
+        game.step(directions, events);
+        for (int i = 0; i < game.snakeCount(); ++i) {
+            if (!game.snake(i).alive) {
+                game.spawnSnake(i);
+            }
+        }
+        ticks++;
+        foldDigest(digest, game.stateHash(), ticks, checkpoints, options);
+    }
+    int score = 0, length = 0;
+    for (int i = 0; i < game.snakeCount(); ++i) {
+        score += game.snake(i).score;
+        length += game.snake(i).length;
+    }
+    return {score, length, ticks, StepTimedOut, digest, move(checkpoints)};
+}
+
+/**
+ Plays a small Arena of 64 snakes steered by its own bots, putting dead snakes back
+ every tick, for a fixed number of ticks
+ @param seed The game's seed
+ @param options The run settings
+ @return The scores and lengths of all the snakes added up, and the digest
+ */
+static GameResult playArenaGame(uint64_t seed, const SimOptions &options) {
+    Arena arena(128, 128, 64, 64, 4, seed);
+    int ticks = 0;
+    uint64_t digest = arena.stateHash();
+    vector<uint32_t> checkpoints;
+    vector<uint8_t> directions(arena.snakeCount());
+    vector<uint8_t> events(arena.snakeCount());
+    while (ticks < min(options.maxTicks, arenaTicks)) {
+        arena.steerBots(directions.data(), nullptr);
+        arena.step(directions.data(), events.data(), nullptr);
+        for (int i = 0; i < arena.snakeCount(); ++i) {
+            if (!arena.snake(i).alive) {
+                arena.spawnSnake(i);
+            }
+        }
+        ticks++;
+        foldDigest(digest, arena.stateHash(), ticks, checkpoints, options);
+    }
+    int score = 0, length = 0;
+    for (int i = 0; i < arena.snakeCount(); ++i) {
+        score += arena.snake(i).score;
+        length += (int) arena.snake(i).length;
+    }
+    return {score, length, ticks, StepTimedOut, digest, move(checkpoints)};
+}
+
+/**
+ Plays every game of one policy on a pool
+ @param policy The policy name
+ @param threadCount Number of threads to use
+ @param options The run settings
+ @param results Filled with one result per game, in game order
+ @param record True to write trajectories if --record was given
+ @return Wall-clock seconds taken
+ */
+static double runPolicy(const string &policy, int threadCount, const SimOptions &options, vector<GameResult> &results, bool record) {
+    ThreadPool pool(threadCount);
+    vector<unique_ptr<Worker>> workers(pool.size());
+    for (int i = 0; i < pool.size(); ++i) {
+        workers[i] = make_unique<Worker>();
+        if (policy == "mcts") {
+            workers[i]->searchThreads = make_unique<ThreadPool>(1);
+            workers[i]->mcts = make_unique<MctsBot>(*workers[i]->searchThreads, 1 << 16, options.seed + i);
+        }
+        if (policy == "net") {
+            workers[i]->net = options.net;
+        }
+        auto plugin = options.plugins.find(policy);
+        if (plugin != options.plugins.end()) {
+            workers[i]->plugin = plugin->second.get();
+        }
+        if (record && !options.recordPrefix.empty()) {
+            workers[i]->trajectory.open(options.recordPrefix + "-" + policy + "-t" + to_string(i));
+            workers[i]->recording = true;
+        }
+    }
+    results.assign(options.games, GameResult());
+    auto start = chrono::steady_clock::now();
+    pool.parallelFor(options.games, [&](int game, int thread) {
+        uint64_t seed = options.seed * 1000003 + game;
+        if (policy == "multi") {
+            results[game] = playMultiGame(seed, options);
+        } else if (policy == "arena") {
+            results[game] = playArenaGame(seed, options);
+        } else {
+            results[game] = playGame(policy, *workers[thread], seed, options);
+        }
+    });
+    for (unique_ptr<Worker> &worker : workers) {
+        //Closing writes the last chunk, so it goes first
+        if (worker->recording && (!worker->trajectory.close() || worker->recordFailed)) {
+            fprintf(stderr, "Could not write trajectories for %s: some chunks are missing\n", policy.c_str());
+        }
+    }
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ Returns a percentile of sorted values
+ @param sorted The values in increasing order
+ @param percent The percentile, 0 to 100
+ @return The value at that percentile
+ */
+static int percentile(const vector<int> &sorted, int percent) {
+    return sorted[(sorted.size() - 1) * percent / 100];
+}
+
+/**
+ Prints the statistics for one policy
+ @param policy The policy name
+ @param results One result per game
+ @param seconds Wall-clock seconds the games took
+ @param threadCount Number of threads used
+ */
+static void printReport(const string &policy, const vector<GameResult> &results, double seconds, int threadCount) {
+    vector<int> scores;
+    long totalScore = 0, totalLength = 0, totalTicks = 0;
+    int walls = 0, selfHits = 0, cleared = 0, timeouts = 0;
+    for (const GameResult &result : results) {
+        scores.push_back(result.score);
+        totalScore += result.score;
+        totalLength += result.length;
+        totalTicks += result.ticks;
+        walls += (result.endFlag == StepHitWall);
+        selfHits += (result.endFlag == StepHitSelf);
+        cleared += (result.endFlag == StepBoardFull);
+        timeouts += (result.endFlag == StepTimedOut);
+    }
+    sort(scores.begin(), scores.end());
+    double games = (double) results.size();
+
+    printf("%s: %zu games on %d threads\n", policy.c_str(), results.size(), threadCount);
+    printf("  score   mean %.1f  min %d  p10 %d  median %d  p90 %d  max %d\n", totalScore / games, scores.front(),
+           percentile(scores, 10), percentile(scores, 50), percentile(scores, 90), scores.back());
+    printf("  length  mean %.1f   ticks per game %.1f\n", totalLength / games, totalTicks / games);
+    printf("  ended   wall %d  self %d  board full %d  tick limit %d\n", walls, selfHits, cleared, timeouts);
+    printf("  speed   %.0f games/s  %.0f ticks/s  (%.2f s)\n", games / seconds, totalTicks / seconds, seconds);
+}
+
+/**
+ Runs one policy with 1, 2, 4, ... threads up to every core and prints the speed-up
+ @param policy The policy name
+ @param options The run settings
+ */
+static void printScaling(const string &policy, const SimOptions &options) {
+    int cores = max(1, (int) thread::hardware_concurrency());
+    vector<int> counts;
+    for (int threads = 1; threads < cores; threads *= 2) {
+        counts.push_back(threads);
+    }
+    counts.push_back(cores);
+
+    printf("  scaling:\n");
+    double baseRate = 0;
+    for (int threads : counts) {
+        vector<GameResult> results;
+        double seconds = runPolicy(policy, threads, options, results, false);
+        long ticks = 0;
+        for (const GameResult &result : results) {
+            ticks += result.ticks;
+        }
+        double rate = ticks / seconds;
+        if (baseRate == 0) {
+            baseRate = rate;
+        }
+        printf("    %3d threads  %10.0f ticks/s  x%.2f\n", threads, rate, rate / baseRate);
+    }
+}
+
+/**
+ Checks whether a policy name belongs to the runner
+ @param policy The policy name
+ @return True for the built-in policies and the channel
+ */
+static bool isBuiltinPolicy(const string &policy) {
+    for (const char *name : builtinPolicies) {
+        if (policy == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ Checks whether a policy plays the same way on every machine
+ @param policy The policy name
+ @return True for the policies golden files cover
+ */
+static bool isGoldenPolicy(const string &policy) {
+    for (const char *name : goldenPolicies) {
+        if (policy == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ Writes the header and each policy's games to a golden file
+ @param path The file
+ @param options The run settings, of which the seed, move time, tick limit and game count are kept
+ @param runs The results of each policy, in the order played
+ @return False if the file could not be written
+ */
+static bool writeGolden(const string &path, const SimOptions &options, const vector<pair<string, vector<GameResult>>> &runs) {
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    fprintf(file, "snake_sim golden 3 seed %" PRIu64 " move-ms %d max-ticks %d games %d\n", options.seed, options.moveMs,
+            options.maxTicks, options.games);
+    for (const pair<string, vector<GameResult>> &run : runs) {
+        for (size_t game = 0; game < run.second.size(); ++game) {
+            const GameResult &result = run.second[game];
+            fprintf(file, "%s %zu %d %016" PRIx64, run.first.c_str(), game, result.ticks, result.digest);
+            for (uint32_t checkpoint : result.checkpoints) {
+                fprintf(file, " %08" PRIx32, checkpoint);
+            }
+            fprintf(file, "\n");
+        }
+    }
+    return fclose(file) == 0;
+}
+
+/**
+ Reads a golden file written by writeGolden
+ @param path The file
+ @param options Receives the seed, move time, tick limit and game count
+ @param policies Receives the policies, in the file's order
+ @param expected Receives each policy's games
+ @return False if the file is missing or malformed
+ */
+static bool readGolden(const string &path, SimOptions &options, vector<string> &policies, map<string, vector<GoldenGame>> &expected) {
+    ifstream inFile(path);
+    string line, magic, word;
+    int version = 0;
+    if (!getline(inFile, line)) {
+        return false;
+    }
+    istringstream header(line);
+    header >> magic >> word >> version;
+    if (magic != "snake_sim" || word != "golden" || version != 3) {
+        return false;
+    }
+    string key;
+    while (header >> key) {
+        if (key == "seed") {
+            header >> options.seed;
+        } else if (key == "move-ms") {
+            header >> options.moveMs;
+        } else if (key == "max-ticks") {
+            header >> options.maxTicks;
+        } else if (key == "games") {
+            header >> options.games;
+        } else {
+            return false;
+        }
+    }
+    if (!header.eof() || options.games < 1) {
+        return false;
+    }
+    while (getline(inFile, line)) {
+        istringstream fields(line);
+        string policy, digest;
+        size_t game = 0;
+        GoldenGame expect;
+        if (!(fields >> policy >> game >> expect.ticks >> digest) || !isGoldenPolicy(policy)) {
+            return false;
+        }
+        expect.digest = strtoull(digest.c_str(), nullptr, 16);
+        string checkpoint;
+        while (fields >> checkpoint) {
+            expect.checkpoints.push_back((uint32_t) strtoul(checkpoint.c_str(), nullptr, 16));
+        }
+        if (expect.checkpoints.size() != (size_t) (expect.ticks / goldenCheckpointTicks)) {
+            return false;
+        }
+        vector<GoldenGame> &games = expected[policy];
+        if (games.empty()) {
+            policies.push_back(policy);
+        }
+        if (game != games.size()) {
+            return false; //Games must be listed in order
+        }
+        games.push_back(expect);
+    }
+    for (const string &policy : policies) {
+        if (expected[policy].size() != (size_t) options.games) {
+            return false;
+        }
+    }
+    return !policies.empty();
+}
+
+/**
+ Finds where a game first went another way than its golden copy, to the checkpoint
+ @param result The game as played
+ @param expected The game as the golden file has it
+ @return The first tick of the checkpoint interval in which the two first differ
+ */
+static int firstDifferentTick(const GameResult &result, const GoldenGame &expected) {
+    size_t shared = min(result.checkpoints.size(), expected.checkpoints.size());
+    size_t same = 0;
+    while (same < shared && result.checkpoints[same] == expected.checkpoints[same]) {
+        same++;
+    }
+    return (int) same * goldenCheckpointTicks + 1;
+}
+
+int main(int argc, char *argv[]) {
+    SimOptions options;
+    vector<string> policies;
+    bool weightsLoaded = false;
+    bool heuristicLoaded = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--games" && hasValue) {
+            options.games = max(1, atoi(argv[++i]));
+        } else if (arg == "--threads" && hasValue) {
+            options.threads = atoi(argv[++i]);
+        } else if (arg == "--seed" && hasValue) {
+            options.seed = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--move-ms" && hasValue) {
+            options.moveMs = atoi(argv[++i]);
+        } else if (arg == "--max-ticks" && hasValue) {
+            options.maxTicks = atoi(argv[++i]);
+        } else if (arg == "--mcts-ms" && hasValue) {
+            options.mctsMs = atoi(argv[++i]);
+        } else if (arg == "--weights" && hasValue) {
+            if (!options.net.loadFromFile(argv[++i])) {
+                fprintf(stderr, "Could not load policy weights from %s\n", argv[i]);
+                return 1;
+            }
+            weightsLoaded = true;
+        } else if (arg == "--heuristic-weights" && hasValue) {
+            if (!loadHeuristicWeights(argv[++i], options.heuristic)) {
+                fprintf(stderr, "Could not load heuristic weights from %s\n", argv[i]);
+                return 1;
+            }
+            heuristicLoaded = true;
+        } else if (arg == "--bot" && hasValue) {
+            //Named after the file without its directory and extension
+            string path = argv[++i];
+            string name = path.substr(path.find_last_of('/') + 1);
+            name = name.substr(0, name.find('.'));
+            if (name.empty() || isBuiltinPolicy(name) || options.plugins.count(name)) {
+                fprintf(stderr, "Cannot add bot %s: the policy name \"%s\" is %s\n", path.c_str(), name.c_str(),
+                        name.empty() ? "empty" : (isBuiltinPolicy(name) ? "built in" : "taken by an earlier --bot"));
+                return 1;
+            }
+            unique_ptr<PluginBot> plugin = make_unique<PluginBot>();
+            string error;
+            if (!plugin->load(path, error)) {
+                fprintf(stderr, "Could not load bot: %s\n", error.c_str());
+                return 1;
+            }
+            options.plugins[name] = move(plugin);
+            policies.push_back(name);
+        } else if (arg == "--channel" && hasValue) {
+            options.channel = make_unique<BotChannel>();
+            string error;
+            if (!options.channel->create(argv[++i], error)) {
+                fprintf(stderr, "Could not create channel: %s\n", error.c_str());
+                return 1;
+            }
+            policies.push_back("channel");
+        } else if (arg == "--record" && hasValue) {
+            options.recordPrefix = argv[++i];
+        } else if (arg == "--scaling") {
+            options.scaling = true;
+        } else if ((arg == "--write-golden" || arg == "--check-golden") && hasValue) {
+            options.goldenPath = argv[++i];
+            options.checkGolden = (arg == "--check-golden");
+        } else if (arg == "bfs" || arg == "cycle" || arg == "heuristic" || arg == "mcts" || arg == "net" || arg == "random" ||
+                   arg == "multi" || arg == "arena") {
+            policies.push_back(arg);
+        } else {
+            fprintf(stderr, "Unknown argument: %s\n", arg.c_str());
+            fprintf(stderr, "Usage: snake_sim [--games N] [--threads N] [--seed S] [--move-ms MS] [--max-ticks N]\n"
+                            "                 [--mcts-ms MS] [--weights FILE] [--heuristic-weights FILE] [--record PREFIX]\n"
+                            "                 [--bot FILE.so] [--channel NAME] [--scaling] [--write-golden FILE]\n"
+                            "                 [--check-golden FILE] [bfs|cycle|heuristic|mcts|net|random|multi|arena...]\n");
+            return 1;
+        }
+    }
+    map<string, vector<GoldenGame>> expected;
+    if (options.checkGolden) {
+        if (!policies.empty()) {
+            fprintf(stderr, "--check-golden plays the policies in the file\n");
+            return 1;
+        }
+        if (!readGolden(options.goldenPath, options, policies, expected)) {
+            fprintf(stderr, "Could not read golden file %s\n", options.goldenPath.c_str());
+            return 1;
+        }
+    } else if (policies.empty()) {
+        policies = options.goldenPath.empty() ? vector<string>{"bfs", "cycle", "random"} :
+                                                vector<string>(begin(goldenPolicies), end(goldenPolicies));
+    }
+    if (!options.goldenPath.empty()) {
+        for (const string &policy : policies) {
+            if (!isGoldenPolicy(policy)) {
+                fprintf(stderr, "The %s policy does not play the same game every time, so it cannot go in a golden file\n",
+                        policy.c_str());
+                return 1;
+            }
+        }
+        if (heuristicLoaded) {
+            fprintf(stderr, "Golden files are made with the heuristic policy's default weights\n");
+            return 1;
+        }
+    }
+    if (find(policies.begin(), policies.end(), "net") != policies.end() && !weightsLoaded) {
+        fprintf(stderr, "The net policy needs --weights FILE\n");
+        return 1;
+    }
+
+    vector<pair<string, vector<GameResult>>> runs;
+    int mismatches = 0;
+    for (const string &policy : policies) {
+        vector<GameResult> results;
+        int threadCount = (options.threads > 0) ? options.threads : max(1, (int) thread::hardware_concurrency());
+        if (policy == "channel") {
+            //One bot process answers one board at a time
+            threadCount = 1;
+            printf("Waiting for a bot to connect to the channel...\n");
+            fflush(stdout);
+            while (!options.channel->attached()) {
+                this_thread::sleep_for(chrono::milliseconds(10));
+            }
+        }
+        double seconds = runPolicy(policy, threadCount, options, results, true);
+        printReport(policy, results, seconds, threadCount);
+        if (policy == "channel") {
+            BotChannelStats stats = options.channel->stats();
+            printf("  channel %ld answers  %ld missed  round trip mean %.2f us  max %.1f us  (bot deciding %.2f us)\n",
+                   stats.decisions, stats.missed, stats.totalUs / max(stats.decisions, 1L), stats.maxUs,
+                   stats.botUs / max(stats.decisions, 1L));
+        } else if (options.scaling) {
+            printScaling(policy, options);
+        }
+
+        if (options.checkGolden) {
+            const vector<GoldenGame> &games = expected[policy];
+            long ticks = 0;
+            int differ = 0;
+            for (int game = 0; game < options.games; ++game) {
+                ticks += results[game].ticks;
+                if (results[game].ticks != games[game].ticks || results[game].digest != games[game].digest) {
+                    if (differ == 0) {
+                        int from = firstDifferentTick(results[game], games[game]);
+                        printf("  golden  game %d first differs between ticks %d and %d: %d ticks, digest %016" PRIx64
+                               ", expected %d ticks, digest %016" PRIx64 "\n",
+                               game, from, min(from + goldenCheckpointTicks - 1, max(results[game].ticks, games[game].ticks)),
+                               results[game].ticks, results[game].digest, games[game].ticks, games[game].digest);
+                    }
+                    differ++;
+                }
+            }
+            printf("  golden  %s: %d of %d games differ (%ld ticks checked)\n", differ ? "FAILED" : "ok", differ,
+                   options.games, ticks);
+            mismatches += differ;
+        }
+        runs.emplace_back(policy, move(results));
+    }
+    if (!options.goldenPath.empty() && !options.checkGolden) {
+        if (!writeGolden(options.goldenPath, options, runs)) {
+            fprintf(stderr, "Could not write golden file %s\n", options.goldenPath.c_str());
+            return 1;
+        }
+        printf("Wrote %s\n", options.goldenPath.c_str());
+    }
+    return mismatches > 0 ? 1 : 0;
+}
@@ -0,0 +1,544 @@
+//Exact solver for small boards. Works out the best possible expected score of the
+//game on a width x height board (up to 36 cells), where every new fruit lands on a
+//uniformly random free cell as placeFruit does, by searching every state the snake
+//can reach from the start. The special fruit is left out: its placement depends on
+//the move timer, which would multiply the states many times over for little value.
+//
+//A state is the head cell, the fruit cell, the last direction and the body as
+//2-bit moves from the head back to the tail, packed into one 128-bit key. States
+//are grouped by snake length. Eating always makes the snake longer, so the values
+//of length L only depend on length L + 1 (through eating) and on other states of
+//length L (through plain moves). The solver enumerates the levels forward from
+//the start, expanding each frontier on all threads, then solves them backward:
+//  value(s) = max over moves of  1 + mean value over fruit spots   (eating)
+//                                value(next)                      (plain move)
+//iterating the plain-move part to a fixed point within each level. Among moves
+//with the same expected score it prefers the fewest expected moves, so the solver
+//also reports how quickly perfect play gets there, which separates bots that all
+//clear the board.
+//
+//Usage: snake_solve [--width W] [--height H] [--threads N] [--max-states N]
+
+#include "game_state.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+using namespace std;
+
+typedef unsigned __int128 StateKey;
+
+const int maxSolveCells = 36; //Occupancy fits in 64 bits and the key in 128
+const uint32_t emptySlot = 0xFFFFFFFFu;
+
+//Board size being solved
+struct SmallBoard {
+    int width;
+    int height;
+    int cells;
+};
+
+//One reachable state, unpacked
+struct SnakeLayout {
+    int length;
+    int direction;
+    int fruit;
+    uint8_t body[maxSolveCells]; //Cells from the head to the tail
+    uint64_t occupied; //Bit c is set when the snake covers cell c
+};
+
+/**
+ Packs a state into a key
+ @param layout The state
+ @param board The board size
+ @return The key
+ */
+static StateKey packState(const SnakeLayout &layout, const SmallBoard &board) {
+    StateKey key = (StateKey) layout.length | ((StateKey) layout.direction << 6) | ((StateKey) layout.fruit << 8) | ((StateKey) layout.body[0] << 14);
+    int shift = 20;
+    for (int i = 1; i < layout.length; ++i) {
+        int from = layout.body[i - 1];
+        int to = layout.body[i];
+        int move = (to == from - board.width) ? Up : (to == from + board.width) ? Down : (to == from - 1) ? Left : Right;
+        key |= (StateKey) move << shift;
+        shift += 2;
+    }
+    return key;
+}
+
+/**
+ Unpacks a key into a state
+ @param key The key
+ @param board The board size
+ @param layout The state to fill in
+ */
+static void unpackState(StateKey key, const SmallBoard &board, SnakeLayout &layout) {
+    layout.length = (int) (key & 63);
+    layout.direction = (int) ((key >> 6) & 3);
+    layout.fruit = (int) ((key >> 8) & 63);
+    layout.body[0] = (uint8_t) ((key >> 14) & 63);
+    layout.occupied = 1ull << layout.body[0];
+    int shift = 20;
+    for (int i = 1; i < layout.length; ++i) {
+        int move = (int) ((key >> shift) & 3);
+        int offset = (move == Up) ? -board.width : (move == Down) ? board.width : (move == Left) ? -1 : 1;
+        layout.body[i] = (uint8_t) (layout.body[i - 1] + offset);
+        layout.occupied |= 1ull << layout.body[i];
+        shift += 2;
+    }
+}
+
+/**
+ Mixes a key into a table position
+ @param key The key
+ @return The hash
+ */
+static uint64_t hashKey(StateKey key) {
+    uint64_t low = (uint64_t) key;
+    uint64_t high = (uint64_t) (key >> 64);
+    return nextRandom(low) ^ (high * 0x9E3779B97F4A7C15ull);
+}
+
+//Expected result of playing perfectly from a state
+struct StateValue {
+    double score; //Expected fruits still to be eaten, -1 before any move has been looked at
+    double moves; //Expected moves taken to eat them
+};
+
+/**
+ Compares two values: a higher score wins, then fewer moves
+ @param a One value
+ @param b The other value
+ @return True if a is strictly better than b
+ */
+static bool betterValue(const StateValue &a, const StateValue &b) {
+    const double tolerance = 1e-9;
+    return a.score > b.score + tolerance || (a.score > b.score - tolerance && a.moves < b.moves - tolerance);
+}
+
+//All reachable states of one snake length: a hash table from key to state number,
+//and per-state arrays for the solve
+struct Level {
+    vector<StateKey> keys;
+    vector<uint32_t> slots; //Open addressing with linear probing, emptySlot where unused
+    vector<int32_t> successors; //Three per state: the plain moves that stay alive, -1 for none
+    vector<StateValue> moveValue; //Best value from eating or dying on the next move
+    vector<StateValue> value;
+
+    /**
+     Finds a state
+     @param key The key
+     @return The state number, or -1 if the state is not in the level
+     */
+    int64_t find(StateKey key) const {
+        if (slots.empty()) {
+            return -1;
+        }
+        size_t mask = slots.size() - 1;
+        for (size_t slot = hashKey(key) & mask;; slot = (slot + 1) & mask) {
+            if (slots[slot] == emptySlot) {
+                return -1;
+            }
+            if (keys[slots[slot]] == key) {
+                return slots[slot];
+            }
+        }
+    }
+
+    /**
+     Adds a state if it is not there yet
+     @param key The key
+     @return True if the state is new
+     */
+    bool insert(StateKey key) {
+        if ((keys.size() + 1) * 2 > slots.size()) {
+            grow();
+        }
+        size_t mask = slots.size() - 1;
+        for (size_t slot = hashKey(key) & mask;; slot = (slot + 1) & mask) {
+            if (slots[slot] == emptySlot) {
+                slots[slot] = (uint32_t) keys.size();
+                keys.push_back(key);
+                return true;
+            }
+            if (keys[slots[slot]] == key) {
+                return false;
+            }
+        }
+    }
+
+    /**
+     Doubles the table and puts every state back in
+     */
+    void grow() {
+        slots.assign(max((size_t) 1024, slots.size() * 2), emptySlot);
+        size_t mask = slots.size() - 1;
+        for (uint32_t index = 0; index < keys.size(); ++index) {
+            size_t slot = hashKey(keys[index]) & mask;
+            while (slots[slot] != emptySlot) {
+                slot = (slot + 1) & mask;
+            }
+            slots[slot] = index;
+        }
+    }
+
+    /**
+     Returns the bytes held by the level
+     @return The allocated size
+     */
+    size_t memoryBytes() const {
+        return keys.capacity() * sizeof(StateKey) + slots.capacity() * sizeof(uint32_t) + successors.capacity() * sizeof(int32_t) +
+               moveValue.capacity() * sizeof(StateValue) + value.capacity() * sizeof(StateValue);
+    }
+
+    /**
+     Frees everything
+     */
+    void release() {
+        vector<StateKey>().swap(keys);
+        vector<uint32_t>().swap(slots);
+        vector<int32_t>().swap(successors);
+        vector<StateValue>().swap(moveValue);
+        vector<StateValue>().swap(value);
+    }
+};
+
+//Where a move takes the snake
+struct MoveResult {
+    int outcome; //0 dies, 1 plain move, 2 eats, 3 eats and fills the board
+    SnakeLayout next; //The state after a plain move, or after eating with the fruit not yet placed
+};
+
+/**
+ Applies one move with the game's rules
+ @param layout The state
+ @param direction The move
+ @param board The board size
+ @return What happened and the new state
+ */
+static MoveResult applyMove(const SnakeLayout &layout, int direction, const SmallBoard &board) {
+    MoveResult result;
+    result.outcome = 0;
+    int head = layout.body[0];
+    int x = head % board.width + moveDX[direction];
+    int y = head / board.width + moveDY[direction];
+    if (x < 0 || x >= board.width || y < 0 || y >= board.height) {
+        return result;
+    }
+    int cell = y * board.width + x;
+    bool eats = (cell == layout.fruit);
+    int tail = layout.body[layout.length - 1];
+    if (((layout.occupied >> cell) & 1) && (eats || cell != tail)) {
+        return result;
+    }
+
+    SnakeLayout &next = result.next;
+    next.length = layout.length + (eats ? 1 : 0);
+    next.direction = direction;
+    next.fruit = layout.fruit;
+    next.body[0] = (uint8_t) cell;
+    copy(layout.body, layout.body + next.length - 1, next.body + 1);
+    next.occupied = 0;
+    for (int i = 0; i < next.length; ++i) {
+        next.occupied |= 1ull << next.body[i];
+    }
+    result.outcome = !eats ? 1 : (next.length == board.cells) ? 3 : 2;
+    return result;
+}
+
+//Solver for one board size
+class SmallBoardSolver {
+public:
+    SmallBoardSolver(const SmallBoard &board, ThreadPool &pool, long maxStates) : board(board), pool(pool), maxStates(maxStates) {
+        levels.resize(board.cells + 1);
+        totalStates = 0;
+        peakBytes = 0;
+    }
+
+    /**
+     Enumerates every reachable state and solves them
+     @param expected Receives the best expected score from the start, and the expected moves to reach it
+     @return False if the state limit was reached
+     */
+    bool solve(StateValue &expected) {
+        //The game starts with one segment in the middle moving right and the fruit anywhere else
+        SnakeLayout start;
+        start.length = 1;
+        start.direction = Right;
+        start.body[0] = (uint8_t) ((board.height / 2) * board.width + board.width / 2);
+        start.occupied = 1ull << start.body[0];
+        vector<StateKey> starts;
+        for (int fruit = 0; fruit < board.cells; ++fruit) {
+            if (fruit != start.body[0]) {
+                start.fruit = fruit;
+                starts.push_back(packState(start, board));
+                levels[1].insert(starts.back());
+            }
+        }
+
+        for (int length = 1; length < board.cells; ++length) {
+            if (!enumerateLevel(length)) {
+                return false;
+            }
+        }
+        for (int length = board.cells - 1; length >= 1; --length) {
+            solveLevel(length);
+            levels[length + 1].release(); //No longer needed
+        }
+
+        expected = {0.0, 0.0};
+        for (StateKey key : starts) {
+            const StateValue &value = levels[1].value[levels[1].find(key)];
+            expected.score += value.score / starts.size();
+            expected.moves += value.moves / starts.size();
+        }
+        return true;
+    }
+
+    /**
+     Returns the number of states found
+     @return The state count
+     */
+    long states() const {
+        return totalStates;
+    }
+
+    /**
+     Returns the largest amount of memory the levels held at once
+     @return Bytes
+     */
+    size_t peakMemory() const {
+        return peakBytes;
+    }
+
+    /**
+     Returns the number of states of one length
+     @param length The snake length
+     @return The state count
+     */
+    size_t levelStates(int length) const {
+        return levelCounts.size() > (size_t) length ? levelCounts[length] : 0;
+    }
+
+private:
+    /**
+     Finds every state of one length reachable by plain moves from the states already in
+     the level, and adds the states that eating leads to into the next level
+     @param length The snake length
+     @return False if the state limit was reached
+     */
+    bool enumerateLevel(int length) {
+        Level &level = levels[length];
+        Level &nextLevel = levels[length + 1];
+        vector<StateKey> frontier(level.keys);
+        int threads = pool.size();
+        vector<vector<StateKey>> sameLevel(threads);
+        vector<vector<StateKey>> eaten(threads);
+
+        while (!frontier.empty()) {
+            //Expand the frontier on every thread, then merge the results into the tables
+            pool.parallelFor(threads, [&](int part, int) {
+                size_t begin = frontier.size() * part / threads;
+                size_t end = frontier.size() * (part + 1) / threads;
+                sameLevel[part].clear();
+                eaten[part].clear();
+                for (size_t i = begin; i < end; ++i) {
+                    SnakeLayout layout;
+                    unpackState(frontier[i], board, layout);
+                    for (int direction = 0; direction < 4; ++direction) {
+                        if (direction == oppositeDirection(layout.direction)) {
+                            continue; //stepGame ignores reverse moves, so this is the same as going straight on
+                        }
+                        MoveResult result = applyMove(layout, direction, board);
+                        if (result.outcome == 1) {
+                            sameLevel[part].push_back(packState(result.next, board));
+                        } else if (result.outcome == 2) {
+                            for (int fruit = 0; fruit < board.cells; ++fruit) {
+                                if (!((result.next.occupied >> fruit) & 1)) {
+                                    result.next.fruit = fruit;
+                                    eaten[part].push_back(packState(result.next, board));
+                                }
+                            }
+                        }
+                    }
+                }
+            });
+            frontier.clear();
+            for (int part = 0; part < threads; ++part) {
+                for (StateKey key : sameLevel[part]) {
+                    if (level.insert(key)) {
+                        frontier.push_back(key);
+                    }
+                }
+                for (StateKey key : eaten[part]) {
+                    nextLevel.insert(key);
+                }
+            }
+            if ((long) (level.keys.size() + nextLevel.keys.size()) + totalStates > maxStates) {
+                return false;
+            }
+        }
+
+        totalStates += (long) level.keys.size();
+        levelCounts.resize(length + 1);
+        levelCounts[length] = level.keys.size();
+        peakBytes = max(peakBytes, currentBytes());
+        printf("  length %2d: %zu states\n", length, level.keys.size());
+        fflush(stdout);
+        return true;
+    }
+
+    /**
+     Works out the value of every state of one length, given the values of the next length
+     @param length The snake length
+     */
+    void solveLevel(int length) {
+        Level &level = levels[length];
+        const Level &nextLevel = levels[length + 1];
+        size_t count = level.keys.size();
+        level.successors.assign(count * 3, -1);
+        level.moveValue.assign(count, {-1.0, 0.0});
+        int chunks = (int) min((size_t) pool.size() * 16, max(count, (size_t) 1));
+
+        //Eating moves lead to the next level, plain moves to this one
+        pool.parallelFor(chunks, [&](int chunk, int) {
+            size_t begin = count * chunk / chunks;
+            size_t end = count * (chunk + 1) / chunks;
+            for (size_t i = begin; i < end; ++i) {
+                SnakeLayout layout;
+                unpackState(level.keys[i], board, layout);
+                int successorCount = 0;
+                for (int direction = 0; direction < 4; ++direction) {
+                    if (direction == oppositeDirection(layout.direction)) {
+                        continue;
+                    }
+                    MoveResult result = applyMove(layout, direction, board);
+                    StateValue option = {0.0, 1.0}; //Dying ends the game after this move
+                    if (result.outcome == 1) {
+                        level.successors[i * 3 + successorCount++] = (int32_t) level.find(packState(result.next, board));
+                        continue;
+                    } else if (result.outcome == 3) {
+                        option = {1.0, 1.0}; //The last fruit clears the board
+                    } else if (result.outcome == 2) {
+                        option = {1.0, 1.0};
+                        int spots = board.cells - result.next.length;
+                        for (int fruit = 0; fruit < board.cells; ++fruit) {
+                            if (!((result.next.occupied >> fruit) & 1)) {
+                                result.next.fruit = fruit;
+                                const StateValue &next = nextLevel.value[nextLevel.find(packState(result.next, board))];
+                                option.score += next.score / spots;
+                                option.moves += next.moves / spots;
+                            }
+                        }
+                    }
+                    if (betterValue(option, level.moveValue[i])) {
+                        level.moveValue[i] = option;
+                    }
+                }
+            }
+        });
+
+        //Plain moves: a state is worth the best eating value it can walk to, less the moves
+        //spent walking. Sweep until nothing changes, reading one copy of the values and
+        //writing the other. Every value comes from a real way of playing and only gets
+        //better, so the sweeps stop.
+        level.value = level.moveValue;
+        vector<StateValue> updated(level.value);
+        atomic<bool> changed(true);
+        while (changed) {
+            changed = false;
+            pool.parallelFor(chunks, [&](int chunk, int) {
+                size_t begin = count * chunk / chunks;
+                size_t end = count * (chunk + 1) / chunks;
+                bool chunkChanged = false;
+                for (size_t i = begin; i < end; ++i) {
+                    StateValue best = level.value[i];
+                    for (int k = 0; k < 3; ++k) {
+                        int32_t next = level.successors[i * 3 + k];
+                        if (next >= 0 && level.value[next].score >= 0) {
+                            StateValue option = {level.value[next].score, level.value[next].moves + 1.0};
+                            if (betterValue(option, best)) {
+                                best = option;
+                                chunkChanged = true;
+                            }
+                        }
+                    }
+                    updated[i] = best;
+                }
+                if (chunkChanged) {
+                    changed = true;
+                }
+            });
+            level.value.swap(updated);
+        }
+        peakBytes = max(peakBytes, currentBytes() + updated.capacity() * sizeof(StateValue));
+    }
+
+    /**
+     Adds up the memory held by every level
+     @return Bytes
+     */
+    size_t currentBytes() const {
+        size_t bytes = 0;
+        for (const Level &level : levels) {
+            bytes += level.memoryBytes();
+        }
+        return bytes;
+    }
+
+    SmallBoard board;
+    ThreadPool &pool;
+    long maxStates;
+    vector<Level> levels; //Indexed by snake length
+    vector<size_t> levelCounts;
+    long totalStates;
+    size_t peakBytes;
+};
+
+int main(int argc, char *argv[]) {
+    SmallBoard board = {4, 4, 16};
+    int threads = 0;
+    long maxStates = 200000000;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--width" && hasValue) {
+            board.width = atoi(argv[++i]);
+        } else if (arg == "--height" && hasValue) {
+            board.height = atoi(argv[++i]);
+        } else if (arg == "--threads" && hasValue) {
+            threads = atoi(argv[++i]);
+        } else if (arg == "--max-states" && hasValue) {
+            maxStates = atol(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: snake_solve [--width W] [--height H] [--threads N] [--max-states N]\n");
+            return 1;
+        }
+    }
+    board.cells = board.width * board.height;
+    if (board.width < 2 || board.height < 2 || board.cells > maxSolveCells) {
+        fprintf(stderr, "Boards from 2x2 up to %d cells can be solved\n", maxSolveCells);
+        return 1;
+    }
+
+    ThreadPool pool(threads);
+    SmallBoardSolver solver(board, pool, maxStates);
+    printf("Solving %dx%d on %d threads\n", board.width, board.height, pool.size());
+    auto start = chrono::steady_clock::now();
+    StateValue expected;
+    bool solved = solver.solve(expected);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (!solved) {
+        printf("Stopped after %ld states (--max-states %ld)\n", solver.states(), maxStates);
+        return 2;
+    }
+    printf("Best expected score: %.6f (board full at %d), in %.2f expected moves\n", expected.score, board.cells - 1, expected.moves);
+    printf("%ld states, peak memory %.1f MB, %.1f bytes per state, %.2f s\n", solver.states(), solver.peakMemory() / 1048576.0,
+           (double) solver.peakMemory() / max(solver.states(), 1L), seconds);
+    return 0;
+}
@@ -0,0 +1,290 @@
+//Genetic tuning of the heuristic bot's weights. Every generation plays each member
+//of the population on the same set of seeded games (common random numbers, so
+//differences in fitness come from the weights and not from luckier fruit), with
+//all member x game pairs handed out to the threads one at a time. The best members
+//carry over, the rest are bred by tournament selection, uniform crossover and
+//Gaussian mutation. The whole run is saved after every generation and picked up
+//again from that checkpoint when restarted.
+//
+//Usage: snake_tune [--generations N] [--population N] [--games N] [--threads N]
+//                  [--seed S] [--max-ticks N] [--checkpoint FILE] [--best FILE]
+
+#include "game_state.hpp"
+#include "heuristic_bot.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+const int eliteCount = 2; //Best members copied unchanged into the next generation
+const int tournamentSize = 3;
+const double mutationRate = 0.3; //Chance of mutating each weight
+const double mutationSize = 0.3; //Standard deviation of a mutation, relative to the weight (plus a small absolute part)
+
+//Settings for a tuning run
+struct TuneOptions {
+    int generations = 30;
+    int population = 24;
+    int games = 16; //Games per member per generation
+    int threads = 0; //0 uses one per core
+    uint64_t seed = 1;
+    int maxTicks = 5000;
+    string checkpointPath = "snake_tune.checkpoint";
+    string bestPath = "heuristic_weights.txt";
+};
+
+//One candidate set of weights
+struct Member {
+    double genes[heuristicWeightCount];
+    double fitness; //Mean score over the generation's games
+};
+
+//Everything needed to carry on a run
+struct TuneState {
+    int generation; //Number of generations finished
+    uint64_t rng; //Generator for selection, crossover and mutation
+    vector<Member> population;
+};
+
+/**
+ Turns a member's genes into bot weights
+ @param member The member
+ @return The weights
+ */
+static HeuristicWeights toWeights(const Member &member) {
+    HeuristicWeights weights;
+    weights.fruitDistance = member.genes[0];
+    weights.freeSpace = member.genes[1];
+    weights.tailDistance = member.genes[2];
+    weights.specialFruit = member.genes[3];
+    return weights;
+}
+
+/**
+ Returns a uniform random number in [0, 1)
+ @param rng The random number generator
+ @return The number
+ */
+static double randomUnit(uint64_t &rng) {
+    return (nextRandom(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ Returns a normally distributed random number (Box-Muller)
+ @param rng The random number generator
+ @return A number with mean 0 and standard deviation 1
+ */
+static double randomNormal(uint64_t &rng) {
+    double u = 1.0 - randomUnit(rng);
+    double v = randomUnit(rng);
+    return sqrt(-2.0 * log(u)) * cos(6.283185307179586 * v);
+}
+
+/**
+ Plays one game with a set of weights
+ @param weights The bot weights
+ @param seed The game's seed
+ @param maxTicks Moves after which the game is stopped
+ @return The score reached
+ */
+static int playGame(const HeuristicWeights &weights, uint64_t seed, int maxTicks) {
+    GameState game;
+    newGame(game, seed);
+    for (int tick = 0; tick < maxTicks && game.gameOver == 0; ++tick) {
+        stepGame(game, heuristicDecide(game, weights), 300);
+    }
+    return game.score;
+}
+
+/**
+ Plays every member on the same games and sets their fitness
+ @param state The run, whose generation number picks the games
+ @param options The run settings
+ @param pool The threads to play on
+ */
+static void evaluate(TuneState &state, const TuneOptions &options, ThreadPool &pool) {
+    int members = (int) state.population.size();
+    vector<int> scores((size_t) members * options.games);
+    uint64_t generationSeed = options.seed * 1000003 + state.generation;
+    pool.parallelFor(members * options.games, [&](int task, int) {
+        int member = task / options.games;
+        int game = task % options.games;
+        uint64_t gameSeed = generationSeed * 7919 + game; //The same for every member
+        scores[task] = playGame(toWeights(state.population[member]), gameSeed, options.maxTicks);
+    });
+    for (int member = 0; member < members; ++member) {
+        long total = 0;
+        for (int game = 0; game < options.games; ++game) {
+            total += scores[(size_t) member * options.games + game];
+        }
+        state.population[member].fitness = total / (double) options.games;
+    }
+}
+
+/**
+ Picks a parent: the fittest of a few random members
+ @param population The evaluated population
+ @param rng The random number generator
+ @return The chosen member
+ */
+static const Member &tournament(const vector<Member> &population, uint64_t &rng) {
+    const Member *best = &population[nextRandom(rng) % population.size()];
+    for (int i = 1; i < tournamentSize; ++i) {
+        const Member &other = population[nextRandom(rng) % population.size()];
+        if (other.fitness > best->fitness) {
+            best = &other;
+        }
+    }
+    return *best;
+}
+
+/**
+ Builds the next generation from an evaluated, sorted population
+ @param state The run
+ */
+static void breed(TuneState &state) {
+    vector<Member> next(state.population.begin(), state.population.begin() + min(eliteCount, (int) state.population.size()));
+    while (next.size() < state.population.size()) {
+        const Member &mother = tournament(state.population, state.rng);
+        const Member &father = tournament(state.population, state.rng);
+        Member child;
+        for (int gene = 0; gene < heuristicWeightCount; ++gene) {
+            child.genes[gene] = (nextRandom(state.rng) & 1) ? mother.genes[gene] : father.genes[gene];
+            if (randomUnit(state.rng) < mutationRate) {
+                child.genes[gene] += randomNormal(state.rng) * mutationSize * (fabs(child.genes[gene]) + 0.1);
+            }
+        }
+        child.fitness = 0;
+        next.push_back(child);
+    }
+    state.population = next;
+}
+
+/**
+ Writes the run to the checkpoint file, replacing it only once the new file is complete
+ @param state The run
+ @param path The checkpoint file
+ @return False if the file could not be written
+ */
+static bool saveCheckpoint(const TuneState &state, const string &path) {
+    string temporary = path + ".tmp";
+    {
+        ofstream outFile(temporary);
+        outFile.precision(17);
+        outFile << "snake_tune 1\n" << state.generation << " " << state.rng << " " << state.population.size() << "\n";
+        for (const Member &member : state.population) {
+            for (double gene : member.genes) {
+                outFile << gene << " ";
+            }
+            outFile << member.fitness << "\n";
+        }
+        if (!outFile) {
+            return false;
+        }
+    }
+    return rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+/**
+ Reads a run from a checkpoint file
+ @param path The checkpoint file
+ @param state The run to fill in
+ @return False if there is no valid checkpoint
+ */
+static bool loadCheckpoint(const string &path, TuneState &state) {
+    ifstream inFile(path);
+    string magic;
+    int version = 0;
+    size_t members = 0;
+    TuneState loaded;
+    if (!(inFile >> magic >> version >> loaded.generation >> loaded.rng >> members) || magic != "snake_tune" || version != 1 || members == 0) {
+        return false;
+    }
+    loaded.population.resize(members);
+    for (Member &member : loaded.population) {
+        for (double &gene : member.genes) {
+            inFile >> gene;
+        }
+        inFile >> member.fitness;
+    }
+    if (!inFile) {
+        return false;
+    }
+    state = loaded;
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    TuneOptions options;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--generations" && hasValue) {
+            options.generations = atoi(argv[++i]);
+        } else if (arg == "--population" && hasValue) {
+            options.population = max(eliteCount + 1, atoi(argv[++i]));
+        } else if (arg == "--games" && hasValue) {
+            options.games = max(1, atoi(argv[++i]));
+        } else if (arg == "--threads" && hasValue) {
+            options.threads = atoi(argv[++i]);
+        } else if (arg == "--seed" && hasValue) {
+            options.seed = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--max-ticks" && hasValue) {
+            options.maxTicks = atoi(argv[++i]);
+        } else if (arg == "--checkpoint" && hasValue) {
+            options.checkpointPath = argv[++i];
+        } else if (arg == "--best" && hasValue) {
+            options.bestPath = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: snake_tune [--generations N] [--population N] [--games N] [--threads N]\n"
+                            "                  [--seed S] [--max-ticks N] [--checkpoint FILE] [--best FILE]\n");
+            return 1;
+        }
+    }
+
+    TuneState state;
+    if (loadCheckpoint(options.checkpointPath, state)) {
+        printf("Resuming from %s after generation %d\n", options.checkpointPath.c_str(), state.generation);
+    } else {
+        //Start around the hand-tuned weights
+        state.generation = 0;
+        state.rng = options.seed ^ 0xC0FFEEull;
+        HeuristicWeights defaults;
+        double start[heuristicWeightCount] = {defaults.fruitDistance, defaults.freeSpace, defaults.tailDistance, defaults.specialFruit};
+        state.population.resize(options.population);
+        for (int i = 0; i < options.population; ++i) {
+            for (int gene = 0; gene < heuristicWeightCount; ++gene) {
+                state.population[i].genes[gene] = (i == 0) ? start[gene] : start[gene] * (0.25 + 1.5 * randomUnit(state.rng));
+            }
+            state.population[i].fitness = 0;
+        }
+    }
+
+    ThreadPool pool(options.threads);
+    while (state.generation < options.generations) {
+        evaluate(state, options, pool);
+        stable_sort(state.population.begin(), state.population.end(), [](const Member &a, const Member &b) {
+            return a.fitness > b.fitness;
+        });
+        const Member &best = state.population.front();
+        printf("generation %d  best %.2f  median %.2f  weights %.3f %.3f %.3f %.3f\n", state.generation, best.fitness,
+               state.population[state.population.size() / 2].fitness, best.genes[0], best.genes[1], best.genes[2], best.genes[3]);
+        fflush(stdout);
+        if (!saveHeuristicWeights(options.bestPath, toWeights(best))) {
+            fprintf(stderr, "Could not write %s\n", options.bestPath.c_str());
+        }
+
+        breed(state);
+        state.generation++;
+        if (!saveCheckpoint(state, options.checkpointPath)) {
+            fprintf(stderr, "Could not write checkpoint %s\n", options.checkpointPath.c_str());
+        }
+    }
+    return 0;
+}
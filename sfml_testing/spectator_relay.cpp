@@ -0,0 +1,229 @@
+//Spectator relay, see spectator_relay.hpp.
+
+#include "spectator_relay.hpp"
+
+#include <chrono>
+using namespace std;
+
+const int idleWaitMs = 20; //Longest the relay sleeps, which bounds how late it notices new viewers
+const int busyWaitMs = 1; //Sleep while a viewer's socket is full; there is no wait for writability
+
+SpectatorRelay::SpectatorRelay(int rooms)
+    : roomCount(max(1, rooms)), stopping(false), running(false), watcherCounts(new atomic<int>[max(1, rooms)]),
+      backlogs(max(1, rooms)), woken(false), sleeping(false), framesIn(0), framesSent(0), bytesSent(0), framesSkipped(0),
+      resyncs(0), viewerCount(0) {
+    for (int i = 0; i < roomCount; ++i) {
+        watcherCounts[i].store(0, memory_order_relaxed);
+    }
+}
+
+SpectatorRelay::~SpectatorRelay() {
+    stop();
+    while (Published *message = inbox.pop()) {
+        delete message;
+    }
+}
+
+bool SpectatorRelay::start(unsigned short port, string &error) {
+    if (running) {
+        return true;
+    }
+    if (listener.listen(port) != sf::Socket::Done) {
+        error = "could not listen on TCP port " + to_string(port);
+        return false;
+    }
+    listener.setBlocking(false);
+    stopping = false;
+    running = true;
+    relayThread = thread([this] { relayLoop(); });
+    return true;
+}
+
+void SpectatorRelay::stop() {
+    if (!running) {
+        return;
+    }
+    stopping = true;
+    {
+        lock_guard<mutex> hold(lock);
+        woken = true;
+    }
+    wake.notify_one();
+    relayThread.join();
+    for (Viewer &viewer : viewers) {
+        viewer.socket->disconnect();
+    }
+    viewers.clear();
+    for (int i = 0; i < roomCount; ++i) {
+        watcherCounts[i].store(0, memory_order_relaxed);
+    }
+    viewerCount = 0;
+    listener.close();
+    running = false;
+}
+
+int SpectatorRelay::watchers(uint32_t room) const {
+    return room < (uint32_t) roomCount ? watcherCounts[room].load(memory_order_relaxed) : 0;
+}
+
+void SpectatorRelay::publish(uint32_t room, shared_ptr<const SpectatorFrame> frame) {
+    if (room >= (uint32_t) roomCount) {
+        return;
+    }
+    inbox.push(new Published{{nullptr}, room, std::move(frame)});
+    framesIn.fetch_add(1, memory_order_relaxed);
+    //Same handshake as the server's workers: either the relay sees the frame before it
+    //sleeps, or this sees it sleeping
+    atomic_thread_fence(memory_order_seq_cst);
+    if (sleeping.load(memory_order_relaxed)) {
+        {
+            lock_guard<mutex> hold(lock);
+            woken = true;
+        }
+        wake.notify_one();
+    }
+}
+
+unsigned short SpectatorRelay::port() const {
+    return listener.getLocalPort();
+}
+
+SpectatorStats SpectatorRelay::stats() const {
+    return SpectatorStats{viewerCount.load(memory_order_relaxed), framesIn.load(memory_order_relaxed),
+                          framesSent.load(memory_order_relaxed), bytesSent.load(memory_order_relaxed),
+                          framesSkipped.load(memory_order_relaxed), resyncs.load(memory_order_relaxed)};
+}
+
+void SpectatorRelay::relayLoop() {
+    while (!stopping.load(memory_order_relaxed)) {
+        bool busy = false;
+        while (true) {
+            unique_ptr<sf::TcpSocket> socket(new sf::TcpSocket());
+            if (listener.accept(*socket) != sf::Socket::Done) {
+                break;
+            }
+            socket->setBlocking(false);
+            viewers.push_back(Viewer{std::move(socket), sf::Packet(), false, 0, {}, 0, false});
+            viewerCount.store((int) viewers.size(), memory_order_relaxed);
+            busy = true;
+        }
+
+        //Hand out the new frames; a room's backlog restarts at every keyframe
+        while (Published *message = inbox.pop()) {
+            vector<shared_ptr<const SpectatorFrame>> &backlog = backlogs[message->room];
+            if (message->frame->keyframe) {
+                backlog.clear();
+            }
+            if (!backlog.empty() || message->frame->keyframe) {
+                backlog.push_back(message->frame);
+            }
+            for (Viewer &viewer : viewers) {
+                if (viewer.subscribed && viewer.room == message->room) {
+                    enqueue(viewer, message->frame);
+                }
+            }
+            if (watcherCounts[message->room].load(memory_order_relaxed) == 0) {
+                backlog.clear(); //Nobody left to join mid-stream
+            }
+            delete message;
+            busy = true;
+        }
+
+        bool blocked = false;
+        for (size_t i = 0; i < viewers.size();) {
+            Viewer &viewer = viewers[i];
+            bool open = viewer.subscribed ? flush(viewer) : readRequest(viewer);
+            if (!open) {
+                if (viewer.subscribed) {
+                    watcherCounts[viewer.room].fetch_sub(1, memory_order_relaxed);
+                }
+                viewer.socket->disconnect();
+                viewers[i] = std::move(viewers.back());
+                viewers.pop_back();
+                viewerCount.store((int) viewers.size(), memory_order_relaxed);
+                continue;
+            }
+            blocked |= !viewer.queue.empty();
+            ++i;
+        }
+        if (busy) {
+            continue;
+        }
+
+        sleeping.store(true, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        unique_lock<mutex> hold(lock);
+        wake.wait_for(hold, chrono::milliseconds(blocked ? busyWaitMs : idleWaitMs), [this] { return woken; });
+        woken = false;
+        sleeping.store(false, memory_order_relaxed);
+    }
+}
+
+void SpectatorRelay::enqueue(Viewer &viewer, const shared_ptr<const SpectatorFrame> &frame) {
+    if (viewer.skipping) {
+        if (!frame->keyframe) {
+            framesSkipped.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+        viewer.skipping = false;
+    }
+    if (viewer.queue.size() >= (size_t) spectatorQueueFrames) {
+        //Fallen behind: drop what has not started going out and wait for a keyframe,
+        //unless this is one. A frame half written has to be finished first.
+        size_t keep = viewer.offset > 0 ? 1 : 0;
+        framesSkipped.fetch_add((long) (viewer.queue.size() - keep), memory_order_relaxed);
+        viewer.queue.resize(keep);
+        resyncs.fetch_add(1, memory_order_relaxed);
+        if (!frame->keyframe) {
+            viewer.skipping = true;
+            framesSkipped.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+    }
+    viewer.queue.push_back(frame);
+}
+
+bool SpectatorRelay::flush(Viewer &viewer) {
+    while (!viewer.queue.empty()) {
+        const vector<uint8_t> &bytes = viewer.queue.front()->bytes;
+        size_t sent = 0;
+        sf::Socket::Status status = viewer.socket->send(bytes.data() + viewer.offset, bytes.size() - viewer.offset, sent);
+        viewer.offset += sent;
+        bytesSent.fetch_add((long) sent, memory_order_relaxed);
+        if (status == sf::Socket::Done) {
+            viewer.queue.pop_front();
+            viewer.offset = 0;
+            framesSent.fetch_add(1, memory_order_relaxed);
+        } else if (status == sf::Socket::Partial || status == sf::Socket::NotReady) {
+            return true;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SpectatorRelay::readRequest(Viewer &viewer) {
+    sf::Socket::Status status = viewer.socket->receive(viewer.request);
+    if (status == sf::Socket::NotReady || status == sf::Socket::Partial) {
+        return true;
+    }
+    if (status != sf::Socket::Done) {
+        return false;
+    }
+    uint8_t type = 0;
+    uint32_t version = 0, room = 0;
+    viewer.request >> type >> version >> room;
+    if (!viewer.request || type != MessageWatch || version != protocolVersion || room >= (uint32_t) roomCount) {
+        return false;
+    }
+    viewer.subscribed = true;
+    viewer.room = room;
+    watcherCounts[room].fetch_add(1, memory_order_relaxed);
+    //Start from the room's last keyframe, or wait for the first one the room sends now
+    //that it is watched
+    const vector<shared_ptr<const SpectatorFrame>> &backlog = backlogs[room];
+    viewer.queue.assign(backlog.begin(), backlog.end());
+    viewer.skipping = backlog.empty();
+    return true;
+}
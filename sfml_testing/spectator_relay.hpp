@@ -0,0 +1,154 @@
+//Fan-out of room states to spectators over TCP. A watched room encodes one frame per
+//tick, a delta against the tick before or now and then a keyframe, and hands it to the
+//relay; the relay writes the same bytes to every viewer of the room, so a room costs one
+//encoding per tick however many watch it. Frames are shared by reference count and
+//freed once the last viewer has sent them.
+//
+//Each viewer has a bounded queue. A viewer whose queue fills up (a slow connection)
+//loses its queued deltas and skips ahead to the next keyframe; rooms never wait for
+//viewers. A new viewer starts with the room's last keyframe and the deltas since.
+
+#ifndef SPECTATOR_RELAY_HPP
+#define SPECTATOR_RELAY_HPP
+
+#include "mpsc_queue.hpp"
+#include "net_protocol.hpp"
+
+#include <SFML/Network.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+const int spectatorKeyframeTicks = 32; //Longest run of deltas between keyframes
+const int spectatorQueueFrames = 64; //Frames a viewer may have waiting before it skips ahead
+
+//One tick of a room, encoded once for all its viewers
+struct SpectatorFrame {
+    uint32_t tick;
+    bool keyframe;
+    std::vector<uint8_t> bytes; //A state message with the length prefix sf::TcpSocket puts on packets
+};
+
+//Counters of the relay
+struct SpectatorStats {
+    int viewers;
+    long framesIn; //Frames published by rooms
+    long framesSent; //Frames written to viewers
+    long bytesSent;
+    long framesSkipped; //Frames viewers skipped to catch up
+    long resyncs; //Times a viewer fell behind
+};
+
+class SpectatorRelay {
+public:
+    /**
+     Sets up a relay for rooms numbered from 0
+     @param rooms Number of rooms
+     */
+    explicit SpectatorRelay(int rooms);
+    ~SpectatorRelay();
+
+    SpectatorRelay(const SpectatorRelay &) = delete;
+    SpectatorRelay &operator=(const SpectatorRelay &) = delete;
+
+    /**
+     Starts listening for viewers on its own thread
+     @param port The TCP port, 0 for any free port
+     @param error Receives the reason when listening fails
+     @return False if the port could not be opened
+     */
+    bool start(unsigned short port, std::string &error);
+
+    /**
+     Disconnects every viewer and joins the thread; safe to call more than once
+     */
+    void stop();
+
+    /**
+     Counts a room's viewers; rooms nobody watches need not encode frames
+     @param room The room number
+     @return The number of viewers
+     */
+    int watchers(uint32_t room) const;
+
+    /**
+     Queues a room's frame for its viewers; safe from any thread
+     @param room The room number
+     @param frame The frame
+     */
+    void publish(uint32_t room, std::shared_ptr<const SpectatorFrame> frame);
+
+    unsigned short port() const;
+    SpectatorStats stats() const;
+
+private:
+    //A frame on its way from a room to the relay thread
+    struct Published {
+        std::atomic<Published *> next;
+        uint32_t room;
+        std::shared_ptr<const SpectatorFrame> frame;
+    };
+
+    //One connected spectator
+    struct Viewer {
+        std::unique_ptr<sf::TcpSocket> socket;
+        sf::Packet request; //The watch request while it arrives
+        bool subscribed;
+        uint32_t room;
+        std::deque<std::shared_ptr<const SpectatorFrame>> queue;
+        size_t offset; //Bytes of the front frame already written
+        bool skipping; //Waiting for a keyframe after falling behind
+    };
+
+    /**
+     Accepts viewers, hands out frames and writes them until stopped
+     */
+    void relayLoop();
+
+    /**
+     Gives a frame to one viewer, skipping ahead if its queue is full
+     @param viewer The viewer
+     @param frame The frame
+     */
+    void enqueue(Viewer &viewer, const std::shared_ptr<const SpectatorFrame> &frame);
+
+    /**
+     Writes as much of a viewer's queue as the socket takes
+     @param viewer The viewer
+     @return False if the viewer disconnected
+     */
+    bool flush(Viewer &viewer);
+
+    /**
+     Reads a viewer's watch request if it has arrived
+     @param viewer The viewer
+     @return False if the viewer disconnected or sent something else
+     */
+    bool readRequest(Viewer &viewer);
+
+    int roomCount;
+    sf::TcpListener listener;
+    std::thread relayThread;
+    std::atomic<bool> stopping;
+    bool running;
+    std::unique_ptr<std::atomic<int>[]> watcherCounts; //Viewers of each room
+    std::vector<std::vector<std::shared_ptr<const SpectatorFrame>>> backlogs; //Each room's last keyframe and the deltas since
+    std::vector<Viewer> viewers;
+    MpscQueue<Published> inbox;
+    std::mutex lock;
+    std::condition_variable wake;
+    bool woken;
+    std::atomic<bool> sleeping;
+
+    //Counters for stats()
+    std::atomic<long> framesIn, framesSent, bytesSent, framesSkipped, resyncs;
+    std::atomic<int> viewerCount;
+};
+
+#endif
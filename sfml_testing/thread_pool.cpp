@@ -0,0 +1,88 @@
+//Fixed set of worker threads, see thread_pool.hpp.
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+using namespace std;
+
+ThreadPool::ThreadPool(int threadCount) {
+    if (threadCount <= 0) {
+        threadCount = max(1, (int) thread::hardware_concurrency());
+    }
+    job = nullptr;
+    jobCount = 0;
+    nextTask = 0;
+    workersBusy = 0;
+    jobNumber = 0;
+    stopping = false;
+    for (int i = 1; i < threadCount; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (thread &worker : workers) {
+        worker.join();
+    }
+}
+
+int ThreadPool::size() const {
+    return (int) workers.size() + 1;
+}
+
+void ThreadPool::runTasks(int thread) {
+    while (true) {
+        int task = nextTask.fetch_add(1, memory_order_relaxed);
+        if (task >= jobCount) {
+            return;
+        }
+        (*job)(task, thread);
+    }
+}
+
+void ThreadPool::parallelFor(int count, const function<void(int, int)> &task) {
+    if (count <= 0) {
+        return;
+    }
+    {
+        lock_guard<mutex> guard(lock);
+        job = &task;
+        jobCount = count;
+        nextTask = 0;
+        workersBusy = (int) workers.size();
+        jobNumber++;
+    }
+    jobReady.notify_all();
+
+    runTasks(0); //The caller works on the job too
+
+    unique_lock<mutex> guard(lock);
+    jobDone.wait(guard, [this] { return workersBusy == 0; });
+    job = nullptr;
+}
+
+void ThreadPool::workerLoop(int thread) {
+    uint64_t lastJob = 0;
+    while (true) {
+        {
+            unique_lock<mutex> guard(lock);
+            jobReady.wait(guard, [&] { return stopping || jobNumber != lastJob; });
+            if (stopping) {
+                return;
+            }
+            lastJob = jobNumber;
+        }
+
+        runTasks(thread);
+
+        lock_guard<mutex> guard(lock);
+        if (--workersBusy == 0) {
+            jobDone.notify_one();
+        }
+    }
+}
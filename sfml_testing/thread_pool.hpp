@@ -0,0 +1,68 @@
+//Fixed set of worker threads for running headless games and bot searches in
+//parallel. Work is handed out as a parallel loop over task numbers; the thread
+//that calls parallelFor takes part too, so a pool of size N uses N threads.
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    /**
+     Starts the worker threads
+     @param threadCount Number of threads to use, counting the caller; 0 uses one per core
+     */
+    explicit ThreadPool(int threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     Returns the number of threads that run tasks, counting the caller
+     @return The thread count
+     */
+    int size() const;
+
+    /**
+     Runs task(i) for every i from 0 to count - 1 and waits until all of them are done.
+     Each thread passes its own number (0 for the caller) as the second argument, so tasks
+     can keep per-thread scratch space.
+     @param count The number of tasks
+     @param task The function to run for each task number
+     */
+    void parallelFor(int count, const std::function<void(int task, int thread)> &task);
+
+private:
+    /**
+     Takes task numbers from the current job until there are none left
+     @param thread The number of the thread running the tasks
+     */
+    void runTasks(int thread);
+
+    /**
+     Main loop of each worker thread: wait for a job, help run it, repeat
+     @param thread The worker's thread number, from 1
+     */
+    void workerLoop(int thread);
+
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable jobReady; //Signalled when a new job starts or the pool shuts down
+    std::condition_variable jobDone; //Signalled when the last worker leaves a job
+    const std::function<void(int, int)> *job; //The job being run, or null
+    int jobCount; //Number of tasks in the job
+    std::atomic<int> nextTask; //Next task number to hand out
+    int workersBusy; //Workers still running tasks from the current job
+    uint64_t jobNumber; //Increases with every job so workers can tell a new one has started
+    bool stopping;
+};
+
+#endif
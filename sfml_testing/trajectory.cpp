@@ -0,0 +1,221 @@
+//Columnar trajectory files, see trajectory.hpp.
+
+#include "trajectory.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+const char trajectoryMagic[8] = {'S', 'N', 'K', 'T', 'R', 'A', 'J', '1'};
+const size_t columnAlignment = 64;
+
+/**
+ Rounds a file offset up to the column alignment
+ @param offset The offset
+ @return The aligned offset
+ */
+static uint64_t alignColumn(uint64_t offset) {
+    return (offset + columnAlignment - 1) / columnAlignment * columnAlignment;
+}
+
+/**
+ Writes bytes and pads the file up to the next column boundary
+ @param file The open file
+ @param bytes The data
+ @param size Number of bytes
+ @param offset File offset before the write, advanced past the padding
+ @return False if the write failed
+ */
+static bool writeColumn(FILE *file, const void *bytes, size_t size, uint64_t &offset) {
+    static const char zeros[columnAlignment] = {};
+    size_t padding = alignColumn(offset + size) - (offset + size);
+    bool ok = fwrite(bytes, 1, size, file) == size && fwrite(zeros, 1, padding, file) == padding;
+    offset += size + padding;
+    return ok;
+}
+
+TrajectoryWriter::TrajectoryWriter() {
+    chunkRows = trajectoryChunkRows;
+    rows = 0;
+    chunks = 0;
+}
+
+TrajectoryWriter::~TrajectoryWriter() {
+    close();
+}
+
+void TrajectoryWriter::open(const string &newPrefix, int newChunkRows) {
+    close();
+    prefix = newPrefix;
+    chunkRows = max(1, newChunkRows);
+    rows = 0;
+    chunks = 0;
+    observations.resize((size_t) chunkRows * obsBitWords);
+    actions.resize(chunkRows);
+    rewards.resize(chunkRows);
+    dones.resize(chunkRows);
+}
+
+bool TrajectoryWriter::append(const uint32_t observation[], uint8_t action, int32_t reward, uint8_t done) {
+    memcpy(&observations[(size_t) rows * obsBitWords], observation, obsBitWords * sizeof(uint32_t));
+    actions[rows] = action;
+    rewards[rows] = reward;
+    dones[rows] = done;
+    rows++;
+    return rows < chunkRows || writeChunk();
+}
+
+bool TrajectoryWriter::close() {
+    return rows == 0 || writeChunk();
+}
+
+int TrajectoryWriter::chunksWritten() const {
+    return chunks;
+}
+
+bool TrajectoryWriter::writeChunk() {
+    char name[32];
+    snprintf(name, sizeof(name), "-%06d.traj", chunks);
+    FILE *file = fopen((prefix + name).c_str(), "wb");
+    if (!file) {
+        rows = 0;
+        return false;
+    }
+
+    TrajectoryChunkHeader header = {};
+    memcpy(header.magic, trajectoryMagic, 8);
+    header.rows = (uint32_t) rows;
+    header.boardWidth = gridWidth;
+    header.boardHeight = gridHeight;
+    header.observationWords = obsBitWords;
+    header.observationOffset = sizeof(header);
+    header.actionOffset = alignColumn(header.observationOffset + (uint64_t) rows * obsBitWords * sizeof(uint32_t));
+    header.rewardOffset = alignColumn(header.actionOffset + rows);
+    header.doneOffset = alignColumn(header.rewardOffset + (uint64_t) rows * sizeof(int32_t));
+
+    uint64_t offset = 0;
+    bool ok = writeColumn(file, &header, sizeof(header), offset) &&
+              writeColumn(file, observations.data(), (size_t) rows * obsBitWords * sizeof(uint32_t), offset) &&
+              writeColumn(file, actions.data(), rows, offset) &&
+              writeColumn(file, rewards.data(), (size_t) rows * sizeof(int32_t), offset) &&
+              writeColumn(file, dones.data(), rows, offset);
+    ok = (fclose(file) == 0) && ok;
+    rows = 0;
+    chunks++;
+    return ok;
+}
+
+TrajectoryChunk::TrajectoryChunk() {
+    data = nullptr;
+    size = 0;
+    header = nullptr;
+}
+
+TrajectoryChunk::~TrajectoryChunk() {
+    if (data) {
+        munmap(data, size);
+    }
+}
+
+bool TrajectoryChunk::open(const string &path) {
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(file, &info) != 0 || (size_t) info.st_size < sizeof(TrajectoryChunkHeader)) {
+        ::close(file);
+        return false;
+    }
+    void *mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, file, 0);
+    ::close(file); //The mapping keeps the file alive
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+
+    //Check that the header matches this board and every column lies inside the file
+    const TrajectoryChunkHeader *mappedHeader = (const TrajectoryChunkHeader *) mapped;
+    uint64_t rows = mappedHeader->rows;
+    if (memcmp(mappedHeader->magic, trajectoryMagic, 8) != 0 || mappedHeader->boardWidth != gridWidth ||
+        mappedHeader->boardHeight != gridHeight || mappedHeader->observationWords != (uint32_t) obsBitWords ||
+        mappedHeader->observationOffset + rows * obsBitWords * sizeof(uint32_t) > (uint64_t) info.st_size ||
+        mappedHeader->actionOffset + rows > (uint64_t) info.st_size ||
+        mappedHeader->rewardOffset + rows * sizeof(int32_t) > (uint64_t) info.st_size ||
+        mappedHeader->doneOffset + rows > (uint64_t) info.st_size || mappedHeader->rewardOffset % sizeof(int32_t) != 0) {
+        munmap(mapped, info.st_size);
+        return false;
+    }
+
+    if (data) {
+        munmap(data, size);
+    }
+    data = mapped;
+    size = info.st_size;
+    header = mappedHeader;
+    madvise(data, size, MADV_RANDOM); //Minibatches read scattered rows
+    return true;
+}
+
+int TrajectoryChunk::rows() const {
+    return header ? (int) header->rows : 0;
+}
+
+const uint32_t *TrajectoryChunk::observation(int row) const {
+    return (const uint32_t *) ((const char *) data + header->observationOffset) + (size_t) row * obsBitWords;
+}
+
+const uint8_t *TrajectoryChunk::actions() const {
+    return (const uint8_t *) data + header->actionOffset;
+}
+
+const int32_t *TrajectoryChunk::rewards() const {
+    return (const int32_t *) ((const char *) data + header->rewardOffset);
+}
+
+const uint8_t *TrajectoryChunk::dones() const {
+    return (const uint8_t *) data + header->doneOffset;
+}
+
+bool TrajectoryDataset::addChunk(const string &path) {
+    unique_ptr<TrajectoryChunk> chunk = make_unique<TrajectoryChunk>();
+    if (!chunk->open(path)) {
+        return false;
+    }
+    firstRow.push_back(totalRows);
+    totalRows += chunk->rows();
+    chunks.push_back(move(chunk));
+    return true;
+}
+
+long TrajectoryDataset::rows() const {
+    return totalRows;
+}
+
+void TrajectoryDataset::gather(const long indices[], int count, uint32_t observations[], uint8_t actions[], int32_t rewards[], uint8_t dones[]) const {
+    for (int i = 0; i < count; ++i) {
+        //The last chunk starting at or before the row holds it
+        size_t chunkIndex = upper_bound(firstRow.begin(), firstRow.end(), indices[i]) - firstRow.begin() - 1;
+        const TrajectoryChunk &chunk = *chunks[chunkIndex];
+        int row = (int) (indices[i] - firstRow[chunkIndex]);
+        memcpy(observations + (size_t) i * obsBitWords, chunk.observation(row), obsBitWords * sizeof(uint32_t));
+        actions[i] = chunk.actions()[row];
+        rewards[i] = chunk.rewards()[row];
+        dones[i] = chunk.dones()[row];
+    }
+}
+
+void TrajectoryDataset::sample(int count, uint64_t &rng, uint32_t observations[], uint8_t actions[], int32_t rewards[], uint8_t dones[]) const {
+    if (totalRows == 0) {
+        return;
+    }
+    vector<long> indices(count);
+    for (long &index : indices) {
+        //The full 64x64-bit product, since a dataset can hold more than 2^32 rows
+        index = (long) (((unsigned __int128) nextRandom(rng) * (uint64_t) totalRows) >> 64);
+    }
+    gather(indices.data(), count, observations, actions, rewards, dones);
+}
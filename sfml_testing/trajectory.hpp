@@ -0,0 +1,196 @@
+//Trajectory dataset for offline training. Steps (observation, action, reward, done)
+//are streamed into chunk files of fixed-width columns: a 64-byte header, then the
+//bit-packed observation planes of every row (obsBitWords words each, as written by
+//writeBitPlanes), then all actions, all rewards and all done flags, each column
+//starting on a 64-byte boundary. Readers map the chunks into memory and index the
+//columns directly, so sampling a minibatch is a few memcpy calls with no parsing.
+//
+//A done flag is 0 while the game goes on, the Step flag that ended it (StepHitWall,
+//StepHitSelf or StepBoardFull) on its last move, or StepTimedOut when the game was cut
+//off at a tick limit. A timed-out row is a truncation, not a terminal state: the game
+//could have gone on, so its value should still be bootstrapped from the next state.
+//
+//Writers are not shared between threads: give each thread its own file prefix.
+
+#ifndef TRAJECTORY_HPP
+#define TRAJECTORY_HPP
+
+#include "game_state.hpp"
+#include "batch_env.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+const int trajectoryChunkRows = 1 << 16; //Rows per chunk file, about 16 MB
+
+//First 64 bytes of every chunk file
+struct TrajectoryChunkHeader {
+    char magic[8]; //"SNKTRAJ1"
+    uint32_t rows;
+    uint16_t boardWidth;
+    uint16_t boardHeight;
+    uint32_t observationWords; //32-bit words per observation
+    uint32_t reserved; //Zero
+    uint64_t observationOffset; //Byte offsets of the columns from the start of the file
+    uint64_t actionOffset;
+    uint64_t rewardOffset;
+    uint64_t doneOffset;
+    uint64_t reserved2; //Zero, pads the header to 64 bytes
+};
+
+static_assert(sizeof(TrajectoryChunkHeader) == 64, "The chunk header must stay 64 bytes");
+
+class TrajectoryWriter {
+public:
+    TrajectoryWriter();
+    ~TrajectoryWriter();
+
+    TrajectoryWriter(const TrajectoryWriter &) = delete;
+    TrajectoryWriter &operator=(const TrajectoryWriter &) = delete;
+
+    /**
+     Starts writing chunks named <prefix>-000000.traj, <prefix>-000001.traj, ...
+     @param prefix Path and name shared by the chunk files
+     @param chunkRows Rows per chunk
+     */
+    void open(const std::string &prefix, int chunkRows = trajectoryChunkRows);
+
+    /**
+     Adds one step, writing a chunk file whenever one fills up
+     @param observation obsBitWords words describing the board before the action
+     @param action The direction played
+     @param reward Points scored by the move
+     @param done 0, the Step flag that ended the game on this move, or StepTimedOut if
+            the game was stopped at a tick limit after it
+     @return False if a chunk could not be written
+     */
+    bool append(const uint32_t observation[], uint8_t action, int32_t reward, uint8_t done);
+
+    /**
+     Writes the rows not yet written as a final, shorter chunk
+     @return False if the chunk could not be written
+     */
+    bool close();
+
+    /**
+     Returns the number of chunk files written so far
+     @return The chunk count
+     */
+    int chunksWritten() const;
+
+private:
+    /**
+     Writes the buffered rows as one chunk file and empties the buffers
+     @return False if the file could not be written
+     */
+    bool writeChunk();
+
+    std::string prefix;
+    int chunkRows;
+    int rows; //Rows buffered for the current chunk
+    int chunks;
+    std::vector<uint32_t> observations;
+    std::vector<uint8_t> actions;
+    std::vector<int32_t> rewards;
+    std::vector<uint8_t> dones;
+};
+
+//One chunk file mapped into memory
+class TrajectoryChunk {
+public:
+    TrajectoryChunk();
+    ~TrajectoryChunk();
+
+    TrajectoryChunk(const TrajectoryChunk &) = delete;
+    TrajectoryChunk &operator=(const TrajectoryChunk &) = delete;
+
+    /**
+     Maps a chunk file and checks its header
+     @param path The chunk file
+     @return False if the file is missing, truncated or for another board size
+     */
+    bool open(const std::string &path);
+
+    /**
+     Returns the number of rows
+     @return The row count
+     */
+    int rows() const;
+
+    /**
+     Returns one row's observation, straight from the mapped file
+     @param row The row
+     @return obsBitWords words
+     */
+    const uint32_t *observation(int row) const;
+
+    /**
+     Returns the action column
+     @return rows() actions
+     */
+    const uint8_t *actions() const;
+
+    /**
+     Returns the reward column
+     @return rows() rewards
+     */
+    const int32_t *rewards() const;
+
+    /**
+     Returns the done column
+     @return rows() done flags
+     */
+    const uint8_t *dones() const;
+
+private:
+    void *data; //The mapped file, or null
+    size_t size;
+    const TrajectoryChunkHeader *header;
+};
+
+//Set of chunk files that minibatches are sampled from
+class TrajectoryDataset {
+public:
+    /**
+     Maps one more chunk file
+     @param path The chunk file
+     @return False if the file could not be opened
+     */
+    bool addChunk(const std::string &path);
+
+    /**
+     Returns the number of rows over all chunks
+     @return The row count
+     */
+    long rows() const;
+
+    /**
+     Copies the rows with the given indices into column buffers
+     @param indices Row numbers from 0 to rows() - 1
+     @param count Number of rows
+     @param observations Room for count * obsBitWords words
+     @param actions Room for count actions
+     @param rewards Room for count rewards
+     @param dones Room for count done flags
+     */
+    void gather(const long indices[], int count, uint32_t observations[], uint8_t actions[], int32_t rewards[], uint8_t dones[]) const;
+
+    /**
+     Copies uniformly random rows into column buffers
+     @param count Number of rows
+     @param rng Random number generator, advanced once per row
+     @param observations Room for count * obsBitWords words
+     @param actions Room for count actions
+     @param rewards Room for count rewards
+     @param dones Room for count done flags
+     */
+    void sample(int count, uint64_t &rng, uint32_t observations[], uint8_t actions[], int32_t rewards[], uint8_t dones[]) const;
+
+private:
+    std::vector<std::unique_ptr<TrajectoryChunk>> chunks;
+    std::vector<long> firstRow; //Row number each chunk starts at
+    long totalRows = 0;
+};
+
+#endif